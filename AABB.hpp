@@ -0,0 +1,119 @@
+/// @file AABB.hpp
+#pragma once
+
+#include "common/types.hpp"
+#include "common/constants.hpp"
+#include "common/functions.hpp"
+#include "Ray.hpp"
+#include <algorithm>
+#include <cmath>
+
+
+namespace nyas
+{
+    /// axis-aligned bounding box [low, high]. Default box is empty (low > high), so extending it by any
+    /// point or box gives that point or box.
+    struct AABB final
+    {
+        Point3D low;
+        Point3D high;
+
+
+        /* Constructors */
+        AABB()
+            : low(constants<float64>::infinity)
+            , high(-constants<float64>::infinity)
+        {}
+        explicit AABB(Point3D const& low, Point3D const& high)
+            : low(low)
+            , high(high)
+        {}
+
+        /// box containing whole space, for objects without finite bounds
+        AABB static inline infinite()
+        {
+            return AABB(Point3D(-constants<float64>::infinity), Point3D(constants<float64>::infinity));
+        }
+
+        bool inline empty() const
+        {
+            return this->low.x > this->high.x || this->low.y > this->high.y || this->low.z > this->high.z;
+        }
+        bool inline finite() const
+        {
+            return ::std::isfinite(this->low.x) && ::std::isfinite(this->low.y) && ::std::isfinite(this->low.z)
+                && ::std::isfinite(this->high.x) && ::std::isfinite(this->high.y) && ::std::isfinite(this->high.z);
+        }
+
+        Vector3D inline extent() const
+        {
+            return this->high - this->low;
+        }
+        Point3D inline center() const
+        {
+            return (this->low + this->high) * 0.5;
+        }
+        /// length of diagonal, a measure of size of box
+        float64 inline diagonal() const
+        {
+            return this->empty() ? 0. : length(this->extent());
+        }
+        float64 inline surface_area() const
+        {
+            if (this->empty()) {
+                return 0.;
+            }
+            Vector3D const e = this->extent();
+            return 2. * (e.x * e.y + e.y * e.z + e.z * e.x);
+        }
+        /// index of the longest axis, 0 for x, 1 for y and 2 for z
+        length_t inline longest_axis() const
+        {
+            Vector3D const e = this->extent();
+            return (e.x >= e.y && e.x >= e.z) ? 0 : (e.y >= e.z) ? 1 : 2;
+        }
+        bool inline contains(Point3D const& p) const
+        {
+            return this->low.x <= p.x && p.x <= this->high.x && this->low.y <= p.y && p.y <= this->high.y
+                && this->low.z <= p.z && p.z <= this->high.z;
+        }
+
+        AABB inline & extend(Point3D const& p)
+        {
+            this->low = ::glm::min(this->low, p);
+            this->high = ::glm::max(this->high, p);
+            return *this;
+        }
+        AABB inline & extend(AABB const& box)
+        {
+            this->low = ::glm::min(this->low, box.low);
+            this->high = ::glm::max(this->high, box.high);
+            return *this;
+        }
+
+        /// slab test of ray against box, [t_enter, t_exit] is the part of ray inside box clipped to [0, t_max].
+        /// inverse_direction is 1 / ray.direction, computed once for all boxes tested with the same ray.
+        bool inline hit(Ray const& ray, Vector3D const& inverse_direction, float64 const& t_max, float64 & t_enter, float64 & t_exit) const
+        {
+            t_enter = 0.;
+            t_exit = t_max;
+            for (length_t axis = 0; axis < 3; ++axis) {
+                float64 t0 = (this->low[axis] - ray.origin[axis]) * inverse_direction[axis];
+                float64 t1 = (this->high[axis] - ray.origin[axis]) * inverse_direction[axis];
+                if (t0 > t1) {
+                    ::std::swap(t0, t1);
+                }
+                // written so NaN from 0 * infinity leaves the range unchanged
+                t_enter = (t0 > t_enter) ? t0 : t_enter;
+                t_exit = (t1 < t_exit) ? t1 : t_exit;
+            }
+            return t_enter <= t_exit;
+        }
+        bool inline hit(Ray const& ray, float64 const& t_max) const
+        {
+            float64 t_enter, t_exit;
+            return this->hit(ray, 1. / ray.direction, t_max, t_enter, t_exit);
+        }
+    };
+
+} // namespace nyas
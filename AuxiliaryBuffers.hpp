@@ -0,0 +1,47 @@
+/// @file AuxiliaryBuffers.hpp
+#pragma once
+
+#include "common/types.hpp"
+#include "Buffer2D.hpp"
+
+
+namespace nyas
+{
+    /// features of the first hit on each pixel, averaged over camera samples of pixel, filled by
+    /// `World::render_auxiliary`. They are nearly noise-free, so a denoiser can find edges by them.
+    struct AuxiliaryBuffers final
+    {
+        GraphicsBuffer albedo;      // albedo of BRDF hit, sky color where camera ray hits nothing
+        GraphicsBuffer normal;      // unit normal facing camera, zero where camera ray hits nothing
+        Buffer2D<float32> depth;    // distance from camera along ray, infinity where camera ray hits nothing
+
+
+        /* Constructors */
+        AuxiliaryBuffers()
+            : albedo()
+            , normal()
+            , depth()
+        {}
+        explicit AuxiliaryBuffers(Length2D const& size)
+            : albedo(size)
+            , normal(size)
+            , depth(size)
+        {}
+
+        Length2D inline size() const
+        {
+            return this->albedo.size();
+        }
+
+        /// reallocate buffers if they are not in size
+        void resize(Length2D const& size)
+        {
+            if (this->albedo.size() != size) {
+                this->albedo = GraphicsBuffer(size);
+                this->normal = GraphicsBuffer(size);
+                this->depth = Buffer2D<float32>(size);
+            }
+        }
+    };
+
+} // namespace nyas
@@ -3,20 +3,63 @@
 
 #include "common/setup.h"
 #include "common/types.hpp"
+#include "BufferLayout.hpp"
+#include "Buffer2DView.hpp"
+#include "MappedFile.hpp"
 #include "utils.hpp"
 #include <assert.h>
 #include <cstring>
 #include <functional>
 #include <fstream>
+#include <memory>
+#include <new>
+#include <vector>
 
 
 namespace nyas
 {
-    template<typename T>
+    namespace _detail   // ! user should not use namespace '_detail'
+    {
+        /// alignment of buffer storage in bytes, a cache line, and enough for any SIMD load
+        ::std::size_t constexpr BUFFER_ALIGNMENT = 64;
+
+        /// allocate count value-initialized elements on aligned memory, the allocation is padded to whole
+        /// cache lines so vector loads over the last elements stay inside. nullptr if failed.
+        template<typename T>
+        T * aligned_allocate(offset_t const& count)
+        {
+            ::std::size_t const bytes = (count * sizeof(T) + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+            void * memory = ::operator new(bytes, ::std::align_val_t(BUFFER_ALIGNMENT), ::std::nothrow);
+            if (memory == nullptr) {
+                return nullptr;
+            }
+            T * data = static_cast<T *>(memory);
+            ::std::uninitialized_value_construct_n(data, count);
+            return data;
+        }
+        template<typename T>
+        void aligned_free(T * ptr, offset_t const& count)
+        {
+            if (ptr != nullptr) {
+                ::std::destroy_n(ptr, count);
+                ::operator delete(ptr, ::std::align_val_t(BUFFER_ALIGNMENT));
+            }
+        }
+
+    } // namespace _detail
+
+
+    /// 2D array of pixels, pixels are stored by the memory layout L (see 'BufferLayout.hpp'), index API
+    /// is the same for all layouts. Storage is aligned to cache line, or mapped from a file for figures
+    /// larger than memory.
+    template<typename T, typename L = RowMajor>
     class Buffer2D final
     {
+        template<typename, typename> friend class Buffer2D;
+
     public:
         typedef T Data;
+        typedef L Layout;
         typedef ::std::function<void(Data &)> ConverFunc;
         typedef ::std::function<void(Length2D const&, Data &)> ConverWithIndexFunc;
         template<typename U> using MapFunc = ::std::function<U(Data const&)>;
@@ -26,21 +69,33 @@ namespace nyas
         /* Constructors */
         Buffer2D()
             : _size(0, 0)
+            , _storage(0, 0)
             , _data(nullptr)
+            , _adopted(false)
+            , _file(nullptr)
         {}
         explicit Buffer2D(Length2D const& size)
             : _size(size)
-            , _data(new Data[size.x * size.y]())
+            , _storage(Layout::storage_size(size))
+            , _data(_detail::aligned_allocate<Data>(static_cast<offset_t>(_storage.x) * _storage.y))
+            , _adopted(false)
+            , _file(nullptr)
         {
             assert(size.x > 0 && size.y > 0);
         }
+        /// @param data_ptr elements in this layout, at least `storage_total()` elements
+        /// @param copy false to use data_ptr directly without taking ownership, it must outlive the buffer
         explicit Buffer2D(Length2D const& size, Data * const data_ptr, bool copy = true)
             : _size(size)
+            , _storage(Layout::storage_size(size))
+            , _data(nullptr)
+            , _adopted(!copy)
+            , _file(nullptr)
         {
             assert(size.x > 0 && size.y > 0);
             if (copy) {
-                length_t const total = size.x * size.y;
-                this->_data = new Data[total];
+                offset_t const total = this->storage_total();
+                this->_data = _detail::aligned_allocate<Data>(total);
                 if (this->_data != nullptr && data_ptr != nullptr) {
                     memcpy(this->_data, data_ptr, total * sizeof(Data));
                 }
@@ -49,26 +104,99 @@ namespace nyas
                 this->_data = data_ptr;
             }
         }
+        /// store elements in a file instead of memory, the OS loads and writes back pages on demand, so figure
+        /// can be larger than memory. Elements of new file are zeros, elements must be trivially copyable.
+        ///
+        /// @param mode `MapMode::Create` for a new file, `MapMode::ReadWrite` to reuse elements in an existing file
+        explicit Buffer2D(Length2D const& size, string const& file_name, MapMode const& mode = MapMode::Create)
+            : Buffer2D()
+        {
+            static_assert(::std::is_trivially_copyable_v<Data>, "file-backed Buffer2D requires trivially copyable elements");
+            assert(size.x > 0 && size.y > 0 && mode != MapMode::Read);
+            Length2D const storage = Layout::storage_size(size);
+            uint64 const bytes = static_cast<uint64>(storage.x) * storage.y * sizeof(Data);
+            MappedFilePtr file = make_shared<MappedFile>(file_name, mode, bytes);
+            if (file->valid() && file->size() >= bytes) {
+                this->_size = size;
+                this->_storage = storage;
+                this->_data = static_cast<Data *>(file->data());
+                this->_file = file;
+            }
+        }
         explicit Buffer2D(length_t const& width, length_t const& height)
             : Buffer2D(Length2D(width, height))
         {}
         explicit Buffer2D(length_t const& width, length_t const& height, Data * const data_ptr, bool const& copy = true)
             : Buffer2D(Length2D(width, height), data_ptr, copy)
         {}
-        Buffer2D(Buffer2D<Data> const& buff)
-            : Buffer2D(buff._size, buff._data, true)
-        {}
-        Buffer2D(Buffer2D<Data> && buff)
+        Buffer2D(Buffer2D const& buff)
             : Buffer2D()
         {
-            ::std::swap(this->_size, buff._size);
-            ::std::swap(this->_data, buff._data);
+            if (buff.valid()) {
+                Buffer2D copy(buff._size, buff._data, true);
+                this->_swap(copy);
+            }
+        }
+        Buffer2D(Buffer2D && buff)
+            : Buffer2D()
+        {
+            this->_swap(buff);
+        }
+        /// copy pixels in a view, e.g. crop a region of another buffer
+        explicit Buffer2D(Buffer2DView<Data const> const& view)
+            : Buffer2D()
+        {
+            if (view.valid() && view.width() > 0 && view.height() > 0) {
+                Buffer2D copy(view.size());
+                if (copy.valid()) {
+                    Layout::visit(copy._size, copy._storage,
+                        [&copy, &view] (Length2D const& index, offset_t const& offset) {
+                            copy._data[offset] = view(index);
+                        }
+                    );
+                }
+                this->_swap(copy);
+            }
+        }
+        /// copy pixels from a buffer in another layout
+        template<typename OtherLayout>
+        explicit Buffer2D(Buffer2D<Data, OtherLayout> const& buff)
+            : Buffer2D()
+        {
+            if (buff.valid()) {
+                Buffer2D copy(buff._size);
+                if (copy.valid()) {
+                    Layout::visit(copy._size, copy._storage,
+                        [&copy, &buff] (Length2D const& index, offset_t const& offset) {
+                            copy._data[offset] = buff(index);
+                        }
+                    );
+                }
+                this->_swap(copy);
+            }
         }
 
         /* Destructor */
         ~Buffer2D()
         {
-            delete[] this->_data;
+            // memory given by user is not released, file-backed storage is unmapped with `_file`
+            if (!this->_adopted && this->_file == nullptr) {
+                _detail::aligned_free(this->_data, this->storage_total());
+            }
+        }
+
+        Buffer2D & operator=(Buffer2D const& buff)
+        {
+            if (this != &buff) {
+                Buffer2D copy(buff);
+                this->_swap(copy);
+            }
+            return *this;
+        }
+        Buffer2D & operator=(Buffer2D && buff)
+        {
+            this->_swap(buff);
+            return *this;
         }
 
         bool inline valid() const
@@ -88,10 +216,30 @@ namespace nyas
         {
             return this->_size;
         }
-        length_t inline total() const
+        offset_t inline total() const
+        {
+            return static_cast<offset_t>(this->_size.x) * this->_size.y;
+        }
+        /// size of storage, larger than `size` if layout pads figure into whole blocks
+        Length2D inline storage_size() const
         {
-            return this->_size.x * this->_size.y;
+            return this->_storage;
         }
+        offset_t inline storage_total() const
+        {
+            return static_cast<offset_t>(this->_storage.x) * this->_storage.y;
+        }
+        /// true if elements are stored in a file
+        bool inline mapped() const
+        {
+            return this->_file != nullptr;
+        }
+        /// write elements of file-backed buffer into file now, nothing to do for buffer in memory
+        bool flush()
+        {
+            return (this->_file == nullptr) || this->_file->flush();
+        }
+        /// elements in storage order of layout, row by row for `RowMajor`
         Data inline * data_pointer()
         {
             return this->_data;
@@ -100,6 +248,11 @@ namespace nyas
         {
             return this->_data;
         }
+        /// offset of pixel in `data_pointer`
+        offset_t inline offset(Length2D const& index) const
+        {
+            return Layout::offset(index, this->_storage);
+        }
 
         /* position conversion */
         Point2D inline at(Length2D const& index) const
@@ -125,12 +278,12 @@ namespace nyas
         Data inline & operator()(Length2D const& index)
         {
             assert(0 <= index.x && index.x < _size.x && 0 <= index.y && index.y < _size.y);
-            return *(this->_data + (index.y * this->_size.x + index.x));
+            return *(this->_data + this->offset(index));
         }
         Data inline const& operator()(Length2D const& index) const
         {
             assert(0 <= index.x && index.x < _size.x && 0 <= index.y && index.y < _size.y);
-            return *(this->_data + (index.y * this->_size.x + index.x));
+            return *(this->_data + this->offset(index));
         }
         Data inline & operator()(length_t const& x, length_t const& y)
         {
@@ -141,64 +294,193 @@ namespace nyas
             return this->operator()(Length2D(x, y));
         }
 
+        /* views, only for row-major layout */
+        /// view on all pixels
+        Buffer2DView<Data> inline view()
+        {
+            static_assert(::std::is_same_v<Layout, RowMajor>, "views require 'RowMajor' layout");
+            return Buffer2DView<Data>(this->_size, this->_data);
+        }
+        Buffer2DView<Data const> inline view() const
+        {
+            static_assert(::std::is_same_v<Layout, RowMajor>, "views require 'RowMajor' layout");
+            return Buffer2DView<Data const>(this->_size, this->_data);
+        }
+        /// view on pixels in region, region must be inside buffer
+        Buffer2DView<Data> inline view(Tile const& region)
+        {
+            return this->view().subview(region);
+        }
+        Buffer2DView<Data const> inline view(Tile const& region) const
+        {
+            return this->view().subview(region);
+        }
+        operator Buffer2DView<Data>()
+        {
+            return this->view();
+        }
+        operator Buffer2DView<Data const>() const
+        {
+            return this->view();
+        }
+
+        /// call func(index, offset) on each pixel in memory order, padding of storage is skipped
+        template<typename Func>
+        void visit(Func const& func) const
+        {
+            Layout::visit(this->_size, this->_storage, func);
+        }
+
         /* converse elements */
-        Buffer2D & for_each(ConverFunc const& func)
+        /// call func(element) on each element, func can be any callable object (e.g. lambda, function
+        /// pointer or `ConverFunc`), lambdas are inlined into the loop without indirect calls.
+        template<typename Func>
+        Buffer2D & for_each(Func const& func)
         {
-            Data * iter = this->_data;
-            length_t const total = this->total();
-            for (length_t i = 0; i < total; ++i) {
-                func(*(iter++));
+            if constexpr (Layout::contiguous) {
+                Data * iter = this->_data;
+                offset_t const total = this->total();
+                for (offset_t i = 0; i < total; ++i) {
+                    func(*(iter++));
+                }
+            }
+            else {
+                Data * data = this->_data;
+                this->visit([&func, data] (Length2D const&, offset_t const& offset) { func(data[offset]); });
             }
             return *this;
         }
-        Buffer2D & for_each_index(ConverWithIndexFunc const& func)
+        /// call func(index, element) on each element, same as `for_each`
+        template<typename Func>
+        Buffer2D & for_each_index(Func const& func)
         {
-            Data * iter = this->_data;
-            Length2D index;
-            for (index.y = 0; index.y < this->_size.y; ++index.y) {
-                for(index.x = 0; index.x < this->_size.x; ++index.x) {
-                    func(index, *(iter++));
-                }
-            }
+            Data * data = this->_data;
+            this->visit([&func, data] (Length2D const& index, offset_t const& offset) { func(index, data[offset]); });
             return *this;
         }
         // TODO: Buffer2D & for_each_multithreads(ConverFunc const& func)
         // TODO: Buffer2D & for_each_index_multithreads(ConverFunc const& func)
 
         /* mapping */
-        template<typename U>
-        Buffer2D<U> map(MapFunc<U> const& func) const
+        /// map elements into a new buffer by func(element), same as `for_each`, func can be `MapFunc<U>`
+        template<typename U, typename Func>
+        Buffer2D<U, Layout> map(Func const& func) const
         {
-            Buffer2D<U> buff(this->_size);
-            if (buff.data_pointer() != nullptr) {
-                mapping_data(func, this->_data, buff.data_pointer(), this->total());
-            }
-            return buff;
+            Buffer2D<U, Layout> buff(this->_size);
+            return this->map(func, buff);
         }
-        template<typename U>
-        Buffer2D<U> & map(MapFunc<U> const& func, Buffer2D<U> & buff) const
+        template<typename U, typename Func>
+        Buffer2D<U, Layout> & map(Func const& func, Buffer2D<U, Layout> & buff) const
         {
             assert(buff.size() == this->_size);
-            length_t const total = this->total();
-            if (buff.data_pointer() != nullptr && buff.total() >= total) {
-                mapping_data(func, this->_data, buff.data_pointer(), total);
+            if (buff.data_pointer() == nullptr || buff.size() != this->_size) {
+                return buff;
+            }
+            if constexpr (Layout::contiguous) {
+                mapping_data(func, this->_data, buff.data_pointer(), this->total());
+            }
+            else {
+                Data const* from = this->_data;
+                U * to = buff.data_pointer();
+                this->visit([&func, from, to] (Length2D const&, offset_t const& offset) { to[offset] = func(from[offset]); });
             }
             return buff;
         }
 
 
     private:
+        void inline _swap(Buffer2D & buff)
+        {
+            ::std::swap(this->_size, buff._size);
+            ::std::swap(this->_storage, buff._storage);
+            ::std::swap(this->_data, buff._data);
+            ::std::swap(this->_adopted, buff._adopted);
+            ::std::swap(this->_file, buff._file);
+        }
+
+
         Length2D _size;
+        Length2D _storage;
         Data * _data;
+        bool _adopted;      // memory is given by user with `copy = false`, and not owned by buffer
+        MappedFilePtr _file;
     };
 
-    template<typename T> using Buffer2DPtr = shared_ptr<Buffer2D<T>>;
-    template<typename T> using Buffer2DConstptr = shared_ptr<Buffer2D<T> const>;
+    template<typename T, typename L = RowMajor> using Buffer2DPtr = shared_ptr<Buffer2D<T, L>>;
+    template<typename T, typename L = RowMajor> using Buffer2DConstptr = shared_ptr<Buffer2D<T, L> const>;
 
     typedef Buffer2D<RGBColor> GraphicsBuffer;
     typedef Buffer2D<ImageRGBColor> ImageBuffer;
 
 
+    /* multiple buffers */
+
+    namespace _detail   // ! user should not use namespace '_detail'
+    {
+        template<typename Func, typename... Ptrs>
+        void inline zip_data(Func const& func, offset_t const& total, Ptrs... ptrs)
+        {
+            for (offset_t i = 0; i < total; ++i) {
+                func(ptrs[i]...);
+            }
+        }
+
+        template<typename Func, typename TO, typename... FROMs>
+        void inline transform_data(Func const& func, offset_t const& total, TO * to_data, FROMs const*... from_datas)
+        {
+            for (offset_t i = 0; i < total; ++i) {
+                to_data[i] = func(from_datas[i]...);
+            }
+        }
+
+    } // namespace _detail
+
+    /// call func(a[i], b[i], ...) on elements at the same index of buffers in one loop, elements of const
+    /// buffers are passed by const reference. All buffers must be in the same size and layout.
+    template<typename Func, typename Buff, typename... Buffs>
+    void zip(Func const& func, Buff & buff, Buffs &... buffs)
+    {
+        typedef typename ::std::remove_const_t<Buff>::Layout Layout;
+        static_assert((::std::is_same_v<typename ::std::remove_const_t<Buffs>::Layout, Layout> && ...), "'zip' requires buffers in the same layout");
+        assert(((buffs.size() == buff.size()) && ...));
+        if (!buff.valid() || !(buffs.valid() && ...)) {
+            return;
+        }
+        if constexpr (Layout::contiguous) {
+            _detail::zip_data(func, buff.total(), buff.data_pointer(), buffs.data_pointer()...);
+        }
+        else {
+            buff.visit(
+                [&func, data = buff.data_pointer(), ... datas = buffs.data_pointer()] (Length2D const&, offset_t const& offset) {
+                    func(data[offset], datas[offset]...);
+                }
+            );
+        }
+    }
+
+    /// out[i] = func(a[i], b[i], ...), fusing operations over several buffers into one pass instead of
+    /// writing temporary buffers. All buffers must be in the same size and layout, and out may be one of inputs.
+    template<typename Func, typename TO, typename L, typename... FROMs>
+    Buffer2D<TO, L> & transform(Func const& func, Buffer2D<TO, L> & out, Buffer2D<FROMs, L> const&... ins)
+    {
+        assert(((ins.size() == out.size()) && ...));
+        if (!out.valid() || !(ins.valid() && ...)) {
+            return out;
+        }
+        if constexpr (L::contiguous) {
+            _detail::transform_data(func, out.total(), out.data_pointer(), ins.data_pointer()...);
+        }
+        else {
+            out.visit(
+                [&func, to = out.data_pointer(), ... from_datas = ins.data_pointer()] (Length2D const&, offset_t const& offset) {
+                    to[offset] = func(from_datas[offset]...);
+                }
+            );
+        }
+        return out;
+    }
+
+
     /* GraphicsBuffer to ImageBuffer */
 
     ImageRGBColor inline RGBcolor_to_imageRGBcolor(RGBColor const& color)
@@ -235,14 +517,19 @@ namespace nyas
 
     /* save to image */
 
+    /// save into 24-bit bmp image. Sizes in header are 32-bit, they are written as 0 if image is larger
+    /// than 4 GiB, which is allowed for uncompressed bmp.
     void save_bmp(char const* file_name, ImageBuffer const& buff)
     {
-        length_t width = buff.width(), height = buff.height();
-
-        char align_buff[3] {0, 0, 0};
-        length_t const align = width % 4;
-        length_t buffer_size = (3 * width + align) * height;
-        length_t file_size = buffer_size + 54;
+        uint64 const width = buff.width(), height = buff.height();
+
+        uint64 const align = width % 4;
+        uint64 const row_size = 3 * width + align;
+        uint64 buffer_size = row_size * height;
+        uint64 file_size = buffer_size + 54;
+        if (file_size > 0xFFFFFFFFull) {
+            buffer_size = file_size = 0;
+        }
 
         uint8 header[54] = {
             66, 77, 88, 88, 88, 88,  0,  0,  0,  0, 54,  0,  0,  0, 40,  0,
@@ -250,13 +537,15 @@ namespace nyas
             0,   0, 88, 88, 88, 88,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
             0,   0,  0,  0,  0,  0
         };
-        uint8 * ptr = header + 2;
-        *(ptr++) = file_size & 0xFF; *(ptr++) = (file_size >>= 8) & 0xFF; *(ptr++) = (file_size >>= 8) & 0xFF; *ptr = (file_size >>= 8) & 0xFF;
-        ptr += 13;
-        *(ptr++) = width & 0xFF; *(ptr++) = (width >>= 8) & 0xFF; *(ptr++) = (width >>= 8) & 0xFF; *(ptr++) = (width >>= 8) & 0xFF;
-        *(ptr++) = height & 0xFF; *(ptr++) = (height >>= 8) & 0xFF; *(ptr++) = (height >>= 8) & 0xFF; *ptr = (height >>= 8) & 0xFF;
-        ptr += 9;
-        *(ptr++) = buffer_size & 0xFF; *(ptr++) = (buffer_size >>= 8) & 0xFF; *(ptr++) = (buffer_size >>= 8) & 0xFF; *ptr = (buffer_size >>= 8) & 0xFF;
+        auto const put32 = [&header] (length_t const& position, uint64 const& value) {
+            for (length_t i = 0; i < 4; ++i) {
+                header[position + i] = (value >> (8 * i)) & 0xFF;
+            }
+        };
+        put32(2, file_size);
+        put32(18, width);
+        put32(22, height);
+        put32(34, buffer_size);
 
 
         ::std::ofstream outfile;
@@ -265,14 +554,21 @@ namespace nyas
         outfile.write(reinterpret_cast<char const*>(header), 54);
         ImageRGBColor const* data_ptr = buff.data_pointer();
 
-        for (length_t h = 0; h < buff.height(); ++h) {
-            for (length_t w = 0; w < buff.width(); ++w) {
-                outfile.write(reinterpret_cast<char const*>(&data_ptr->b), 1);
-                outfile.write(reinterpret_cast<char const*>(&data_ptr->g), 1);
-                outfile.write(reinterpret_cast<char const*>(&data_ptr->r), 1);
-                ++data_ptr;
+        /* convert rows into bgr in a block of about 1 MiB, then write the block at once */
+        uint64 const rows_per_block = ::std::max<uint64>(1, (1 << 20) / ::std::max<uint64>(row_size, 1));
+        ::std::vector<uint8> block(rows_per_block * row_size, 0);
+        for (uint64 h = 0; h < height; h += rows_per_block) {
+            uint64 const num_rows = ::std::min(rows_per_block, height - h);
+            for (uint64 r = 0; r < num_rows; ++r) {
+                uint8 * out = block.data() + r * row_size;
+                for (uint64 w = 0; w < width; ++w) {
+                    *(out++) = data_ptr->b;
+                    *(out++) = data_ptr->g;
+                    *(out++) = data_ptr->r;
+                    ++data_ptr;
+                }
             }
-            outfile.write(align_buff, align);
+            outfile.write(reinterpret_cast<char const*>(block.data()), static_cast<::std::streamsize>(num_rows * row_size));
         }
         outfile.close();
     }
@@ -0,0 +1,172 @@
+/// @file Buffer2DView.hpp
+#pragma once
+
+#include "common/types.hpp"
+#include "Tile.hpp"
+#include <assert.h>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+
+namespace nyas
+{
+    /// Non-owning window on 2D elements in row-major order with a row stride, e.g. a whole Buffer2D, a
+    /// tile of it or any foreign memory. Views are cheap to copy, and copies refer to the same elements.
+    ///
+    /// Like pointers, a const view still gives write access to elements, use `Buffer2DView<T const>` for
+    /// read-only elements. Elements must outlive the view.
+    template<typename T>
+    class Buffer2DView final
+    {
+    public:
+        typedef T Data;
+        typedef ::std::remove_const_t<T> Value;
+
+
+        /* Constructors */
+        Buffer2DView()
+            : _size(0, 0)
+            , _data(nullptr)
+            , _stride(0)
+        {}
+        /// @param stride number of elements from a row to the next row
+        explicit Buffer2DView(Length2D const& size, Data * const data_ptr, offset_t const& stride)
+            : _size(size)
+            , _data(data_ptr)
+            , _stride(stride)
+        {
+            assert(size.x >= 0 && size.y >= 0 && stride >= size.x);
+        }
+        explicit Buffer2DView(Length2D const& size, Data * const data_ptr)
+            : Buffer2DView(size, data_ptr, size.x)
+        {}
+        /// view on mutable elements is also a view on const elements
+        template<typename U, typename = ::std::enable_if_t<::std::is_same_v<T, U const>>>
+        Buffer2DView(Buffer2DView<U> const& view)
+            : Buffer2DView(view.size(), view.data_pointer(), view.stride())
+        {}
+
+        bool inline valid() const
+        {
+            return this->_data != nullptr;
+        }
+
+        length_t inline width() const
+        {
+            return this->_size.x;
+        }
+        length_t inline height() const
+        {
+            return this->_size.y;
+        }
+        Length2D inline size() const
+        {
+            return this->_size;
+        }
+        offset_t inline total() const
+        {
+            return static_cast<offset_t>(this->_size.x) * this->_size.y;
+        }
+        offset_t inline stride() const
+        {
+            return this->_stride;
+        }
+        /// true if rows are next to each other, so all elements are in one contiguous block
+        bool inline contiguous() const
+        {
+            return this->_stride == this->_size.x || this->_size.y <= 1;
+        }
+        Data inline * data_pointer() const
+        {
+            return this->_data;
+        }
+        Data inline * row(length_t const& y) const
+        {
+            assert(0 <= y && y < this->_size.y);
+            return this->_data + y * this->_stride;
+        }
+
+        /* access elements */
+        Data inline & operator()(Length2D const& index) const
+        {
+            assert(0 <= index.x && index.x < _size.x && 0 <= index.y && index.y < _size.y);
+            return *(this->_data + (index.y * this->_stride + index.x));
+        }
+        Data inline & operator()(length_t const& x, length_t const& y) const
+        {
+            return this->operator()(Length2D(x, y));
+        }
+
+        /* sub-views */
+        /// view on a rectangle region of this view, region must be inside this view
+        Buffer2DView subview(Tile const& region) const
+        {
+            assert(region.start.x >= 0 && region.start.y >= 0 && region.end().x <= this->_size.x && region.end().y <= this->_size.y);
+            if (region.empty()) {
+                return Buffer2DView(region.size, this->_data, this->_stride);
+            }
+            return Buffer2DView(region.size, &this->operator()(region.start), this->_stride);
+        }
+        Buffer2DView inline subview(Length2D const& start, Length2D const& size) const
+        {
+            return this->subview(Tile(start, size));
+        }
+
+        /* converse elements */
+        /// call func(element) on each element row by row, func can be any callable object
+        template<typename Func>
+        Buffer2DView const& for_each(Func const& func) const
+        {
+            for (length_t y = 0; y < this->_size.y; ++y) {
+                Data * iter = this->row(y);
+                for (length_t x = 0; x < this->_size.x; ++x) {
+                    func(*(iter++));
+                }
+            }
+            return *this;
+        }
+        /// call func(index, element) on each element, index is relative to this view
+        template<typename Func>
+        Buffer2DView const& for_each_index(Func const& func) const
+        {
+            Length2D index;
+            for (index.y = 0; index.y < this->_size.y; ++index.y) {
+                Data * iter = this->row(index.y);
+                for (index.x = 0; index.x < this->_size.x; ++index.x) {
+                    func(index, *(iter++));
+                }
+            }
+            return *this;
+        }
+
+        /// copy elements from a view in the same size
+        Buffer2DView const& copy_from(Buffer2DView<Value const> const& view) const
+        {
+            static_assert(!::std::is_const_v<T>, "cannot copy into view on const elements");
+            assert(view.size() == this->_size);
+            if (!this->valid() || !view.valid()) {
+                return *this;
+            }
+            for (length_t y = 0; y < this->_size.y; ++y) {
+                if constexpr (::std::is_trivially_copyable_v<Value>) {
+                    memmove(this->row(y), view.row(y), this->_size.x * sizeof(Value));
+                }
+                else {
+                    ::std::copy(view.row(y), view.row(y) + this->_size.x, this->row(y));
+                }
+            }
+            return *this;
+        }
+
+
+    private:
+        Length2D _size;
+        Data * _data;
+        offset_t _stride;
+    };
+
+    typedef Buffer2DView<RGBColor> GraphicsView;
+    typedef Buffer2DView<ImageRGBColor> ImageView;
+
+} // namespace nyas
@@ -0,0 +1,157 @@
+/// @file BufferLayout.hpp
+#pragma once
+
+#include "common/types.hpp"
+#include <algorithm>
+#include <bit>
+
+
+namespace nyas
+{
+    /* Memory layouts of Buffer2D.
+     *
+     * A layout maps pixel index into offset in storage, storage may be larger than figure to fill whole
+     * blocks. Each layout provides:
+     *     contiguous           true if storage is figure itself in row-major order without padding
+     *     storage_size(size)   size of storage for a figure
+     *     offset(index, storage)       64-bit offset of pixel in storage
+     *     visit(size, storage, func)   call func(index, offset) on each pixel in the order of memory
+     */
+
+    /// pixels are stored row by row, the default layout
+    struct RowMajor final
+    {
+        static bool constexpr contiguous = true;
+
+        static Length2D inline storage_size(Length2D const& size)
+        {
+            return size;
+        }
+        static offset_t inline offset(Length2D const& index, Length2D const& storage)
+        {
+            return static_cast<offset_t>(index.y) * storage.x + index.x;
+        }
+        template<typename Func>
+        static void visit(Length2D const& size, Length2D const& /*storage*/, Func const& func)
+        {
+            Length2D index;
+            offset_t offset = 0;
+            for (index.y = 0; index.y < size.y; ++index.y) {
+                for (index.x = 0; index.x < size.x; ++index.x) {
+                    func(index, offset++);
+                }
+            }
+        }
+    };
+
+
+    /// pixels are stored in N*N blocks, blocks are stored row by row and pixels inside a block are
+    /// stored row by row, so a tile renderer or 2D filter touches only a few cache lines
+    template<length_t N>
+    struct Tiled final
+    {
+        static_assert(N > 0 && (N & (N - 1)) == 0, "block size of 'Tiled' must be power of 2");
+
+        static bool constexpr contiguous = false;
+        static length_t constexpr block_size = N;
+        static length_t constexpr shift = ::std::countr_zero(static_cast<uint32>(N));
+
+        static Length2D inline storage_size(Length2D const& size)
+        {
+            return (size + (N - 1)) / N * N;
+        }
+        static offset_t inline offset(Length2D const& index, Length2D const& storage)
+        {
+            // indices are never negative, so shifts and masks are used instead of division
+            return ((static_cast<offset_t>(index.y >> shift) * (storage.x >> shift) + (index.x >> shift)) << (2 * shift))
+                + ((index.y & (N - 1)) << shift) + (index.x & (N - 1));
+        }
+        template<typename Func>
+        static void visit(Length2D const& size, Length2D const& storage, Func const& func)
+        {
+            Length2D block, index;
+            for (block.y = 0; block.y < size.y; block.y += N) {
+                for (block.x = 0; block.x < size.x; block.x += N) {
+                    offset_t const block_offset = (static_cast<offset_t>(block.y / N) * (storage.x / N) + block.x / N) * (N * N);
+                    Length2D const end = ::glm::min(block + N, size);
+                    for (index.y = block.y; index.y < end.y; ++index.y) {
+                        offset_t offset = block_offset + (index.y - block.y) * N;
+                        for (index.x = block.x; index.x < end.x; ++index.x) {
+                            func(index, offset++);
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+
+    namespace _detail   // ! user should not use namespace '_detail'
+    {
+        /// spread lower 32 bits of v into even bits
+        uint64 inline spread_bits(uint64 v)
+        {
+            v &= 0xFFFFFFFFull;
+            v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+            v = (v | (v << 8))  & 0x00FF00FF00FF00FFull;
+            v = (v | (v << 4))  & 0x0F0F0F0F0F0F0F0Full;
+            v = (v | (v << 2))  & 0x3333333333333333ull;
+            v = (v | (v << 1))  & 0x5555555555555555ull;
+            return v;
+        }
+        /// inverse of spread_bits, gather even bits of v
+        uint64 inline compact_bits(uint64 v)
+        {
+            v &= 0x5555555555555555ull;
+            v = (v | (v >> 1))  & 0x3333333333333333ull;
+            v = (v | (v >> 2))  & 0x0F0F0F0F0F0F0F0Full;
+            v = (v | (v >> 4))  & 0x00FF00FF00FF00FFull;
+            v = (v | (v >> 8))  & 0x0000FFFF0000FFFFull;
+            v = (v | (v >> 16)) & 0x00000000FFFFFFFFull;
+            return v;
+        }
+
+    } // namespace _detail
+
+
+    /// pixels are stored in Z-order (Morton order), neighbours in both directions are close in memory at
+    /// every scale. Each side of storage is padded to power of 2, when sides are different the lower bits
+    /// of both coordinates are interleaved and the remaining bits of the longer side are put above them.
+    struct Morton final
+    {
+        static bool constexpr contiguous = false;
+
+        static Length2D inline storage_size(Length2D const& size)
+        {
+            return Length2D(::std::bit_ceil(static_cast<uint32>(size.x)), ::std::bit_ceil(static_cast<uint32>(size.y)));
+        }
+        static offset_t inline offset(Length2D const& index, Length2D const& storage)
+        {
+            using namespace _detail;
+            length_t const bits = ::std::countr_zero(static_cast<uint32>(::std::min(storage.x, storage.y)));
+            length_t const mask = (length_t(1) << bits) - 1;
+            uint64 const low = spread_bits(index.x & mask) | (spread_bits(index.y & mask) << 1);
+            uint64 const high = (storage.x > storage.y) ? (index.x >> bits) : (index.y >> bits);
+            return static_cast<offset_t>((high << (2 * bits)) | low);
+        }
+        template<typename Func>
+        static void visit(Length2D const& size, Length2D const& storage, Func const& func)
+        {
+            using namespace _detail;
+            length_t const bits = ::std::countr_zero(static_cast<uint32>(::std::min(storage.x, storage.y)));
+            uint64 const low_mask = (uint64(1) << (2 * bits)) - 1;
+            bool const wide = storage.x > storage.y;
+            offset_t const total = static_cast<offset_t>(storage.x) * storage.y;
+            for (offset_t offset = 0; offset < total; ++offset) {
+                uint64 const low = offset & low_mask;
+                length_t const high = static_cast<length_t>(offset >> (2 * bits));
+                Length2D index(static_cast<length_t>(compact_bits(low)), static_cast<length_t>(compact_bits(low >> 1)));
+                (wide ? index.x : index.y) += high << bits;
+                if (index.x < size.x && index.y < size.y) {
+                    func(index, offset);
+                }
+            }
+        }
+    };
+
+} // namespace nyas
@@ -0,0 +1,230 @@
+/// @file MappedFile.hpp
+#pragma once
+
+#include "common/setup.h"
+#include "common/types.hpp"
+#include <string>
+#ifdef WIN32    // Windows
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+
+namespace nyas
+{
+    enum class MapMode
+    {
+        Read,           // map an existing file read-only
+        ReadWrite,      // map an existing file, changes are written back into file
+        Create          // create or truncate file into given size, then map as `ReadWrite`
+    };
+
+
+    /// Map a whole file into memory, pages are loaded on first access and written back by the OS.
+    /// Windows maps by `CreateFileMapping` and `MapViewOfFile`, other systems by `mmap`.
+    class MappedFile final
+    {
+    public:
+        /* Constructors */
+        MappedFile()
+            : _file_name()
+            , _mode(MapMode::Read)
+            , _data(nullptr)
+            , _size(0)
+#ifdef WIN32
+            , _handle(INVALID_HANDLE_VALUE)
+#endif
+        {}
+        /// @param size size of file in bytes for `MapMode::Create`, ignored for other modes
+        explicit MappedFile(string const& file_name, MapMode const& mode = MapMode::Read, uint64 const& size = 0)
+            : MappedFile()
+        {
+            this->_file_name = file_name;
+            this->_mode = mode;
+            this->_open(size);
+        }
+        MappedFile(MappedFile const&) = delete;
+        MappedFile(MappedFile && file)
+            : MappedFile()
+        {
+            this->_swap(file);
+        }
+
+        /* Destructor */
+        ~MappedFile()
+        {
+            this->_close();
+        }
+
+        MappedFile & operator=(MappedFile const&) = delete;
+        MappedFile & operator=(MappedFile && file)
+        {
+            this->_swap(file);
+            return *this;
+        }
+
+        bool inline valid() const
+        {
+            return this->_data != nullptr;
+        }
+        string inline const& file_name() const
+        {
+            return this->_file_name;
+        }
+        MapMode inline mode() const
+        {
+            return this->_mode;
+        }
+        uint64 inline size() const
+        {
+            return this->_size;
+        }
+        void inline * data()
+        {
+            return this->_data;
+        }
+        void inline const* data() const
+        {
+            return this->_data;
+        }
+
+        /// write changes into file now, true for success or nothing to write
+        bool flush()
+        {
+            if (!this->valid() || this->_mode == MapMode::Read) {
+                return true;
+            }
+#ifdef WIN32
+            return FlushViewOfFile(this->_data, 0) && FlushFileBuffers(this->_handle);
+#else
+            return msync(this->_data, this->_size, MS_SYNC) == 0;
+#endif
+        }
+
+
+    private:
+        void _open(uint64 const& size)
+        {
+#ifdef WIN32
+            DWORD const access = (this->_mode == MapMode::Read) ? GENERIC_READ : (GENERIC_READ | GENERIC_WRITE);
+            DWORD const creation = (this->_mode == MapMode::Create) ? CREATE_ALWAYS : OPEN_EXISTING;
+            HANDLE const file = CreateFileA(this->_file_name.c_str(), access, FILE_SHARE_READ, nullptr, creation, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return;
+            }
+            uint64 length = size;
+            if (this->_mode == MapMode::Create) {
+                LARGE_INTEGER end;
+                end.QuadPart = static_cast<LONGLONG>(size);
+                if (!SetFilePointerEx(file, end, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+                    CloseHandle(file);
+                    return;
+                }
+            }
+            else {
+                LARGE_INTEGER file_size;
+                if (!GetFileSizeEx(file, &file_size)) {
+                    CloseHandle(file);
+                    return;
+                }
+                length = static_cast<uint64>(file_size.QuadPart);
+            }
+            if (length > 0) {
+                DWORD const protection = (this->_mode == MapMode::Read) ? PAGE_READONLY : PAGE_READWRITE;
+                HANDLE const mapping = CreateFileMappingA(file, nullptr, protection, static_cast<DWORD>(length >> 32), static_cast<DWORD>(length), nullptr);
+                if (mapping != nullptr) {
+                    void * memory = MapViewOfFile(mapping, (this->_mode == MapMode::Read) ? FILE_MAP_READ : FILE_MAP_WRITE, 0, 0, 0);
+                    CloseHandle(mapping);       // view keeps mapping
+                    if (memory != nullptr) {
+                        this->_data = memory;
+                        this->_size = length;
+                        this->_handle = file;   // kept for `FlushFileBuffers`
+                        return;
+                    }
+                }
+            }
+            CloseHandle(file);
+#else
+            int const flags = (this->_mode == MapMode::Read) ? O_RDONLY : (this->_mode == MapMode::ReadWrite) ? O_RDWR : (O_RDWR | O_CREAT | O_TRUNC);
+            int const fd = open(this->_file_name.c_str(), flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+            if (fd < 0) {
+                return;
+            }
+            uint64 length = size;
+            if (this->_mode == MapMode::Create) {
+                if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                    close(fd);
+                    return;
+                }
+            }
+            else {
+                struct stat info;
+                if (fstat(fd, &info) != 0) {
+                    close(fd);
+                    return;
+                }
+                length = static_cast<uint64>(info.st_size);
+            }
+            if (length > 0) {
+                int const protection = (this->_mode == MapMode::Read) ? PROT_READ : (PROT_READ | PROT_WRITE);
+                void * memory = mmap(nullptr, length, protection, MAP_SHARED, fd, 0);
+                if (memory != MAP_FAILED) {
+                    this->_data = memory;
+                    this->_size = length;
+                }
+            }
+            close(fd);      // mapping keeps file open
+#endif
+        }
+
+        void _close()
+        {
+            if (!this->valid()) {
+                return;
+            }
+#ifdef WIN32
+            UnmapViewOfFile(this->_data);
+            CloseHandle(this->_handle);
+            this->_handle = INVALID_HANDLE_VALUE;
+#else
+            munmap(this->_data, this->_size);
+#endif
+            this->_data = nullptr;
+            this->_size = 0;
+        }
+
+        void inline _swap(MappedFile & file)
+        {
+            ::std::swap(this->_file_name, file._file_name);
+            ::std::swap(this->_mode, file._mode);
+            ::std::swap(this->_data, file._data);
+            ::std::swap(this->_size, file._size);
+#ifdef WIN32
+            ::std::swap(this->_handle, file._handle);
+#endif
+        }
+
+
+        string _file_name;
+        MapMode _mode;
+        void * _data;
+        uint64 _size;
+#ifdef WIN32
+        HANDLE _handle;     // file, kept open for `FlushFileBuffers`
+#endif
+    };
+
+    typedef shared_ptr<MappedFile> MappedFilePtr;
+    typedef shared_ptr<MappedFile const> MappedFileConstptr;
+
+} // namespace nyas
@@ -0,0 +1,149 @@
+/// @file RayBatch.hpp
+#pragma once
+
+#include "common/types.hpp"
+#include "Ray.hpp"
+#include <algorithm>
+#include <vector>
+
+
+namespace nyas
+{
+    /// rays in structure-of-arrays layout, each component is a contiguous array, so loops over rays
+    /// load and store whole vectors of components instead of gathering from `Ray` structures
+    struct RayBatch final
+    {
+        ::std::vector<float64> origin_x;
+        ::std::vector<float64> origin_y;
+        ::std::vector<float64> origin_z;
+        ::std::vector<float64> direction_x;
+        ::std::vector<float64> direction_y;
+        ::std::vector<float64> direction_z;
+
+
+        length_t inline size() const
+        {
+            return static_cast<length_t>(this->origin_x.size());
+        }
+        bool inline empty() const
+        {
+            return this->origin_x.empty();
+        }
+        /// resize all components, memory is kept when shrinking so a batch can be reused between tiles
+        void resize(length_t const& size)
+        {
+            for (::std::vector<float64> * component : {&this->origin_x, &this->origin_y, &this->origin_z,
+                &this->direction_x, &this->direction_y, &this->direction_z}) {
+                component->resize(size);
+            }
+        }
+
+        Ray inline ray(length_t const& i) const
+        {
+            return Ray(
+                Point3D(this->origin_x[i], this->origin_y[i], this->origin_z[i]),
+                Vector3D(this->direction_x[i], this->direction_y[i], this->direction_z[i])
+            );
+        }
+        /// rays[i] = from.ray(order[i]) for all i in order
+        void gather(RayBatch const& from, ::std::vector<length_t> const& order)
+        {
+            length_t const size = static_cast<length_t>(order.size());
+            this->resize(size);
+            for (length_t i = 0; i < size; ++i) {
+                length_t const j = order[i];
+                this->origin_x[i] = from.origin_x[j];
+                this->origin_y[i] = from.origin_y[j];
+                this->origin_z[i] = from.origin_z[j];
+                this->direction_x[i] = from.direction_x[j];
+                this->direction_y[i] = from.direction_y[j];
+                this->direction_z[i] = from.direction_z[j];
+            }
+        }
+        void inline set_ray(length_t const& i, Ray const& ray)
+        {
+            this->origin_x[i] = ray.origin.x;
+            this->origin_y[i] = ray.origin.y;
+            this->origin_z[i] = ray.origin.z;
+            this->direction_x[i] = ray.direction.x;
+            this->direction_y[i] = ray.direction.y;
+            this->direction_z[i] = ray.direction.z;
+        }
+    };
+
+
+    namespace _detail   // ! user should not use namespace '_detail'
+    {
+        length_t constexpr RAY_CELL_BITS = 7;       // origins are put into 2^7 cells on each axis
+
+        /// spread lower 10 bits of v into every third bit
+        uint32 inline spread_bits3(uint32 v)
+        {
+            v &= 0x3FFu;
+            v = (v | (v << 16)) & 0x030000FFu;
+            v = (v | (v << 8))  & 0x0300F00Fu;
+            v = (v | (v << 4))  & 0x030C30C3u;
+            v = (v | (v << 2))  & 0x09249249u;
+            return v;
+        }
+
+        /// stable LSD radix sort of indices by keys with key_bits bits, 8 bits in each pass
+        void radix_sort_indices(::std::vector<uint32> const& keys, length_t const& key_bits, ::std::vector<length_t> & order)
+        {
+            length_t const size = static_cast<length_t>(keys.size());
+            order.resize(size);
+            for (length_t i = 0; i < size; ++i) {
+                order[i] = i;
+            }
+            ::std::vector<length_t> sorted(size);
+            for (length_t shift = 0; shift < key_bits; shift += 8) {
+                length_t counts[257] = {0};
+                for (length_t i = 0; i < size; ++i) {
+                    ++counts[((keys[i] >> shift) & 0xFFu) + 1];
+                }
+                for (length_t d = 0; d < 256; ++d) {
+                    counts[d + 1] += counts[d];
+                }
+                for (length_t i = 0; i < size; ++i) {
+                    length_t const index = order[i];
+                    sorted[counts[(keys[index] >> shift) & 0xFFu]++] = index;
+                }
+                order.swap(sorted);
+            }
+        }
+
+    } // namespace _detail
+
+
+    /// order of rays that puts rays starting in the same region and going to the same octant together.
+    ///
+    /// Key of each ray is the direction octant above Morton code of origin cell on a 2^7 grid over bounding
+    /// box of all origins, keys are sorted by radix sort in 3 passes.
+    void coherent_order(RayBatch const& rays, ::std::vector<length_t> & order)
+    {
+        using namespace _detail;
+        length_t const size = rays.size();
+        if (size == 0) {
+            order.clear();
+            return;
+        }
+        Point3D low(rays.origin_x[0], rays.origin_y[0], rays.origin_z[0]), high = low;
+        for (length_t i = 1; i < size; ++i) {
+            low = ::glm::min(low, Point3D(rays.origin_x[i], rays.origin_y[i], rays.origin_z[i]));
+            high = ::glm::max(high, Point3D(rays.origin_x[i], rays.origin_y[i], rays.origin_z[i]));
+        }
+        float64 const cells = static_cast<float64>((1 << RAY_CELL_BITS) - 1);
+        Vector3D const scale = cells / ::glm::max(high - low, Vector3D(1e-300));
+
+        ::std::vector<uint32> keys(size);
+        for (length_t i = 0; i < size; ++i) {
+            uint32 const cx = static_cast<uint32>((rays.origin_x[i] - low.x) * scale.x);
+            uint32 const cy = static_cast<uint32>((rays.origin_y[i] - low.y) * scale.y);
+            uint32 const cz = static_cast<uint32>((rays.origin_z[i] - low.z) * scale.z);
+            uint32 const octant = (rays.direction_x[i] < 0. ? 1u : 0u) | (rays.direction_y[i] < 0. ? 2u : 0u) | (rays.direction_z[i] < 0. ? 4u : 0u);
+            keys[i] = (octant << (3 * RAY_CELL_BITS)) | spread_bits3(cx) | (spread_bits3(cy) << 1) | (spread_bits3(cz) << 2);
+        }
+        radix_sort_indices(keys, 3 * RAY_CELL_BITS + 3, order);
+    }
+
+} // namespace nyas
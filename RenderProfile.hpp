@@ -0,0 +1,64 @@
+/// @file RenderProfile.hpp
+#pragma once
+
+#include "common/types.hpp"
+#include "Buffer2D.hpp"
+
+
+namespace nyas
+{
+    /// cost of rendering each pixel, filled by `World::render_scenes(RenderProfile &)`. See `heatmap` for
+    /// showing them as images, summed over tiles or not.
+    struct RenderProfile final
+    {
+        Buffer2D<float32> seconds;  // wall time used by all samples of pixel
+        Buffer2D<uint32> rays;      // ray queries of world (`hit`, `intersect` and `occluded`) by all samples of pixel
+
+
+        /* Constructors */
+        RenderProfile()
+            : seconds()
+            , rays()
+        {}
+        explicit RenderProfile(Length2D const& size)
+            : seconds(size)
+            , rays(size)
+        {}
+
+        Length2D inline size() const
+        {
+            return this->seconds.size();
+        }
+
+        /// reallocate buffers if they are not in size
+        void resize(Length2D const& size)
+        {
+            if (this->seconds.size() != size) {
+                this->seconds = Buffer2D<float32>(size);
+                this->rays = Buffer2D<uint32>(size);
+            }
+        }
+
+        float64 total_seconds() const
+        {
+            float64 sum = 0.;
+            for (length_t y = 0; y < this->seconds.height(); ++y) {
+                for (length_t x = 0; x < this->seconds.width(); ++x) {
+                    sum += this->seconds(x, y);
+                }
+            }
+            return sum;
+        }
+        uint64 total_rays() const
+        {
+            uint64 sum = 0;
+            for (length_t y = 0; y < this->rays.height(); ++y) {
+                for (length_t x = 0; x < this->rays.width(); ++x) {
+                    sum += this->rays(x, y);
+                }
+            }
+            return sum;
+        }
+    };
+
+} // namespace nyas
@@ -0,0 +1,92 @@
+/// @file Tile.hpp
+#pragma once
+
+#include "common/types.hpp"
+#include <assert.h>
+#include <algorithm>
+#include <vector>
+
+
+namespace nyas
+{
+    /// rectangle region of pixels on figure, [start, start + size)
+    struct Tile final
+    {
+        Length2D start;
+        Length2D size;
+
+
+        /* Constructors */
+        Tile()
+            : start(0, 0)
+            , size(0, 0)
+        {}
+        explicit Tile(Length2D const& start, Length2D const& size)
+            : start(start)
+            , size(size)
+        {}
+        explicit Tile(length_t const& x, length_t const& y, length_t const& width, length_t const& height)
+            : start(x, y)
+            , size(width, height)
+        {}
+        Tile(Tile const&) = default;
+
+        Tile & operator=(Tile const&) = default;
+
+        /// first pixel index after tile in x and y direction
+        Length2D inline end() const
+        {
+            return this->start + this->size;
+        }
+        length_t inline total() const
+        {
+            return this->size.x * this->size.y;
+        }
+        bool inline empty() const
+        {
+            return this->size.x <= 0 || this->size.y <= 0;
+        }
+        bool inline contains(Length2D const& index) const
+        {
+            return this->start.x <= index.x && index.x < this->start.x + this->size.x
+                && this->start.y <= index.y && index.y < this->start.y + this->size.y;
+        }
+        /// overlapped region of two tiles, empty if not overlapped
+        Tile intersect(Tile const& tile) const
+        {
+            Length2D const first = ::glm::max(this->start, tile.start);
+            Length2D const last = ::glm::min(this->end(), tile.end());
+            if (first.x >= last.x || first.y >= last.y) {
+                return Tile(first, Length2D(0, 0));
+            }
+            return Tile(first, last - first);
+        }
+    };
+
+    typedef ::std::vector<Tile> TileList;
+
+
+    /// split region into tiles, tiles on right and top edges may be smaller than tile_size
+    TileList split_tiles(Tile const& region, Length2D const& tile_size)
+    {
+        assert(tile_size.x > 0 && tile_size.y > 0);
+        TileList list;
+        Length2D const end = region.end();
+        for (length_t y = region.start.y; y < end.y; y += tile_size.y) {
+            for (length_t x = region.start.x; x < end.x; x += tile_size.x) {
+                list.push_back(Tile(
+                    Length2D(x, y),
+                    Length2D(::std::min(tile_size.x, end.x - x), ::std::min(tile_size.y, end.y - y))
+                ));
+            }
+        }
+        return list;
+    }
+
+    /// split whole figure into tiles
+    TileList inline split_tiles(Length2D const& figure_size, Length2D const& tile_size)
+    {
+        return split_tiles(Tile(Length2D(0, 0), figure_size), tile_size);
+    }
+
+} // namespace nyas
@@ -9,24 +9,83 @@
 //#include "objects/MultiObject3D.hpp"
 #include "skies/Sky.hpp"
 #include "tracers/RayTracer.hpp"
+#include "accelerators/Accelerator.hpp"
+#include "accelerators/choose.hpp"
+#include "AuxiliaryBuffers.hpp"
+#include "RayBatch.hpp"
+#include "RenderProfile.hpp"
+#include "Tile.hpp"
+#include "utils.hpp"
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 
 namespace nyas
 {
-    typedef ::std::vector<Object3DPtr> Object3DList;
+    /// called after each pass of progressive rendering
+    ///
+    /// @param sums sums of colors on each pixel
+    /// @param num_samples number of samples summed on each pixel
+    typedef ::std::function<void(GraphicsBuffer const& sums, length_t const& num_samples)> PassCallback;
+
+    /// numbers reported by `World::render_timed`
+    struct TimedRenderStats final
+    {
+        length_t num_passes;        // passes started, the last one may cover only some tiles
+        length_t min_samples;       // fewest samples on a pixel
+        length_t max_samples;       // most samples on a pixel
+        float64 seconds;            // wall time used, including building accelerator
+
+
+        TimedRenderStats()
+            : num_passes(0)
+            , min_samples(0)
+            , max_samples(0)
+            , seconds(0.)
+        {}
+    };
 
     class World final
     {
     public:
+        length_t static constexpr DEFAULT_TILE_SIZE = 32;
+        length_t static constexpr DEFAULT_AUXILIARY_SAMPLES = 4;
+        length_t static constexpr MAX_BATCH_RAYS = 1 << 16;     // camera rays traced together by `accumulate_tile`
+
+
         World()
             : _objects()
             , _sky(nullptr)
             , _camera(nullptr)
             , _sampler(nullptr)
             , _tracer(nullptr)
+            , _num_threads(default_num_threads())
+            , _accelerator(nullptr)
+            , _auto_accelerator(true)
+            , _accelerator_built(false)
+            , _accelerator_global_geometry(0)
+            , _accelerator_geometry_sum(0)
+            , _lights()
+            , _lights_valid(false)
+            , _lights_global_revision(0)
+            , _revision(0)
+            , _seen_camera(nullptr)
+            , _seen_camera_revision(0)
+            , _seen_global_revision(0)
+            , _object_revision_sum(0)
+            , _object_revisions_valid(false)
+            , _refine_sums()
+            , _refine_num_samples(0)
+            , _refine_revision(0)
         {}
+        World(World const&) = delete;
+
+        World & operator=(World const&) = delete;
 
         bool valid() const
         {
@@ -35,7 +94,7 @@ namespace nyas
                     return false;
                 }
             }
-            return this->_camera != nullptr && this->_sky != nullptr;
+            return this->_camera != nullptr && this->_sky != nullptr && this->_sampler != nullptr && this->_tracer != nullptr;
         }
 
         World inline & add_object(Object3DPtr const& obj)
@@ -49,17 +108,20 @@ namespace nyas
             //        this->add_object(subobj);
             //    }
             //}
+            this->invalidate_accelerator();
             return *this;
         }
 
         World inline & set_sky(SkyPtr const& sky)
         {
             this->_sky = sky;
+            ++this->_revision;
             return *this;
         }
         World inline & set_camera(CameraPtr const& camera)
         {
             this->_camera = camera;
+            ++this->_revision;
             return *this;
         }
         World inline & set_sampler(SamplerPtr const& sampler)
@@ -69,12 +131,47 @@ namespace nyas
                 obj->set_sampler(sampler);
             }
             this->_camera->set_sampler(sampler);
+            ++this->_revision;
             return *this;
         }
         World inline & set_ray_tracer(RayTracerPtr const& ray_tracer)
         {
             this->_tracer = ray_tracer;
             this->_tracer->set_world(this);
+            ++this->_revision;
+            return *this;
+        }
+        /// set accelerator of closest-hit queries, it is built on the first query. nullptr for choosing one
+        /// by `accelerators::choose_accelerator` automatically, which is the default.
+        World inline & set_accelerator(AcceleratorPtr const& accelerator)
+        {
+            ::std::lock_guard<::std::mutex> lock(this->_accelerator_mutex);
+            this->_accelerator = accelerator;
+            this->_auto_accelerator = (accelerator == nullptr);
+            this->_accelerator_built = false;
+            return *this;
+        }
+        /// rebuild accelerator on the next query, call it after objects are added or removed through `objects()`.
+        /// Objects moved or reshaped by their setters are found by the next query without calling it.
+        World inline & invalidate_accelerator()
+        {
+            this->_accelerator_built = false;
+            this->_lights_valid = false;
+            this->_object_revisions_valid = false;
+            ++this->_revision;
+            return *this;
+        }
+        /// count an edit not tracked by setters, e.g. of a BRDF, sky or tracer, so `revision` changes
+        World inline & touch()
+        {
+            ++this->_revision;
+            return *this;
+        }
+        /// set number of threads used in rendering, including the calling thread
+        World inline & set_num_threads(length_t const& num_threads)
+        {
+            assert(num_threads > 0);
+            this->_num_threads = num_threads;
             return *this;
         }
 
@@ -102,22 +199,469 @@ namespace nyas
         {
             return this->_tracer;
         }
+        length_t inline num_threads() const
+        {
+            return this->_num_threads;
+        }
+        /// increased after every edit of world, its camera or its objects through setters, and by `touch`. Data
+        /// derived from world (e.g. a compiled scene or a rendered figure) saved with a revision is still valid
+        /// while the revision is the same. Called from the thread editing world.
+        uint64 revision() const
+        {
+            if (this->_camera.get() != this->_seen_camera || (this->_camera != nullptr && this->_camera->revision() != this->_seen_camera_revision)) {
+                this->_seen_camera = this->_camera.get();
+                this->_seen_camera_revision = (this->_camera != nullptr) ? this->_camera->revision() : 0;
+                ++this->_revision;
+            }
+            // objects are checked one by one only if any object in any world is edited
+            uint64 const global = Object3D::global_revision();
+            if (!this->_object_revisions_valid || global != this->_seen_global_revision) {
+                uint64 sum = 0;
+                for (Object3DPtr const& obj : this->_objects) {
+                    sum += obj->revision();
+                }
+                if (this->_object_revisions_valid && sum != this->_object_revision_sum) {
+                    ++this->_revision;
+                }
+                this->_object_revision_sum = sum;
+                this->_seen_global_revision = global;
+                this->_object_revisions_valid = true;
+            }
+            return this->_revision;
+        }
+        /// accelerator of objects, built if not yet
+        AcceleratorConstptr inline accelerator() const
+        {
+            this->_built_accelerator();
+            return this->_accelerator;
+        }
+
+        /// emissive objects, collected again after objects are added or any object is edited
+        Object3DList inline const& lights() const
+        {
+            if (!this->_lights_valid.load(::std::memory_order_acquire)
+                || Object3D::global_revision() != this->_lights_global_revision.load(::std::memory_order_relaxed)) {
+                ::std::lock_guard<::std::mutex> lock(this->_lights_mutex);
+                uint64 const global = Object3D::global_revision();
+                if (!this->_lights_valid.load(::std::memory_order_relaxed) || global != this->_lights_global_revision.load(::std::memory_order_relaxed)) {
+                    this->_lights.clear();
+                    for (Object3DPtr const& obj : this->_objects) {
+                        if (obj->emissive()) {
+                            this->_lights.push_back(obj);
+                        }
+                    }
+                    this->_lights_global_revision.store(global, ::std::memory_order_relaxed);
+                    this->_lights_valid.store(true, ::std::memory_order_release);
+                }
+            }
+            return this->_lights;
+        }
+
+        /// closest hit of ray on all objects before t_max, same as `Object3D::hit` on each object
+        bool inline hit(Ray const& ray, float64 const& t_max, RayHittingRecord & rec) const
+        {
+            ++World::_thread_rays;
+            return this->_built_accelerator().hit(ray, t_max, rec);
+        }
+        /// closest hit without surface, only t, object and primitive of rec are written. Call
+        /// `rec.object->interact(ray, rec)` if surface of the hit is needed later.
+        bool inline intersect(Ray const& ray, float64 const& t_max, RayHittingRecord & rec) const
+        {
+            ++World::_thread_rays;
+            return this->_built_accelerator().intersect(ray, t_max, rec);
+        }
+        /// whether any object is hit before t_max, for shadow rays and visibility tests. Stops at the first hit.
+        bool inline occluded(Ray const& ray, float64 const& t_max) const
+        {
+            ++World::_thread_rays;
+            return this->_built_accelerator().occluded(ray, t_max);
+        }
+        /// number of `hit`, `intersect` and `occluded` queries on this thread, of all worlds. It is never reset,
+        /// callers take differences.
+        uint64 static inline thread_rays()
+        {
+            return World::_thread_rays;
+        }
+
+        /// render one sample of pixel. Sampler is sought to a cursor decided only by pixel index and sample index,
+        /// so the result does not depend on which pixels or samples were rendered before, or in which process.
+        RGBColor render_sample(Length2D const& index, length_t const& sample) const
+        {
+            uint64 const pixel = static_cast<uint64>(index.y) * this->_camera->figure_size().x + index.x;
+            this->_sampler->seek(pixel * this->_sampler->num_samples() + sample);
+            return this->_tracer->trace_ray(this->_camera->get_ray_sample(index));
+        }
+
+        /// add colors of samples in range [sample_begin, sample_end) on pixel into sum
+        void accumulate_pixel(Length2D const& index, length_t const& sample_begin, length_t const& sample_end, RGBColor & sum) const
+        {
+            for (length_t n = sample_begin; n < sample_end; ++n) {
+                sum += this->render_sample(index, n);
+            }
+        }
+
+        /// return sum of colors of samples in range [sample_begin, sample_end) on pixel
+        RGBColor inline render_pixel(Length2D const& index, length_t const& sample_begin, length_t const& sample_end) const
+        {
+            RGBColor pixel_color = constants<float32>::axis3D::O;
+            this->accumulate_pixel(index, sample_begin, sample_end, pixel_color);
+            return pixel_color;
+        }
+
+        /// add colors of samples in range [sample_begin, sample_end) on pixels in tile into sums. Camera rays are
+        /// generated by `Camera::get_ray_samples` and traced by `RayTracer::trace_rays` in batches of at most
+        /// `MAX_BATCH_RAYS` rays (one sample on each pixel at least), colors on each pixel are added in order of
+        /// samples like `accumulate_pixel`. All rendering into figure goes through here.
+        ///
+        /// @param sums buffer with same size as tile, sums(0, 0) is pixel at tile.start
+        void accumulate_tile(Tile const& tile, length_t const& sample_begin, length_t const& sample_end, GraphicsView const& sums) const
+        {
+            assert(sums.size() == tile.size);
+            if (tile.empty()) {
+                return;
+            }
+            _TileBatch & batch = World::_thread_batch;
+            length_t const samples_per_batch = ::std::max(World::MAX_BATCH_RAYS / tile.total(), 1);
+            for (length_t begin = sample_begin; begin < sample_end; begin += samples_per_batch) {
+                length_t const end = ::std::min(begin + samples_per_batch, sample_end);
+                this->_camera->get_ray_samples(tile, begin, end, batch.rays);
+                batch.cursors.resize(batch.rays.size());
+                batch.colors.resize(batch.rays.size());
+
+                /* cursors of camera samples, same as `render_sample` */
+                length_t i = 0;
+                for (length_t y = tile.start.y; y < tile.end().y; ++y) {
+                    for (length_t x = tile.start.x; x < tile.end().x; ++x) {
+                        uint64 const pixel = static_cast<uint64>(y) * this->_camera->figure_size().x + x;
+                        for (length_t n = begin; n < end; ++n) {
+                            batch.cursors[i++] = pixel * this->_sampler->num_samples() + n;
+                        }
+                    }
+                }
+                this->_tracer->trace_rays(batch.rays, batch.cursors.data(), batch.colors.data());
+
+                i = 0;
+                for (length_t y = 0; y < tile.size.y; ++y) {
+                    for (length_t x = 0; x < tile.size.x; ++x) {
+                        RGBColor & sum = sums(x, y);
+                        for (length_t n = begin; n < end; ++n) {
+                            sum += batch.colors[i++];
+                        }
+                    }
+                }
+            }
+        }
+
+        /// render samples in range [sample_begin, sample_end) on pixels in tile, store sums of colors into sums,
+        /// see `accumulate_tile`
+        ///
+        /// @param sums buffer with same size as tile, sums(0, 0) is pixel at tile.start
+        void render_tile(Tile const& tile, length_t const& sample_begin, length_t const& sample_end, GraphicsView const& sums) const
+        {
+            sums.for_each([] (RGBColor & sum) { sum = constants<float32>::axis3D::O; });
+            this->accumulate_tile(tile, sample_begin, sample_end, sums);
+        }
 
         void render_scenes()
         {
             if(!this->valid()) {
                 return;
             }
-            float32 const inverse_num_samples = 1.f / this->_sampler->num_samples();
-            for (length_t y = 0; y < this->_camera->figure_size().y; ++y) {
-                for (length_t x = 0; x < this->_camera->figure_size().x; ++x) {
-                    RGBColor pixel_color = constants<float32>::axis3D::O;
-                    for (length_t n = 0; n < this->_sampler->num_samples(); ++n) {
-                        pixel_color += this->_tracer->trace_ray(this->_camera->get_ray_sample(Length2D(x, y)));
+            GraphicsBuffer & figure = this->_camera->figure();
+            length_t const num_samples = this->_sampler->num_samples();
+            float32 const inverse_num_samples = 1.f / num_samples;
+            this->_render_tiles_parallel(
+                [this, &figure, &num_samples, &inverse_num_samples] (Tile const& tile) {
+                    GraphicsView const pixels = figure.view(tile);
+                    this->render_tile(tile, 0, num_samples, pixels);
+                    pixels.for_each([&inverse_num_samples] (RGBColor & pixel_color) { pixel_color *= inverse_num_samples; });
+                }
+            );
+        }
+
+        /// render pixels only in regions, pixels outside regions are untouched. Every pixel gets the same
+        /// samples as in `render_scenes()`, so regions can be re-rendered on a previous full figure.
+        /// Regions may overlap each other or figure edges, each pixel is rendered once.
+        void render_scenes(TileList const& regions)
+        {
+            if(!this->valid()) {
+                return;
+            }
+            GraphicsBuffer & figure = this->_camera->figure();
+            Tile const whole(Length2D(0, 0), figure.size());
+            TileList clipped;
+            for (Tile const& region : regions) {
+                Tile const tile = region.intersect(whole);
+                if (!tile.empty()) {
+                    clipped.push_back(tile);
+                }
+            }
+            if (clipped.empty()) {
+                return;
+            }
+
+            /* tiles of figure covered by regions, shrunk to the covered part */
+            TileList tiles;
+            for (Tile const& tile : split_tiles(whole, Length2D(World::DEFAULT_TILE_SIZE))) {
+                Length2D first = tile.end(), last = tile.start;
+                for (Tile const& region : clipped) {
+                    Tile const covered = tile.intersect(region);
+                    if (!covered.empty()) {
+                        first = ::glm::min(first, covered.start);
+                        last = ::glm::max(last, covered.end());
+                    }
+                }
+                if (first.x < last.x && first.y < last.y) {
+                    tiles.push_back(Tile(first, last - first));
+                }
+            }
+
+            length_t const num_samples = this->_sampler->num_samples();
+            float32 const inverse_num_samples = 1.f / num_samples;
+            parallel_for(static_cast<length_t>(tiles.size()), this->_num_threads,
+                [this, &tiles, &clipped, &figure, &num_samples, &inverse_num_samples] (length_t const& i) {
+                    Tile const& tile = tiles[i];
+                    auto const inside = [&clipped] (Length2D const& index) {
+                        return (clipped.size() == 1) || ::std::any_of(clipped.begin(), clipped.end(),
+                            [&index] (Tile const& region) { return region.contains(index); }
+                        );
+                    };
+                    /* render runs of pixels inside regions on each row */
+                    for (length_t y = tile.start.y; y < tile.end().y; ++y) {
+                        length_t x = tile.start.x;
+                        while (x < tile.end().x) {
+                            if (!inside(Length2D(x, y))) {
+                                ++x;
+                                continue;
+                            }
+                            length_t run_end = x + 1;
+                            while (run_end < tile.end().x && inside(Length2D(run_end, y))) {
+                                ++run_end;
+                            }
+                            Tile const run(Length2D(x, y), Length2D(run_end - x, 1));
+                            GraphicsView const pixels = figure.view(run);
+                            this->render_tile(run, 0, num_samples, pixels);
+                            pixels.for_each([&inverse_num_samples] (RGBColor & pixel_color) { pixel_color *= inverse_num_samples; });
+                            x = run_end;
+                        }
+                    }
+                }
+            );
+        }
+        void inline render_scenes(Tile const& region)
+        {
+            this->render_scenes(TileList(1, region));
+        }
+        /// same as `render_scenes()`, and record wall time and ray queries of each pixel into profile, for finding
+        /// slow parts of figure (see `heatmap`). Timing adds a little time to each pixel.
+        void render_scenes(RenderProfile & profile)
+        {
+            using namespace ::std::chrono;
+            if(!this->valid()) {
+                return;
+            }
+            GraphicsBuffer & figure = this->_camera->figure();
+            profile.resize(figure.size());
+            length_t const num_samples = this->_sampler->num_samples();
+            float32 const inverse_num_samples = 1.f / num_samples;
+            this->_render_tiles_parallel(
+                [this, &figure, &profile, &num_samples, &inverse_num_samples] (Tile const& tile) {
+                    // each pixel is rendered as a tile of its own, so time and rays are told apart between pixels
+                    for (length_t y = tile.start.y; y < tile.end().y; ++y) {
+                        for (length_t x = tile.start.x; x < tile.end().x; ++x) {
+                            Tile const pixel(Length2D(x, y), Length2D(1));
+                            GraphicsView const pixel_color = figure.view(pixel);
+                            uint64 const rays_start = World::_thread_rays;
+                            steady_clock::time_point const time_start = steady_clock::now();
+                            this->render_tile(pixel, 0, num_samples, pixel_color);
+                            profile.seconds(x, y) = duration<float32>(steady_clock::now() - time_start).count();
+                            profile.rays(x, y) = static_cast<uint32>(World::_thread_rays - rays_start);
+                            pixel_color(0, 0) *= inverse_num_samples;
+                        }
+                    }
+                }
+            );
+        }
+
+        /// render features of the first hit on each pixel into aux, see `AuxiliaryBuffers`. Camera rays are
+        /// the ones of the first num_samples samples in `render_scenes` (all samples if 0), so edges of
+        /// features are antialiased like figure. Features are smooth, a few samples are enough.
+        void render_auxiliary(AuxiliaryBuffers & aux, length_t const& num_samples = World::DEFAULT_AUXILIARY_SAMPLES) const
+        {
+            if(!this->valid()) {
+                return;
+            }
+            aux.resize(this->_camera->figure_size());
+            length_t const sample_end = (num_samples > 0) ? ::std::min(num_samples, this->_sampler->num_samples()) : this->_sampler->num_samples();
+            this->_render_tiles_parallel(
+                [this, &aux, &sample_end] (Tile const& tile) {
+                    for (length_t y = tile.start.y; y < tile.end().y; ++y) {
+                        for (length_t x = tile.start.x; x < tile.end().x; ++x) {
+                            this->_render_auxiliary_pixel(Length2D(x, y), sample_end, aux);
+                        }
+                    }
+                }
+            );
+        }
+
+        /// render scenes progressively, each pass adds samples_per_pass samples on every pixel of figure.
+        /// After the last pass, figure is exactly the same as rendered by `render_scenes`.
+        ///
+        /// @param on_pass called in this thread after each pass, snapshots should be handed to other
+        ///                threads here (see `SnapshotWriter`) instead of writing to disk directly
+        void render_progressive(length_t const& samples_per_pass, PassCallback const& on_pass)
+        {
+            if(!this->valid()) {
+                return;
+            }
+            assert(samples_per_pass > 0);
+            GraphicsBuffer & figure = this->_camera->figure();
+            length_t const num_samples = this->_sampler->num_samples();
+            GraphicsBuffer sums(figure.size());
+            for (length_t sample_begin = 0; sample_begin < num_samples; sample_begin += samples_per_pass) {
+                length_t const sample_end = ::std::min(sample_begin + samples_per_pass, num_samples);
+                this->_render_tiles_parallel(
+                    [this, &sums, &sample_begin, &sample_end] (Tile const& tile) {
+                        this->accumulate_tile(tile, sample_begin, sample_end, sums.view(tile));
+                    }
+                );
+                if (on_pass) {
+                    on_pass(sums, sample_end);
+                }
+            }
+            float32 const inverse_num_samples = 1.f / num_samples;
+            transform([&inverse_num_samples] (RGBColor const& sum) { return sum * inverse_num_samples; }, figure, sums);
+        }
+
+        /// progressive rendering for interactive edits. Each call adds samples_per_call samples on every pixel into
+        /// sums kept in world, and writes their average into figure. Sums are reused while `revision` is the same,
+        /// and restart from zero after an edit, so the first call after an edit gives a quick noisy image and
+        /// later calls refine it. Calls after all samples of sampler are taken render nothing. Accelerator is
+        /// refitted after objects are moved or reshaped and rebuilt after objects are added or removed, edits of
+        /// camera and materials reuse it.
+        /// With all samples taken, figure is the same as rendered by `render_scenes`.
+        ///
+        /// @return number of samples on each pixel of figure
+        length_t refine(length_t const& samples_per_call)
+        {
+            if(!this->valid()) {
+                return 0;
+            }
+            assert(samples_per_call > 0);
+            GraphicsBuffer & figure = this->_camera->figure();
+            uint64 const revision = this->revision();
+            if (revision != this->_refine_revision || this->_refine_sums.size() != figure.size()) {
+                this->_refine_sums = GraphicsBuffer(figure.size());
+                this->_refine_num_samples = 0;
+                this->_refine_revision = revision;
+            }
+            length_t const num_samples = this->_sampler->num_samples();
+            length_t const sample_begin = this->_refine_num_samples;
+            if (sample_begin >= num_samples) {
+                return sample_begin;
+            }
+            length_t const sample_end = ::std::min(sample_begin + samples_per_call, num_samples);
+            GraphicsBuffer & sums = this->_refine_sums;
+            this->_render_tiles_parallel(
+                [this, &sums, &sample_begin, &sample_end] (Tile const& tile) {
+                    this->accumulate_tile(tile, sample_begin, sample_end, sums.view(tile));
+                }
+            );
+            this->_refine_num_samples = sample_end;
+            float32 const inverse_num_samples = 1.f / sample_end;
+            transform([&inverse_num_samples] (RGBColor const& sum) { return sum * inverse_num_samples; }, figure, sums);
+            return sample_end;
+        }
+
+        /// render progressively until seconds of wall time are used or all samples of sampler are taken, for jobs
+        /// given a time slot instead of a sample count. Each pass adds samples on every pixel, passes start from one
+        /// sample and double up to samples_per_pass, and are shrunk to the samples that the remaining time affords
+        /// by throughput measured on finished tiles. A tile is started only
+        /// if it is estimated to end before the deadline, so rendering overruns the deadline by at most one tile
+        /// pass. The last pass may cover only some tiles, figure is the average of samples taken on each pixel,
+        /// black where none is taken. Pixels get the same samples as in `render_scenes`, so with all samples
+        /// taken figure is the same.
+        ///
+        /// @param sample_counts reallocated in figure size, number of samples taken on each pixel
+        /// @param samples_per_pass most samples added by one pass
+        TimedRenderStats render_timed(float64 const& seconds, Buffer2D<length_t> & sample_counts, length_t const& samples_per_pass = 1)
+        {
+            using namespace ::std::chrono;
+            steady_clock::time_point const time_start = steady_clock::now();
+            steady_clock::time_point const deadline = time_start + duration_cast<steady_clock::duration>(duration<float64>(seconds));
+            TimedRenderStats stats;
+            if(!this->valid()) {
+                return stats;
+            }
+            assert(samples_per_pass > 0);
+            this->_built_accelerator();     // time of building is not counted in throughput of tiles
+            GraphicsBuffer & figure = this->_camera->figure();
+            length_t const num_samples = this->_sampler->num_samples();
+            float64 const num_pixels = static_cast<float64>(figure.total());
+            TileList const tiles = split_tiles(figure.size(), Length2D(World::DEFAULT_TILE_SIZE));
+            GraphicsBuffer sums(figure.size());
+            sample_counts = Buffer2D<length_t>(figure.size());
+
+            /* thread time per sample on a pixel, measured on finished tiles */
+            ::std::mutex timing_mutex;
+            float64 tile_seconds = 0., tile_samples = 0.;
+            auto const seconds_per_sample = [&timing_mutex, &tile_seconds, &tile_samples] () {
+                ::std::lock_guard<::std::mutex> lock(timing_mutex);
+                return (tile_samples > 0.) ? tile_seconds / tile_samples : 0.;
+            };
+
+            ::std::atomic<bool> out_of_time(false);
+            length_t sample_begin = 0;
+            length_t pass_limit = 1;    // doubled by each pass, so whole figure gets samples early
+            while (sample_begin < num_samples && !out_of_time.load()) {
+                length_t pass = ::std::min({pass_limit, samples_per_pass, num_samples - sample_begin});
+                pass_limit *= 2;
+                float64 const per_sample = seconds_per_sample();
+                if (per_sample > 0.) {
+                    float64 const remaining = duration<float64>(deadline - steady_clock::now()).count();
+                    float64 const affordable = remaining * this->_num_threads / (per_sample * num_pixels);
+                    pass = static_cast<length_t>(::std::clamp(affordable, 1., static_cast<float64>(pass)));
+                }
+                length_t const sample_end = sample_begin + pass;
+                parallel_for(static_cast<length_t>(tiles.size()), this->_num_threads,
+                    [this, &tiles, &sums, &sample_counts, &sample_begin, &sample_end, &deadline, &out_of_time,
+                     &seconds_per_sample, &timing_mutex, &tile_seconds, &tile_samples] (length_t const& i) {
+                        Tile const& tile = tiles[i];
+                        float64 const samples = static_cast<float64>(tile.size.x) * tile.size.y * (sample_end - sample_begin);
+                        steady_clock::time_point const tile_start = steady_clock::now();
+                        // once a tile does not fit, the rest of pass is skipped too
+                        if (out_of_time.load(::std::memory_order_relaxed)
+                            || tile_start + duration_cast<steady_clock::duration>(duration<float64>(samples * seconds_per_sample())) > deadline) {
+                            out_of_time.store(true, ::std::memory_order_relaxed);
+                            return;
+                        }
+                        this->accumulate_tile(tile, sample_begin, sample_end, sums.view(tile));
+                        sample_counts.view(tile).for_each([&sample_end] (length_t & count) { count = sample_end; });
+                        float64 const used = duration<float64>(steady_clock::now() - tile_start).count();
+                        ::std::lock_guard<::std::mutex> lock(timing_mutex);
+                        tile_seconds += used;
+                        tile_samples += samples;
                     }
-                    this->_camera->figure()(x, y) = pixel_color * inverse_num_samples;
+                );
+                ++stats.num_passes;
+                sample_begin = sample_end;
+            }
+
+            transform(
+                [] (RGBColor const& sum, length_t const& count) {
+                    return (count > 0) ? sum * (1.f / count) : constants<float32>::axis3D::O;
+                },
+                figure, sums, sample_counts
+            );
+            stats.min_samples = num_samples;
+            for (length_t y = 0; y < figure.height(); ++y) {
+                for (length_t x = 0; x < figure.width(); ++x) {
+                    stats.min_samples = ::std::min(stats.min_samples, sample_counts(x, y));
+                    stats.max_samples = ::std::max(stats.max_samples, sample_counts(x, y));
                 }
             }
+            stats.seconds = duration<float64>(steady_clock::now() - time_start).count();
+            return stats;
         }
 
 
@@ -127,9 +671,129 @@ namespace nyas
         CameraPtr _camera;
         SamplerPtr _sampler;
         RayTracerPtr _tracer;
+        length_t _num_threads;
+        mutable AcceleratorPtr _accelerator;   // chosen on the first query if `_auto_accelerator`
+        bool _auto_accelerator;
+        mutable ::std::atomic<bool> _accelerator_built;
+        mutable ::std::atomic<uint64> _accelerator_global_geometry;   // `Object3D::global_geometry_revision` checked last time
+        mutable uint64 _accelerator_geometry_sum;                     // sum of geometry revisions of objects in accelerator
+        mutable ::std::mutex _accelerator_mutex;
+        mutable Object3DList _lights;
+        mutable ::std::atomic<bool> _lights_valid;
+        mutable ::std::atomic<uint64> _lights_global_revision;    // `Object3D::global_revision` when lights were collected
+        mutable ::std::mutex _lights_mutex;
+        mutable uint64 _revision;
+        mutable Camera const* _seen_camera;
+        mutable uint64 _seen_camera_revision;
+        mutable uint64 _seen_global_revision;
+        mutable uint64 _object_revision_sum;
+        mutable bool _object_revisions_valid;
+        GraphicsBuffer _refine_sums;
+        length_t _refine_num_samples;
+        uint64 _refine_revision;
+        uint64 inline static thread_local _thread_rays = 0;     // see `thread_rays`
+
+        /// buffers of `accumulate_tile`, kept by each thread so batches reuse memory between tiles
+        struct _TileBatch final
+        {
+            RayBatch rays;
+            ::std::vector<uint64> cursors;
+            ::std::vector<RGBColor> colors;
+        };
+        _TileBatch inline static thread_local _thread_batch;
+
+
+        /// build accelerator once before queries, threads coming at the same time wait for the build. After
+        /// geometry of objects is edited, it is refitted, or built again if refitting fails. Objects are
+        /// checked only after any geometry edit.
+        Accelerator const& _built_accelerator() const
+        {
+            if (!this->_accelerator_built.load(::std::memory_order_acquire)
+                || Object3D::global_geometry_revision() != this->_accelerator_global_geometry.load(::std::memory_order_relaxed)) {
+                ::std::lock_guard<::std::mutex> lock(this->_accelerator_mutex);
+                uint64 const global = Object3D::global_geometry_revision();
+                if (this->_accelerator_built.load(::std::memory_order_relaxed) && global != this->_accelerator_global_geometry.load(::std::memory_order_relaxed)) {
+                    uint64 const sum = this->_geometry_revision_sum();
+                    if (sum != this->_accelerator_geometry_sum) {
+                        this->_accelerator_built.store(this->_accelerator->refit(), ::std::memory_order_relaxed);
+                        this->_accelerator_geometry_sum = sum;
+                    }
+                }
+                if (!this->_accelerator_built.load(::std::memory_order_relaxed)) {
+                    if (this->_auto_accelerator) {
+                        this->_accelerator = accelerators::choose_accelerator(this->_objects);
+                    }
+                    this->_accelerator->build(this->_objects);
+                    this->_accelerator_geometry_sum = this->_geometry_revision_sum();
+                    this->_accelerator_built.store(true, ::std::memory_order_release);
+                }
+                this->_accelerator_global_geometry.store(global, ::std::memory_order_relaxed);
+            }
+            return *this->_accelerator;
+        }
+
+        /// average features of first hits of camera rays on pixel, depth and normal are averaged on hits only
+        void _render_auxiliary_pixel(Length2D const& index, length_t const& num_samples, AuxiliaryBuffers & aux) const
+        {
+            uint64 const pixel = static_cast<uint64>(index.y) * this->_camera->figure_size().x + index.x;
+            RGBColor albedo = constants<float32>::axis3D::O;
+            Vector3D normal = constants<float64>::axis3D::O;
+            float64 depth = 0.;
+            length_t num_hits = 0;
+            for (length_t n = 0; n < num_samples; ++n) {
+                this->_sampler->seek(pixel * this->_sampler->num_samples() + n);
+                Ray const ray = this->_camera->get_ray_sample(index);
+                RayHittingRecord rec;
+                if (this->hit(ray, rec.t, rec)) {
+                    albedo += RGBColor(rec.object->BRDF()->albedo());
+                    normal += normalize((dot(rec.normal, ray.direction) < 0) ? rec.normal : -rec.normal);
+                    depth += rec.t * length(ray.direction);
+                    ++num_hits;
+                }
+                else {
+                    albedo += this->_sky->get_color(ray.direction);
+                }
+            }
+            aux.albedo(index) = albedo * (1.f / num_samples);
+            aux.normal(index) = (length2(normal) > 0.) ? RGBColor(normalize(normal)) : constants<float32>::axis3D::O;
+            aux.depth(index) = (num_hits > 0) ? static_cast<float32>(depth / num_hits) : constants<float32>::infinity;
+        }
+
+        uint64 _geometry_revision_sum() const
+        {
+            uint64 sum = 0;
+            for (Object3DPtr const& obj : this->_objects) {
+                sum += obj->geometry_revision();
+            }
+            return sum;
+        }
+
+        /// call render_tile for each tile on whole figure in parallel
+        template<typename Func>
+        void _render_tiles_parallel(Func const& render_tile) const
+        {
+            TileList const tiles = split_tiles(this->_camera->figure_size(), Length2D(World::DEFAULT_TILE_SIZE));
+            parallel_for(static_cast<length_t>(tiles.size()), this->_num_threads,
+                [&tiles, &render_tile] (length_t const& i) {
+                    render_tile(tiles[i]);
+                }
+            );
+        }
     };
 
     typedef shared_ptr<World> WorldPtr;
     typedef shared_ptr<World const> WorldConstptr;
 
+
+    // defined here, because it needs a complete World
+    void inline RayTracer::trace_rays(RayBatch const& rays, uint64 const* cursors, RGBColor * colors) const
+    {
+        Sampler & sampler = *this->_world->sampler();
+        length_t const size = rays.size();
+        for (length_t i = 0; i < size; ++i) {
+            sampler.seek(cursors[i] + 1);
+            colors[i] = this->trace_ray(rays.ray(i));
+        }
+    }
+
 } // namespace nyas
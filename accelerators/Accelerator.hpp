@@ -0,0 +1,150 @@
+/// @file accelerators/Accelerator.hpp
+#pragma once
+
+#include "../common/types.hpp"
+#include "../Ray.hpp"
+#include "../AABB.hpp"
+#include "../objects/Object3D.hpp"
+#include <chrono>
+#include <string>
+
+
+namespace nyas
+{
+    /// numbers reported by an accelerator after building
+    struct AcceleratorStats final
+    {
+        length_t num_objects;       // objects given to build
+        length_t num_unbounded;     // objects tested by every ray, e.g. without finite bounding box
+        length_t num_nodes;         // nodes of tree or cells of grid
+        uint64 num_references;      // object indices stored in nodes or cells
+        uint64 memory_bytes;        // memory used by the structure, objects themselves are not counted
+        float64 build_seconds;      // wall time of the last build
+        float64 refit_seconds;      // wall time of the last refit, 0 if not refitted after the last build
+
+
+        AcceleratorStats()
+            : num_objects(0)
+            , num_unbounded(0)
+            , num_nodes(0)
+            , num_references(0)
+            , memory_bytes(0)
+            , build_seconds(0.)
+            , refit_seconds(0.)
+        {}
+    };
+
+
+    /// Spatial index over objects of a world, it answers closest-hit queries without testing every object.
+    ///
+    /// `build` keeps a list of the objects, queries are thread-safe after building. Accelerators must be
+    /// rebuilt after objects are added or removed, and refitted or rebuilt after objects are moved or resized.
+    class Accelerator
+    {
+    public:
+        Accelerator()
+            : _objects()
+            , _stats()
+        {}
+        virtual ~Accelerator() = default;
+
+        /// build structure over objects, the time used is recorded in `stats().build_seconds`
+        Accelerator & build(Object3DList const& objects)
+        {
+            using namespace ::std::chrono;
+            steady_clock::time_point const time_start = steady_clock::now();
+            this->_objects = objects;
+            this->_stats = AcceleratorStats();
+            this->_stats.num_objects = static_cast<length_t>(objects.size());
+            this->_build();
+            this->_stats.build_seconds = duration<float64>(steady_clock::now() - time_start).count();
+            return *this;
+        }
+
+        /// update structure after the same objects are moved or resized, usually much faster than building.
+        /// The time used is recorded in `stats().refit_seconds`.
+        ///
+        /// @return false if structure cannot be refitted or is too degraded by refitting, then it must be built
+        bool refit()
+        {
+            using namespace ::std::chrono;
+            steady_clock::time_point const time_start = steady_clock::now();
+            bool const refitted = this->_refit();
+            this->_stats.refit_seconds = duration<float64>(steady_clock::now() - time_start).count();
+            return refitted;
+        }
+
+        Object3DList inline const& objects() const
+        {
+            return this->_objects;
+        }
+        AcceleratorStats inline const& stats() const
+        {
+            return this->_stats;
+        }
+
+        /// name of structure for reports
+        string virtual name() const = 0;
+
+        /// same as `Object3D::intersect` on all objects: true if any object is hit before t_max, then t,
+        /// object and primitive of rec are the closest hit, other fields are not written
+        bool virtual intersect(Ray const& ray, float64 const& t_max, RayHittingRecord & rec) const = 0;
+
+        /// same as `Object3D::hit` on all objects, surface of the closest hit is computed once after searching
+        bool inline hit(Ray const& ray, float64 const& t_max, RayHittingRecord & rec) const
+        {
+            if (!this->intersect(ray, t_max, rec)) {
+                return false;
+            }
+            rec.object->interact(ray, rec);
+            return true;
+        }
+
+        /// any-hit query: true if any object is hit before t_max. Searching stops at the first hit found, and
+        /// no record is written.
+        bool virtual occluded(Ray const& ray, float64 const& t_max) const = 0;
+
+
+    protected:
+        /// build structure over `_objects`, and fill `_stats` except `num_objects` and `build_seconds`
+        void virtual _build() = 0;
+
+        /// refit structure over `_objects`, structures not supporting it keep this default
+        bool virtual _refit()
+        {
+            return false;
+        }
+
+        /// intersect objects by indices one by one, t_max is shrunk by each hit
+        bool inline _intersect_objects(uint32 const* begin, uint32 const* end, Ray const& ray, float64 const& t_max, RayHittingRecord & rec) const
+        {
+            bool hit_anything = false;
+            for (uint32 const* index = begin; index != end; ++index) {
+                Object3D const* const obj = this->_objects[*index].get();
+                if (obj->intersect(ray, hit_anything ? rec.t : t_max, rec.t, rec.primitive)) {
+                    rec.object = obj;
+                    hit_anything = true;
+                }
+            }
+            return hit_anything;
+        }
+
+        /// test objects by indices one by one, stop at the first hit
+        bool inline _occluded_objects(uint32 const* begin, uint32 const* end, Ray const& ray, float64 const& t_max) const
+        {
+            for (uint32 const* index = begin; index != end; ++index) {
+                if (this->_objects[*index]->occluded(ray, t_max)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        Object3DList _objects;
+        AcceleratorStats _stats;
+    };
+
+    typedef shared_ptr<Accelerator> AcceleratorPtr;
+    typedef shared_ptr<Accelerator const> AcceleratorConstptr;
+
+} // namespace nyas
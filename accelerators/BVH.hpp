@@ -0,0 +1,899 @@
+/// @file accelerators/BVH.hpp
+#pragma once
+
+#include "Accelerator.hpp"
+#include "../utils.hpp"
+#include "../MappedFile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+
+namespace nyas
+{
+    namespace accelerators
+    {
+        /// node of BVH in a flat array. Children of interior node are nodes[offset] and nodes[offset + 1],
+        /// objects of leaf are indices[offset : offset + count].
+        struct BVHNode final
+        {
+            Point3D low;
+            Point3D high;
+            uint32 offset;
+            uint16 count;       // number of objects, 0 for interior node
+            uint16 axis;        // split axis of interior node, the first child is on the lower side
+
+
+            bool inline leaf() const
+            {
+                return this->count > 0;
+            }
+            AABB inline bounds() const
+            {
+                return AABB(this->low, this->high);
+            }
+        };
+        static_assert(::std::is_trivially_copyable_v<BVHNode> && sizeof(BVHNode) == 56, "BVHNode is stored in files as bytes");
+
+
+        /// Header of BVH file. The file is the header followed by nodes, indices of objects in leaves and
+        /// indices of unbounded objects, each array starts at a byte offset from the start of file, so the
+        /// file is used in place after mapping. Numbers are in native byte order.
+        struct BVHFileHeader final
+        {
+            char magic[8];              // "nyasBVH"
+            uint32 version;
+            uint32 node_size;           // sizeof(BVHNode)
+            uint64 key;                 // hash of bounding boxes of objects and build parameters
+            uint32 num_objects;
+            uint32 num_nodes;
+            uint32 num_indices;
+            uint32 num_unbounded;
+            uint32 num_bins;
+            uint32 max_leaf_size;
+            uint32 depth;
+            uint32 reserved;
+            float64 sah_cost;
+            uint64 nodes_offset;
+            uint64 indices_offset;
+            uint64 unbounded_offset;
+        };
+
+
+        /// Bounding volume hierarchy built by binned surface area heuristic (SAH) on multiple threads.
+        ///
+        /// Large nodes near the root are split one by one, each split bins objects on all threads. When
+        /// there are enough small subtrees, they are built in parallel, one subtree on one thread.
+        /// Number of bins is the knob between build speed and tree quality: 8 bins builds fast, 32 bins
+        /// gives a slightly better tree. Objects without finite bounds are tested by every ray.
+        ///
+        /// After objects move, `refit` updates bounds of nodes bottom-up in parallel and keeps the tree. Refitted
+        /// trees get worse as objects drift away from their neighbours, so refitting fails once SAH cost grows
+        /// over `max_refit_cost_ratio` times the cost of the built tree, then the tree should be built again.
+        class BVH final : public Accelerator
+        {
+        public:
+            length_t static constexpr MAX_DEPTH = 64;           // depth of tree, also size of traversal stack
+            length_t static constexpr MAX_BINS = 64;
+            length_t static constexpr MAX_LEAF_SIZE = 255;
+            uint32 static constexpr FILE_VERSION = 1;
+
+
+            BVH()
+                : Accelerator()
+                , _num_bins(16)
+                , _max_leaf_size(4)
+                , _num_threads(default_num_threads())
+                , _cache_directory()
+                , _nodes()
+                , _indices()
+                , _unbounded()
+                , _node_data(nullptr)
+                , _num_nodes(0)
+                , _index_data(nullptr)
+                , _num_indices(0)
+                , _unbounded_data(nullptr)
+                , _num_unbounded(0)
+                , _file(nullptr)
+                , _from_cache(false)
+                , _geometry_key(0)
+                , _sah_cost(0.)
+                , _built_sah_cost(0.)
+                , _max_refit_cost_ratio(1.5)
+                , _depth(0)
+                , _allocated_nodes(0)
+                , _primitives()
+            {}
+            /// @param num_bins bins on split axis for evaluating splits, in range [2, MAX_BINS]
+            /// @param max_leaf_size nodes with more objects are always split
+            explicit BVH(length_t const& num_bins, length_t const& max_leaf_size = 4)
+                : BVH()
+            {
+                this->set_num_bins(num_bins);
+                this->set_max_leaf_size(max_leaf_size);
+            }
+
+            BVH inline & set_num_bins(length_t const& num_bins)
+            {
+                this->_num_bins = ::std::clamp(num_bins, 2, MAX_BINS);
+                return *this;
+            }
+            BVH inline & set_max_leaf_size(length_t const& max_leaf_size)
+            {
+                this->_max_leaf_size = ::std::clamp(max_leaf_size, 1, MAX_LEAF_SIZE);
+                return *this;
+            }
+            /// set number of threads used in building, including the calling thread
+            BVH inline & set_num_threads(length_t const& num_threads)
+            {
+                this->_num_threads = ::std::max(num_threads, 1);
+                return *this;
+            }
+            /// refitting fails if SAH cost grows over ratio times the cost of the built tree
+            BVH inline & set_max_refit_cost_ratio(float64 const& ratio)
+            {
+                this->_max_refit_cost_ratio = ratio;
+                return *this;
+            }
+            /// keep built trees in directory, `build` maps a cached tree of the same objects instead of
+            /// building again. Empty for no cache, which is the default.
+            BVH inline & set_cache_directory(string const& directory)
+            {
+                this->_cache_directory = directory;
+                return *this;
+            }
+
+            length_t inline num_bins() const
+            {
+                return this->_num_bins;
+            }
+            length_t inline max_leaf_size() const
+            {
+                return this->_max_leaf_size;
+            }
+            length_t inline num_threads() const
+            {
+                return this->_num_threads;
+            }
+            float64 inline max_refit_cost_ratio() const
+            {
+                return this->_max_refit_cost_ratio;
+            }
+            string inline const& cache_directory() const
+            {
+                return this->_cache_directory;
+            }
+            /// true if the last `build` or `load` mapped a tree from file instead of building it
+            bool inline from_cache() const
+            {
+                return this->_from_cache;
+            }
+            BVHNode inline const* nodes() const
+            {
+                return this->_node_data;
+            }
+            length_t inline num_nodes() const
+            {
+                return static_cast<length_t>(this->_num_nodes);
+            }
+            /// SAH cost of tree: expected number of node visits and object tests of a random ray hitting the
+            /// root, lower is better. Trees of the same objects can be compared by it.
+            float64 inline sah_cost() const
+            {
+                return this->_sah_cost;
+            }
+            /// SAH cost of tree when it was built, `sah_cost` grows from it by refitting
+            float64 inline built_sah_cost() const
+            {
+                return this->_built_sah_cost;
+            }
+            length_t inline depth() const
+            {
+                return this->_depth;
+            }
+
+            string virtual name() const override
+            {
+                return "BVH";
+            }
+
+            /// write tree into file in the layout of `BVHFileHeader`, true for success
+            bool save(string const& file_name) const
+            {
+                if (this->_node_data == nullptr && this->_num_unbounded == 0) {
+                    return false;
+                }
+                // key of refitted tree is computed only when needed
+                return this->_save(file_name, (this->_geometry_key != 0) ? this->_geometry_key : this->_key(this->_object_boxes()));
+            }
+            /// map a tree saved by `save` from file instead of building it. The file is used only if it was
+            /// saved from objects with the same bounding boxes in the same order, and with the same number of
+            /// bins and leaf size. Files are trusted, only header is checked.
+            ///
+            /// @return false if file is missing or does not match objects, then this BVH is empty
+            bool load(string const& file_name, Object3DList const& objects)
+            {
+                using namespace ::std::chrono;
+                steady_clock::time_point const time_start = steady_clock::now();
+                this->_objects = objects;
+                this->_stats = AcceleratorStats();
+                this->_stats.num_objects = static_cast<length_t>(objects.size());
+                this->_clear();
+                bool const loaded = this->_map(file_name, this->_key(this->_object_boxes()));
+                this->_stats.build_seconds = duration<float64>(steady_clock::now() - time_start).count();
+                return loaded;
+            }
+
+            bool virtual intersect(Ray const& ray, float64 const& t_max, RayHittingRecord & rec) const override
+            {
+                bool hit_anything = this->_intersect_objects(this->_unbounded_data, this->_unbounded_data + this->_num_unbounded, ray, t_max, rec);
+                float64 t_limit = hit_anything ? rec.t : t_max;
+                if (this->_num_nodes == 0) {
+                    return hit_anything;
+                }
+                BVHNode const* const nodes = this->_node_data;
+                Vector3D const inverse_direction = 1. / ray.direction;
+                float64 t_enter, t_exit;
+                if (!nodes[0].bounds().hit(ray, inverse_direction, t_limit, t_enter, t_exit)) {
+                    return hit_anything;
+                }
+
+                uint32 stack[MAX_DEPTH + 1];
+                float64 stack_t[MAX_DEPTH + 1];     // entering time of nodes in stack
+                length_t top = 0;
+                uint32 current = 0;
+                while (true) {
+                    BVHNode const& node = nodes[current];
+                    if (node.leaf()) {
+                        uint32 const* const indices = this->_index_data + node.offset;
+                        if (this->_intersect_objects(indices, indices + node.count, ray, t_limit, rec)) {
+                            hit_anything = true;
+                            t_limit = rec.t;
+                        }
+                    }
+                    else {
+                        // visit the child on the side ray comes from first
+                        uint32 const near = node.offset + ((ray.direction[node.axis] < 0.) ? 1 : 0);
+                        uint32 const far = node.offset + ((ray.direction[node.axis] < 0.) ? 0 : 1);
+                        float64 t_near, t_far, t_exit_near, t_exit_far;
+                        bool const hit_near = nodes[near].bounds().hit(ray, inverse_direction, t_limit, t_near, t_exit_near);
+                        bool const hit_far = nodes[far].bounds().hit(ray, inverse_direction, t_limit, t_far, t_exit_far);
+                        if (hit_near && hit_far) {
+                            stack[top] = far;
+                            stack_t[top++] = t_far;
+                            current = near;
+                            continue;
+                        }
+                        if (hit_near || hit_far) {
+                            current = hit_near ? near : far;
+                            continue;
+                        }
+                    }
+                    // skip nodes behind the closest hit found after they are pushed
+                    do {
+                        if (top == 0) {
+                            return hit_anything;
+                        }
+                        current = stack[--top];
+                    } while (stack_t[top] > t_limit);
+                }
+            }
+
+            /// any-hit traversal: children are visited in any order and t_max is never shrunk, so no entering
+            /// times are kept and the first hit ends the search
+            bool virtual occluded(Ray const& ray, float64 const& t_max) const override
+            {
+                if (this->_occluded_objects(this->_unbounded_data, this->_unbounded_data + this->_num_unbounded, ray, t_max)) {
+                    return true;
+                }
+                if (this->_num_nodes == 0) {
+                    return false;
+                }
+                BVHNode const* const nodes = this->_node_data;
+                Vector3D const inverse_direction = 1. / ray.direction;
+                float64 t_enter, t_exit;
+                if (!nodes[0].bounds().hit(ray, inverse_direction, t_max, t_enter, t_exit)) {
+                    return false;
+                }
+
+                uint32 stack[MAX_DEPTH + 1];
+                length_t top = 0;
+                uint32 current = 0;
+                while (true) {
+                    BVHNode const& node = nodes[current];
+                    if (node.leaf()) {
+                        uint32 const* const indices = this->_index_data + node.offset;
+                        if (this->_occluded_objects(indices, indices + node.count, ray, t_max)) {
+                            return true;
+                        }
+                    }
+                    else {
+                        bool const hit_first = nodes[node.offset].bounds().hit(ray, inverse_direction, t_max, t_enter, t_exit);
+                        bool const hit_second = nodes[node.offset + 1].bounds().hit(ray, inverse_direction, t_max, t_enter, t_exit);
+                        if (hit_first && hit_second) {
+                            stack[top++] = node.offset + 1;
+                            current = node.offset;
+                            continue;
+                        }
+                        if (hit_first || hit_second) {
+                            current = hit_first ? node.offset : node.offset + 1;
+                            continue;
+                        }
+                    }
+                    if (top == 0) {
+                        return false;
+                    }
+                    current = stack[--top];
+                }
+            }
+
+
+        protected:
+            void virtual _build() override
+            {
+                length_t const num_objects = static_cast<length_t>(this->_objects.size());
+                this->_clear();
+                ::std::vector<AABB> const boxes = this->_object_boxes();
+                uint64 const key = this->_key(boxes);
+                string const cache_file = this->_cache_directory.empty() ? string() : this->_cache_file(key);
+                if (!cache_file.empty() && this->_map(cache_file, key)) {
+                    return;
+                }
+                for (length_t i = 0; i < num_objects; ++i) {
+                    if (!boxes[i].finite()) {
+                        this->_unbounded.push_back(static_cast<uint32>(i));
+                    }
+                    else if (!boxes[i].empty()) {
+                        this->_primitives.push_back(_Primitive{boxes[i], static_cast<uint32>(i)});
+                    }
+                }
+                this->_stats.num_unbounded = static_cast<length_t>(this->_unbounded.size());
+
+                uint32 const num_bounded = static_cast<uint32>(this->_primitives.size());
+                if (num_bounded > 0) {
+                    this->_nodes.resize(2 * num_bounded - 1);
+                    this->_allocated_nodes = 1;
+
+                    /* split large nodes one by one with parallel binning, until there are enough subtrees */
+                    uint32 const parallel_size = ::std::max(num_bounded / static_cast<uint32>(4 * this->_num_threads), 4096u);
+                    _Task root{0, 0, num_bounded, 0, AABB(), AABB()};
+                    this->_bound_objects(root, true);
+                    ::std::vector<_Task> large(1, root), small;
+                    while (!large.empty()) {
+                        _Task const task = large.back();
+                        large.pop_back();
+                        _Task children[2];
+                        if (this->_split(task, true, children)) {
+                            for (_Task const& child : children) {
+                                ((child.end - child.begin > parallel_size) ? large : small).push_back(child);
+                            }
+                        }
+                    }
+
+                    /* build small subtrees in parallel */
+                    parallel_for(static_cast<length_t>(small.size()), this->_num_threads, [this, &small] (length_t const& i) {
+                        ::std::vector<_Task> stack(1, small[i]);
+                        while (!stack.empty()) {
+                            _Task const task = stack.back();
+                            stack.pop_back();
+                            _Task children[2];
+                            if (this->_split(task, false, children)) {
+                                stack.push_back(children[1]);
+                                stack.push_back(children[0]);
+                            }
+                        }
+                    });
+                    this->_nodes.resize(this->_allocated_nodes);
+                    this->_sah_cost = this->_compute_sah_cost();
+                    this->_built_sah_cost = this->_sah_cost;
+                }
+                this->_indices.resize(this->_primitives.size());
+                for (size_t i = 0; i < this->_primitives.size(); ++i) {
+                    this->_indices[i] = this->_primitives[i].index;
+                }
+                this->_primitives.clear();
+                this->_primitives.shrink_to_fit();
+                this->_geometry_key = key;
+                this->_point_to_vectors();
+                if (!cache_file.empty() && makedir(this->_cache_directory)) {
+                    this->_save(cache_file, key);
+                }
+            }
+
+            /// update bounds of nodes from current bounds of objects. The tree is split into top nodes and about
+            /// 4 subtrees for each thread, subtrees are refitted in parallel, then top nodes.
+            bool virtual _refit() override
+            {
+                this->_copy_mapped();
+                this->_geometry_key = 0;
+                if (this->_nodes.empty()) {
+                    return true;
+                }
+                ::std::vector<AABB> const boxes = this->_object_boxes();
+
+                /* expand subtrees level by level, expanded roots become top nodes */
+                ::std::vector<uint32> top, subtrees(1, 0), next;
+                while (static_cast<length_t>(subtrees.size()) < 4 * this->_num_threads) {
+                    next.clear();
+                    for (uint32 const& root : subtrees) {
+                        BVHNode const& node = this->_nodes[root];
+                        if (node.leaf()) {
+                            next.push_back(root);
+                        }
+                        else {
+                            top.push_back(root);
+                            next.push_back(node.offset);
+                            next.push_back(node.offset + 1);
+                        }
+                    }
+                    if (next.size() == subtrees.size()) {
+                        break;
+                    }
+                    subtrees.swap(next);
+                }
+
+                /* refit subtrees in parallel, nodes are visited after all nodes below them */
+                ::std::vector<float64> costs(subtrees.size(), 0.);
+                ::std::atomic<bool> bounded(true);
+                parallel_for(static_cast<length_t>(subtrees.size()), this->_num_threads, [this, &subtrees, &boxes, &costs, &bounded] (length_t const& i) {
+                    ::std::vector<uint32> order, stack(1, subtrees[i]);
+                    while (!stack.empty()) {
+                        uint32 const index = stack.back();
+                        stack.pop_back();
+                        order.push_back(index);
+                        if (!this->_nodes[index].leaf()) {
+                            stack.push_back(this->_nodes[index].offset);
+                            stack.push_back(this->_nodes[index].offset + 1);
+                        }
+                    }
+                    for (auto index = order.rbegin(); index != order.rend(); ++index) {
+                        costs[i] += this->_refit_node(*index, boxes);
+                    }
+                    if (!this->_nodes[subtrees[i]].bounds().finite()) {
+                        bounded = false;
+                    }
+                });
+                if (!bounded) {
+                    return false;       // an object in leaves has no finite bounds now
+                }
+                float64 cost = 0.;
+                for (float64 const& subtree_cost : costs) {
+                    cost += subtree_cost;
+                }
+                for (auto index = top.rbegin(); index != top.rend(); ++index) {
+                    cost += this->_refit_node(*index, boxes);
+                }
+
+                float64 const root_area = this->_nodes[0].bounds().surface_area();
+                this->_sah_cost = (root_area > 0.) ? cost / root_area : static_cast<float64>(this->_num_indices);
+                return this->_sah_cost <= this->_max_refit_cost_ratio * this->_built_sah_cost;
+            }
+
+
+        private:
+            /// object in building, objects are moved in place by partitions, so each node reads a contiguous range
+            struct _Primitive final
+            {
+                AABB box;
+                uint32 index;
+
+
+                float64 inline centroid(length_t const& axis) const
+                {
+                    return (this->box.low[axis] + this->box.high[axis]) * 0.5;
+                }
+            };
+
+            /// node to be built over primitives[begin : end]
+            struct _Task final
+            {
+                uint32 node;
+                uint32 begin;
+                uint32 end;
+                length_t depth;
+                AABB bounds;            // bounds of objects
+                AABB centroid_bounds;   // bounds of centroids of objects
+            };
+
+            struct _Bin final
+            {
+                AABB bounds;
+                AABB centroid_bounds;
+                uint32 count;
+
+
+                _Bin()
+                    : bounds()
+                    , centroid_bounds()
+                    , count(0)
+                {}
+
+                _Bin inline & add(_Primitive const& primitive)
+                {
+                    this->bounds.extend(primitive.box);
+                    this->centroid_bounds.extend(primitive.box.center());
+                    ++this->count;
+                    return *this;
+                }
+                _Bin inline & merge(_Bin const& bin)
+                {
+                    this->bounds.extend(bin.bounds);
+                    this->centroid_bounds.extend(bin.centroid_bounds);
+                    this->count += bin.count;
+                    return *this;
+                }
+            };
+
+
+            /// bounding boxes of all objects, computed in parallel
+            ::std::vector<AABB> _object_boxes() const
+            {
+                length_t const num_objects = static_cast<length_t>(this->_objects.size());
+                ::std::vector<AABB> boxes(num_objects);
+                length_t const num_chunks = this->_num_chunks(num_objects);
+                parallel_for(num_chunks, this->_num_threads, [this, &boxes, &num_objects, &num_chunks] (length_t const& chunk) {
+                    for (length_t i = chunk * num_objects / num_chunks; i < (chunk + 1) * num_objects / num_chunks; ++i) {
+                        boxes[i] = this->_objects[i]->bounding_box();
+                    }
+                });
+                return boxes;
+            }
+
+            /// key of tree in files, tree depends only on bounding boxes of objects and build parameters
+            uint64 _key(::std::vector<AABB> const& boxes) const
+            {
+                uint32 const parameters[4] = {FILE_VERSION, static_cast<uint32>(boxes.size()),
+                    static_cast<uint32>(this->_num_bins), static_cast<uint32>(this->_max_leaf_size)};
+                return hash_bytes(boxes.data(), boxes.size() * sizeof(AABB), hash_bytes(parameters, sizeof(parameters)));
+            }
+            string _cache_file(uint64 const& key) const
+            {
+                char name[24];
+                ::std::snprintf(name, sizeof(name), "%016llx.bvh", static_cast<unsigned long long>(key));
+                return this->_cache_directory + "/" + name;
+            }
+
+            void _clear()
+            {
+                this->_nodes.clear();
+                this->_indices.clear();
+                this->_unbounded.clear();
+                this->_node_data = nullptr;
+                this->_num_nodes = 0;
+                this->_index_data = nullptr;
+                this->_num_indices = 0;
+                this->_unbounded_data = nullptr;
+                this->_num_unbounded = 0;
+                this->_file = nullptr;
+                this->_from_cache = false;
+                this->_geometry_key = 0;
+                this->_sah_cost = 0.;
+                this->_built_sah_cost = 0.;
+                this->_depth = 0;
+            }
+            /// copy tree mapped from file into vectors, so it can be changed
+            void _copy_mapped()
+            {
+                if (this->_file == nullptr) {
+                    return;
+                }
+                this->_nodes.assign(this->_node_data, this->_node_data + this->_num_nodes);
+                this->_indices.assign(this->_index_data, this->_index_data + this->_num_indices);
+                this->_unbounded.assign(this->_unbounded_data, this->_unbounded_data + this->_num_unbounded);
+                this->_file = nullptr;
+                this->_from_cache = false;
+                this->_point_to_vectors();
+            }
+            void _fill_stats()
+            {
+                this->_stats.num_unbounded = static_cast<length_t>(this->_num_unbounded);
+                this->_stats.num_nodes = static_cast<length_t>(this->_num_nodes);
+                this->_stats.num_references = this->_num_indices;
+                this->_stats.memory_bytes = this->_num_nodes * sizeof(BVHNode) + (this->_num_indices + this->_num_unbounded) * sizeof(uint32);
+            }
+            void _point_to_vectors()
+            {
+                this->_node_data = this->_nodes.data();
+                this->_num_nodes = static_cast<uint32>(this->_nodes.size());
+                this->_index_data = this->_indices.data();
+                this->_num_indices = static_cast<uint32>(this->_indices.size());
+                this->_unbounded_data = this->_unbounded.data();
+                this->_num_unbounded = static_cast<uint32>(this->_unbounded.size());
+                this->_fill_stats();
+            }
+
+            /// write file through a temporary file, so other processes never map a half-written tree
+            bool _save(string const& file_name, uint64 const& key) const
+            {
+                uint64 constexpr ALIGNMENT = 8;
+                auto const align = [&ALIGNMENT] (uint64 const& offset) { return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; };
+                BVHFileHeader header;
+                ::std::memset(&header, 0, sizeof(header));
+                ::std::memcpy(header.magic, "nyasBVH", 8);
+                header.version = FILE_VERSION;
+                header.node_size = sizeof(BVHNode);
+                header.key = key;
+                header.num_objects = static_cast<uint32>(this->_objects.size());
+                header.num_nodes = this->_num_nodes;
+                header.num_indices = this->_num_indices;
+                header.num_unbounded = this->_num_unbounded;
+                header.num_bins = static_cast<uint32>(this->_num_bins);
+                header.max_leaf_size = static_cast<uint32>(this->_max_leaf_size);
+                header.depth = static_cast<uint32>(this->_depth.load());
+                header.sah_cost = this->_sah_cost;
+                header.nodes_offset = align(sizeof(BVHFileHeader));
+                header.indices_offset = align(header.nodes_offset + uint64(this->_num_nodes) * sizeof(BVHNode));
+                header.unbounded_offset = align(header.indices_offset + uint64(this->_num_indices) * sizeof(uint32));
+
+                string const temporary = file_name + ".tmp";
+                ::std::FILE * file = ::std::fopen(temporary.c_str(), "wb");
+                if (file == nullptr) {
+                    return false;
+                }
+                uint64 written = 0;
+                auto const put = [&file, &written] (void const* data, uint64 const& offset, uint64 const& size) {
+                    uint8 const zeros[ALIGNMENT] = {0};
+                    bool good = ::std::fwrite(zeros, 1, offset - written, file) == offset - written;
+                    good = good && (size == 0 || ::std::fwrite(data, 1, size, file) == size);
+                    written = offset + size;
+                    return good;
+                };
+                bool good = put(&header, 0, sizeof(header));
+                good = good && put(this->_node_data, header.nodes_offset, uint64(this->_num_nodes) * sizeof(BVHNode));
+                good = good && put(this->_index_data, header.indices_offset, uint64(this->_num_indices) * sizeof(uint32));
+                good = good && put(this->_unbounded_data, header.unbounded_offset, uint64(this->_num_unbounded) * sizeof(uint32));
+                good = (::std::fclose(file) == 0) && good;
+                if (good) {
+                    ::std::remove(file_name.c_str());
+                    good = ::std::rename(temporary.c_str(), file_name.c_str()) == 0;
+                }
+                if (!good) {
+                    ::std::remove(temporary.c_str());
+                }
+                return good;
+            }
+
+            /// use tree in file if it matches key. Arrays are used in place in the mapped file on every platform
+            /// (see `MappedFile`), pages are loaded by the OS on first access and nothing is copied or fixed up.
+            bool _map(string const& file_name, uint64 const& key)
+            {
+                MappedFilePtr const file = make_shared<MappedFile>(file_name, MapMode::Read);
+                if (!file->valid() || file->size() < sizeof(BVHFileHeader)) {
+                    return false;
+                }
+                BVHFileHeader header;
+                ::std::memcpy(&header, file->data(), sizeof(header));
+                auto const fits = [&file] (uint64 const& offset, uint64 const& size, uint64 const& alignment) {
+                    return offset % alignment == 0 && offset <= file->size() && size <= file->size() - offset;
+                };
+                if (::std::memcmp(header.magic, "nyasBVH", 8) != 0 || header.version != FILE_VERSION || header.node_size != sizeof(BVHNode)
+                    || header.key != key || header.num_objects != this->_objects.size()
+                    || !fits(header.nodes_offset, uint64(header.num_nodes) * sizeof(BVHNode), alignof(BVHNode))
+                    || !fits(header.indices_offset, uint64(header.num_indices) * sizeof(uint32), alignof(uint32))
+                    || !fits(header.unbounded_offset, uint64(header.num_unbounded) * sizeof(uint32), alignof(uint32))) {
+                    return false;
+                }
+                uint8 const* const base = static_cast<uint8 const*>(static_cast<MappedFile const&>(*file).data());
+                this->_node_data = reinterpret_cast<BVHNode const*>(base + header.nodes_offset);
+                this->_num_nodes = header.num_nodes;
+                this->_index_data = reinterpret_cast<uint32 const*>(base + header.indices_offset);
+                this->_num_indices = header.num_indices;
+                this->_unbounded_data = reinterpret_cast<uint32 const*>(base + header.unbounded_offset);
+                this->_num_unbounded = header.num_unbounded;
+                this->_file = file;
+                this->_from_cache = true;
+                this->_geometry_key = key;
+                this->_sah_cost = header.sah_cost;
+                this->_built_sah_cost = header.sah_cost;
+                this->_depth = static_cast<length_t>(header.depth);
+                this->_fill_stats();
+                return true;
+            }
+
+            length_t inline _num_chunks(length_t const& count) const
+            {
+                return ::std::clamp(count / 16384, 1, 4 * this->_num_threads);
+            }
+
+            /// call func(begin, end) on each chunk of task range, on all threads if parallel
+            template<typename Func>
+            void _for_each_chunk(_Task const& task, length_t const& num_chunks, Func const& func) const
+            {
+                uint64 const count = task.end - task.begin;
+                auto const chunk_range = [&task, &count, &num_chunks, &func] (length_t const& chunk) {
+                    func(chunk, task.begin + static_cast<uint32>(count * chunk / num_chunks), task.begin + static_cast<uint32>(count * (chunk + 1) / num_chunks));
+                };
+                if (num_chunks > 1) {
+                    parallel_for(num_chunks, this->_num_threads, chunk_range);
+                }
+                else {
+                    chunk_range(0);
+                }
+            }
+
+            /// compute bounds of task from objects
+            void _bound_objects(_Task & task, bool const& parallel) const
+            {
+                length_t const num_chunks = parallel ? this->_num_chunks(task.end - task.begin) : 1;
+                ::std::vector<_Bin> chunks(num_chunks);
+                this->_for_each_chunk(task, num_chunks, [this, &chunks] (length_t const& chunk, uint32 const& begin, uint32 const& end) {
+                    for (uint32 i = begin; i < end; ++i) {
+                        chunks[chunk].add(this->_primitives[i]);
+                    }
+                });
+                for (length_t chunk = 1; chunk < num_chunks; ++chunk) {
+                    chunks[0].merge(chunks[chunk]);
+                }
+                task.bounds = chunks[0].bounds;
+                task.centroid_bounds = chunks[0].centroid_bounds;
+            }
+
+            /// set bounds of task node, then make it a leaf, or split it and return its children with bounds
+            ///
+            /// @param parallel bin objects on all threads, for large nodes
+            bool _split(_Task const& task, bool const& parallel, _Task (&children)[2])
+            {
+                uint32 const count = task.end - task.begin;
+                _Primitive * const primitives = this->_primitives.data();
+                BVHNode & node = this->_nodes[task.node];
+                node.low = task.bounds.low;
+                node.high = task.bounds.high;
+                if (count <= static_cast<uint32>(this->_max_leaf_size)) {
+                    this->_make_leaf(task);
+                    return false;
+                }
+
+                length_t const axis = task.centroid_bounds.longest_axis();
+                float64 const low = task.centroid_bounds.low[axis];
+                float64 const extent = task.centroid_bounds.high[axis] - low;
+                uint32 middle = task.begin;
+                _Bin left, right;
+                if (extent > 0. && task.depth < MAX_DEPTH / 2) {
+                    /* bin objects by centroids on the longest axis, and find the split with the lowest SAH cost */
+                    length_t const num_bins = this->_num_bins;
+                    float64 const scale = num_bins / extent;
+                    auto const bin_of = [&axis, &low, &scale, &num_bins] (_Primitive const& primitive) {
+                        return ::std::min(static_cast<length_t>((primitive.centroid(axis) - low) * scale), num_bins - 1);
+                    };
+                    length_t const num_chunks = parallel ? this->_num_chunks(count) : 1;
+                    ::std::vector<_Bin> all_bins(num_chunks * num_bins);
+                    _Bin * const bins = all_bins.data();
+                    this->_for_each_chunk(task, num_chunks, [&primitives, &bins, &bin_of, &num_bins] (length_t const& chunk, uint32 const& begin, uint32 const& end) {
+                        _Bin * const chunk_bins = bins + chunk * num_bins;
+                        for (uint32 i = begin; i < end; ++i) {
+                            chunk_bins[bin_of(primitives[i])].add(primitives[i]);
+                        }
+                    });
+                    for (length_t chunk = 1; chunk < num_chunks; ++chunk) {
+                        for (length_t b = 0; b < num_bins; ++b) {
+                            bins[b].merge(bins[chunk * num_bins + b]);
+                        }
+                    }
+
+                    // cost of split after bin b is area(left) * count(left) + area(right) * count(right)
+                    ::std::vector<_Bin> rights(num_bins);   // rights[b] is bins in [b, num_bins)
+                    rights[num_bins - 1] = bins[num_bins - 1];
+                    for (length_t b = num_bins - 2; b > 0; --b) {
+                        rights[b] = rights[b + 1];
+                        rights[b].merge(bins[b]);
+                    }
+                    _Bin lefts;
+                    float64 best_cost = constants<float64>::infinity;
+                    length_t best_bin = 0;
+                    for (length_t b = 0; b + 1 < num_bins; ++b) {
+                        lefts.merge(bins[b]);
+                        float64 const cost = lefts.bounds.surface_area() * lefts.count
+                            + rights[b + 1].bounds.surface_area() * rights[b + 1].count;
+                        if (lefts.count > 0 && lefts.count < count && cost < best_cost) {
+                            best_cost = cost;
+                            best_bin = b;
+                            left = lefts;
+                        }
+                    }
+                    if (best_cost < constants<float64>::infinity) {
+                        right = rights[best_bin + 1];
+                        middle = static_cast<uint32>(::std::partition(primitives + task.begin, primitives + task.end,
+                            [&bin_of, &best_bin] (_Primitive const& primitive) { return bin_of(primitive) <= best_bin; }
+                        ) - primitives);
+                    }
+                }
+
+                uint32 const first = this->_allocated_nodes.fetch_add(2);
+                node.offset = first;
+                node.count = 0;
+                node.axis = static_cast<uint16>(axis);
+                if (middle == task.begin || middle == task.end) {
+                    /* all centroids in one bin, or tree is too deep: split at median */
+                    middle = task.begin + count / 2;
+                    ::std::nth_element(primitives + task.begin, primitives + middle, primitives + task.end,
+                        [&axis] (_Primitive const& a, _Primitive const& b) { return a.centroid(axis) < b.centroid(axis); }
+                    );
+                    children[0] = _Task{first, task.begin, middle, task.depth + 1, AABB(), AABB()};
+                    children[1] = _Task{first + 1, middle, task.end, task.depth + 1, AABB(), AABB()};
+                    this->_bound_objects(children[0], parallel);
+                    this->_bound_objects(children[1], parallel);
+                }
+                else {
+                    children[0] = _Task{first, task.begin, middle, task.depth + 1, left.bounds, left.centroid_bounds};
+                    children[1] = _Task{first + 1, middle, task.end, task.depth + 1, right.bounds, right.centroid_bounds};
+                }
+                return true;
+            }
+
+            void inline _make_leaf(_Task const& task)
+            {
+                BVHNode & node = this->_nodes[task.node];
+                node.offset = task.begin;
+                node.count = static_cast<uint16>(task.end - task.begin);
+                node.axis = 0;
+                // depth is only written by leaves, racing threads keep the maximum
+                length_t depth = this->_depth.load();
+                while (task.depth > depth && !this->_depth.compare_exchange_weak(depth, task.depth)) {}
+            }
+
+            /// set bounds of node from its objects or children, return its unnormalized SAH cost
+            float64 inline _refit_node(uint32 const& index, ::std::vector<AABB> const& boxes)
+            {
+                BVHNode & node = this->_nodes[index];
+                AABB bounds;
+                if (node.leaf()) {
+                    for (uint32 i = node.offset; i < node.offset + node.count; ++i) {
+                        bounds.extend(boxes[this->_indices[i]]);
+                    }
+                }
+                else {
+                    bounds.extend(this->_nodes[node.offset].bounds());
+                    bounds.extend(this->_nodes[node.offset + 1].bounds());
+                }
+                node.low = bounds.low;
+                node.high = bounds.high;
+                return bounds.surface_area() * (node.leaf() ? node.count : 1.);
+            }
+
+            float64 _compute_sah_cost() const
+            {
+                float64 const root_area = this->_nodes[0].bounds().surface_area();
+                if (root_area <= 0.) {
+                    return static_cast<float64>(this->_primitives.size());
+                }
+                float64 cost = 0.;
+                for (BVHNode const& node : this->_nodes) {
+                    cost += node.bounds().surface_area() / root_area * (node.leaf() ? node.count : 1.);
+                }
+                return cost;
+            }
+
+
+            length_t _num_bins;
+            length_t _max_leaf_size;
+            length_t _num_threads;
+            string _cache_directory;
+            ::std::vector<BVHNode> _nodes;          // storage of built tree, empty if mapped from file
+            ::std::vector<uint32> _indices;
+            ::std::vector<uint32> _unbounded;
+            BVHNode const* _node_data;              // tree in use, in vectors above or in mapped file
+            uint32 _num_nodes;
+            uint32 const* _index_data;              // objects in leaves
+            uint32 _num_indices;
+            uint32 const* _unbounded_data;          // objects tested by every ray
+            uint32 _num_unbounded;
+            MappedFilePtr _file;                    // file of tree if mapped
+            bool _from_cache;
+            uint64 _geometry_key;
+            float64 _sah_cost;
+            float64 _built_sah_cost;
+            float64 _max_refit_cost_ratio;
+            ::std::atomic<length_t> _depth;
+            ::std::atomic<uint32> _allocated_nodes; // nodes allocated while building
+            ::std::vector<_Primitive> _primitives;  // objects while building
+        };
+
+        typedef shared_ptr<BVH> BVHPtr;
+        typedef shared_ptr<BVH const> BVHConstptr;
+
+    } // namespace accelerators
+
+} // namespace nyas
@@ -0,0 +1,62 @@
+/// @file accelerators/Linear.hpp
+#pragma once
+
+#include "Accelerator.hpp"
+
+
+namespace nyas
+{
+    namespace accelerators
+    {
+        /// no structure, every ray tests every object. Fastest for a few objects.
+        class Linear final : public Accelerator
+        {
+        public:
+            Linear()
+                : Accelerator()
+            {}
+
+            string virtual name() const override
+            {
+                return "Linear";
+            }
+
+            bool virtual intersect(Ray const& ray, float64 const& t_max, RayHittingRecord & rec) const override
+            {
+                bool hit_anything = false;
+                for (Object3DPtr const& obj : this->_objects) {
+                    if (obj->intersect(ray, hit_anything ? rec.t : t_max, rec.t, rec.primitive)) {
+                        rec.object = obj.get();
+                        hit_anything = true;
+                    }
+                }
+                return hit_anything;
+            }
+            bool virtual occluded(Ray const& ray, float64 const& t_max) const override
+            {
+                for (Object3DPtr const& obj : this->_objects) {
+                    if (obj->occluded(ray, t_max)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+
+        protected:
+            void virtual _build() override
+            {
+                this->_stats.num_unbounded = static_cast<length_t>(this->_objects.size());
+            }
+            bool virtual _refit() override
+            {
+                return true;
+            }
+        };
+
+        typedef shared_ptr<Linear> LinearPtr;
+        typedef shared_ptr<Linear const> LinearConstptr;
+
+    } // namespace accelerators
+
+} // namespace nyas
@@ -0,0 +1,286 @@
+/// @file accelerators/UniformGrid.hpp
+#pragma once
+
+#include "Accelerator.hpp"
+#include "../common/functions.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+namespace nyas
+{
+    namespace accelerators
+    {
+        /// Regular grid of cells over bounds of objects, each cell lists objects overlapping it. Rays walk
+        /// through cells in order by 3D-DDA and stop at the first cell containing the closest hit.
+        ///
+        /// Works best for many objects in similar sizes, e.g. particles. Objects much larger than the median
+        /// object (e.g. a huge sphere as floor) or without finite bounds are not put into cells, they are
+        /// tested by every ray, so they do not stretch the grid.
+        class UniformGrid final : public Accelerator
+        {
+        public:
+            typedef vec<3, length_t> Resolution;
+
+            length_t static constexpr MAX_RESOLUTION = 512;     // cells on each axis at most
+
+
+            UniformGrid()
+                : Accelerator()
+                , _density(2.)
+                , _large_factor(8.)
+                , _bounds()
+                , _resolution(0)
+                , _cell_size(0.)
+                , _inverse_cell_size(0.)
+                , _cell_begins()
+                , _cell_objects()
+                , _unbounded()
+            {}
+            /// @param density average number of cells per object
+            /// @param large_factor objects with diagonal larger than large_factor times the median are not in grid
+            explicit UniformGrid(float64 const& density, float64 const& large_factor = 8.)
+                : UniformGrid()
+            {
+                this->_density = density;
+                this->_large_factor = large_factor;
+            }
+
+            UniformGrid inline & set_density(float64 const& density)
+            {
+                this->_density = density;
+                return *this;
+            }
+            UniformGrid inline & set_large_factor(float64 const& large_factor)
+            {
+                this->_large_factor = large_factor;
+                return *this;
+            }
+
+            float64 inline density() const
+            {
+                return this->_density;
+            }
+            float64 inline large_factor() const
+            {
+                return this->_large_factor;
+            }
+            AABB inline const& bounds() const
+            {
+                return this->_bounds;
+            }
+            Resolution inline resolution() const
+            {
+                return this->_resolution;
+            }
+
+            string virtual name() const override
+            {
+                return "UniformGrid";
+            }
+
+            bool virtual intersect(Ray const& ray, float64 const& t_max, RayHittingRecord & rec) const override
+            {
+                bool hit_anything = this->_intersect_objects(this->_unbounded.data(), this->_unbounded.data() + this->_unbounded.size(), ray, t_max, rec);
+                float64 t_limit = hit_anything ? rec.t : t_max;
+                this->_walk(ray, t_limit,
+                    [this, &ray, &rec, &hit_anything, &t_limit] (uint32 const* begin, uint32 const* end) {
+                        if (this->_intersect_objects(begin, end, ray, t_limit, rec)) {
+                            hit_anything = true;
+                            t_limit = rec.t;
+                        }
+                        return false;
+                    }
+                );
+                return hit_anything;
+            }
+
+            /// any-hit walk through cells, the first hit ends the walk
+            bool virtual occluded(Ray const& ray, float64 const& t_max) const override
+            {
+                if (this->_occluded_objects(this->_unbounded.data(), this->_unbounded.data() + this->_unbounded.size(), ray, t_max)) {
+                    return true;
+                }
+                return this->_walk(ray, t_max,
+                    [this, &ray, &t_max] (uint32 const* begin, uint32 const* end) {
+                        return this->_occluded_objects(begin, end, ray, t_max);
+                    }
+                );
+            }
+
+        protected:
+            void virtual _build() override
+            {
+                length_t const num_objects = static_cast<length_t>(this->_objects.size());
+                this->_bounds = AABB();
+                this->_resolution = Resolution(0);
+                this->_cell_begins.clear();
+                this->_cell_objects.clear();
+                this->_unbounded.clear();
+
+                /* separate objects too large for grid */
+                ::std::vector<AABB> boxes(num_objects);
+                ::std::vector<float64> diagonals;
+                for (length_t i = 0; i < num_objects; ++i) {
+                    boxes[i] = this->_objects[i]->bounding_box();
+                    if (boxes[i].finite()) {
+                        diagonals.push_back(boxes[i].diagonal());
+                    }
+                }
+                float64 median = 0.;
+                if (!diagonals.empty()) {
+                    ::std::nth_element(diagonals.begin(), diagonals.begin() + diagonals.size() / 2, diagonals.end());
+                    median = diagonals[diagonals.size() / 2];
+                }
+                ::std::vector<uint32> in_grid;
+                for (length_t i = 0; i < num_objects; ++i) {
+                    if (!boxes[i].finite() || boxes[i].diagonal() > this->_large_factor * median) {
+                        this->_unbounded.push_back(static_cast<uint32>(i));
+                    }
+                    else if (!boxes[i].empty()) {
+                        in_grid.push_back(static_cast<uint32>(i));
+                        this->_bounds.extend(boxes[i]);
+                    }
+                }
+                this->_stats.num_unbounded = static_cast<length_t>(this->_unbounded.size());
+                this->_stats.memory_bytes = this->_unbounded.size() * sizeof(uint32);
+                if (in_grid.empty()) {
+                    return;
+                }
+
+                /* resolution: about density cells per object, cells are close to cubes */
+                Vector3D extent = this->_bounds.extent();
+                float64 const longest = ::std::max({extent.x, extent.y, extent.z, 1e-300});
+                extent = ::glm::max(extent, Vector3D(longest * 1e-3));      // flat scenes still have some volume
+                this->_bounds.high = this->_bounds.low + extent;
+                float64 const cells_per_length = ::std::cbrt(this->_density * in_grid.size() / (extent.x * extent.y * extent.z));
+                for (length_t axis = 0; axis < 3; ++axis) {
+                    this->_resolution[axis] = static_cast<length_t>(::std::clamp(extent[axis] * cells_per_length, 1., static_cast<float64>(MAX_RESOLUTION)));
+                }
+                this->_cell_size = extent / Vector3D(this->_resolution);
+                this->_inverse_cell_size = Vector3D(this->_resolution) / extent;
+                length_t const num_cells = this->_resolution.x * this->_resolution.y * this->_resolution.z;
+
+                /* count objects in cells, then fill cells in compressed rows */
+                this->_cell_begins.assign(num_cells + 1, 0);
+                auto const for_each_cell = [this, &boxes] (uint32 const& i, auto const& func) {
+                    Resolution const low = this->_cell_index(boxes[i].low), high = this->_cell_index(boxes[i].high);
+                    for (length_t z = low.z; z <= high.z; ++z) {
+                        for (length_t y = low.y; y <= high.y; ++y) {
+                            for (length_t x = low.x; x <= high.x; ++x) {
+                                func((z * this->_resolution.y + y) * this->_resolution.x + x);
+                            }
+                        }
+                    }
+                };
+                for (uint32 const& i : in_grid) {
+                    for_each_cell(i, [this] (length_t const& cell) { ++this->_cell_begins[cell + 1]; });
+                }
+                for (length_t cell = 0; cell < num_cells; ++cell) {
+                    this->_cell_begins[cell + 1] += this->_cell_begins[cell];
+                }
+                this->_cell_objects.resize(this->_cell_begins[num_cells]);
+                ::std::vector<uint32> fill(this->_cell_begins.begin(), this->_cell_begins.end() - 1);
+                for (uint32 const& i : in_grid) {
+                    for_each_cell(i, [this, &fill, &i] (length_t const& cell) { this->_cell_objects[fill[cell]++] = i; });
+                }
+
+                this->_stats.num_nodes = num_cells;
+                this->_stats.num_references = this->_cell_objects.size();
+                this->_stats.memory_bytes += (this->_cell_begins.size() + this->_cell_objects.size()) * sizeof(uint32);
+            }
+
+
+        private:
+            /// walk through cells pierced by ray in order by 3D-DDA, calling visit_cell(begin, end) on indices of
+            /// objects in each cell. Walk ends when visit_cell returns true, when t_limit is in the cell just visited,
+            /// or when ray leaves grid. t_limit may be shrunk by visit_cell while walking, e.g. by closer hits.
+            ///
+            /// @return true if visit_cell returned true
+            template<typename VisitCell>
+            bool _walk(Ray const& ray, float64 const& t_limit, VisitCell const& visit_cell) const
+            {
+                if (this->_cell_objects.empty()) {
+                    return false;
+                }
+                Vector3D const inverse_direction = 1. / ray.direction;
+                float64 t_enter, t_exit;
+                if (!this->_bounds.hit(ray, inverse_direction, t_limit, t_enter, t_exit)) {
+                    return false;
+                }
+
+                /* set up 3D-DDA from the point entering grid */
+                Point3D const entry = ray.at(t_enter);
+                Resolution cell, step, stop;
+                Vector3D t_next, t_delta;
+                for (length_t axis = 0; axis < 3; ++axis) {
+                    cell[axis] = this->_cell_index(entry[axis], axis);
+                    if (ray.direction[axis] > 0.) {
+                        step[axis] = 1;
+                        stop[axis] = this->_resolution[axis];
+                        t_next[axis] = (this->_bounds.low[axis] + (cell[axis] + 1) * this->_cell_size[axis] - ray.origin[axis]) * inverse_direction[axis];
+                        t_delta[axis] = this->_cell_size[axis] * inverse_direction[axis];
+                    }
+                    else if (ray.direction[axis] < 0.) {
+                        step[axis] = -1;
+                        stop[axis] = -1;
+                        t_next[axis] = (this->_bounds.low[axis] + cell[axis] * this->_cell_size[axis] - ray.origin[axis]) * inverse_direction[axis];
+                        t_delta[axis] = -this->_cell_size[axis] * inverse_direction[axis];
+                    }
+                    else {
+                        step[axis] = 0;
+                        stop[axis] = -1;
+                        t_next[axis] = constants<float64>::infinity;
+                        t_delta[axis] = constants<float64>::infinity;
+                    }
+                }
+
+                /* walk through cells */
+                uint32 const* const objects = this->_cell_objects.data();
+                while (true) {
+                    length_t const index = (cell.z * this->_resolution.y + cell.y) * this->_resolution.x + cell.x;
+                    if (visit_cell(objects + this->_cell_begins[index], objects + this->_cell_begins[index + 1])) {
+                        return true;
+                    }
+                    length_t const axis = (t_next.x < t_next.y) ? ((t_next.x < t_next.z) ? 0 : 2) : ((t_next.y < t_next.z) ? 1 : 2);
+                    // t_limit is in this cell, or ray leaves grid
+                    if (t_limit <= t_next[axis] || t_next[axis] > t_exit) {
+                        return false;
+                    }
+                    cell[axis] += step[axis];
+                    if (cell[axis] == stop[axis]) {
+                        return false;
+                    }
+                    t_next[axis] += t_delta[axis];
+                }
+            }
+
+            length_t inline _cell_index(float64 const& position, length_t const& axis) const
+            {
+                length_t const index = static_cast<length_t>((position - this->_bounds.low[axis]) * this->_inverse_cell_size[axis]);
+                return ::std::clamp(index, 0, this->_resolution[axis] - 1);
+            }
+            Resolution inline _cell_index(Point3D const& p) const
+            {
+                return Resolution(this->_cell_index(p.x, 0), this->_cell_index(p.y, 1), this->_cell_index(p.z, 2));
+            }
+
+
+            float64 _density;
+            float64 _large_factor;
+            AABB _bounds;
+            Resolution _resolution;
+            Vector3D _cell_size;
+            Vector3D _inverse_cell_size;
+            ::std::vector<uint32> _cell_begins;     // objects in cell i are _cell_objects[_cell_begins[i] : _cell_begins[i + 1]]
+            ::std::vector<uint32> _cell_objects;
+            ::std::vector<uint32> _unbounded;       // objects tested by every ray
+        };
+
+        typedef shared_ptr<UniformGrid> UniformGridPtr;
+        typedef shared_ptr<UniformGrid const> UniformGridConstptr;
+
+    } // namespace accelerators
+
+} // namespace nyas
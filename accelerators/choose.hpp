@@ -0,0 +1,53 @@
+/// @file accelerators/choose.hpp
+#pragma once
+
+#include "Accelerator.hpp"
+#include "Linear.hpp"
+#include "UniformGrid.hpp"
+#include "BVH.hpp"
+#include <algorithm>
+#include <vector>
+
+
+namespace nyas
+{
+    namespace accelerators
+    {
+        length_t constexpr AUTO_MIN_OBJECTS = 32;       // fewer objects are tested one by one
+        float64 constexpr AUTO_MAX_SIZE_SPREAD = 8.;    // grid is used only for objects in similar sizes, BVH otherwise
+
+        /// ratio of the 90th to the 10th percentile of diagonals of finite bounding boxes, 1 for objects in
+        /// the same size. Unbounded objects are ignored.
+        float64 size_spread(Object3DList const& objects)
+        {
+            ::std::vector<float64> diagonals;
+            for (Object3DPtr const& obj : objects) {
+                AABB const box = obj->bounding_box();
+                if (box.finite() && !box.empty()) {
+                    diagonals.push_back(box.diagonal());
+                }
+            }
+            if (diagonals.empty()) {
+                return 1.;
+            }
+            ::std::sort(diagonals.begin(), diagonals.end());
+            float64 const low = diagonals[diagonals.size() / 10];
+            float64 const high = diagonals[diagonals.size() * 9 / 10];
+            return (low > 0.) ? high / low : constants<float64>::infinity;
+        }
+
+        /// choose accelerator by number of objects and spread of object sizes, the result is not built yet
+        AcceleratorPtr choose_accelerator(Object3DList const& objects)
+        {
+            if (static_cast<length_t>(objects.size()) < AUTO_MIN_OBJECTS) {
+                return make_shared<Linear>();
+            }
+            if (size_spread(objects) <= AUTO_MAX_SIZE_SPREAD) {
+                return make_shared<UniformGrid>();
+            }
+            return make_shared<BVH>();
+        }
+
+    } // namespace accelerators
+
+} // namespace nyas
@@ -0,0 +1,110 @@
+/// @file animation/Animation.hpp
+#pragma once
+
+#include "Keyframes.hpp"
+#include "../common/types.hpp"
+#include "../World.hpp"
+#include "../images/FrameWriter.hpp"
+#include <assert.h>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+
+namespace nyas
+{
+    /// called after each frame is rendered into figure of camera
+    typedef ::std::function<void(GraphicsBuffer const& figure, length_t const& frame)> FrameCallback;
+
+
+    /// Frames of an animation. Tracks set cameras and objects by keyframes at the time of each frame, through
+    /// their setters, so `World` finds the edits: accelerator is refitted after objects move, while sky,
+    /// sampler tables, tracer, figure and the accelerator itself are reused by all frames.
+    class Animation final
+    {
+    public:
+        /// set something at time in seconds
+        typedef ::std::function<void(float64 const& time)> Track;
+
+
+        explicit Animation(length_t const& num_frames, float64 const& frames_per_second = 24.)
+            : _num_frames(num_frames)
+            , _frames_per_second(frames_per_second)
+            , _tracks()
+        {
+            assert(num_frames > 0 && frames_per_second > 0.);
+        }
+
+        Animation inline & add_track(Track const& track)
+        {
+            this->_tracks.push_back(track);
+            return *this;
+        }
+        /// call apply with value of keyframes at time of each frame, e.g. `[ball] (Point3D const& c) { ball->set_center(c); }`
+        template<typename T, typename Apply>
+        Animation inline & add_track(Keyframes<T> const& keyframes, Apply const& apply)
+        {
+            assert(!keyframes.empty());
+            this->_tracks.push_back([keyframes, apply] (float64 const& time) { apply(keyframes.at(time)); });
+            return *this;
+        }
+
+        length_t inline num_frames() const
+        {
+            return this->_num_frames;
+        }
+        float64 inline frames_per_second() const
+        {
+            return this->_frames_per_second;
+        }
+        float64 inline time(length_t const& frame) const
+        {
+            return frame / this->_frames_per_second;
+        }
+
+        /// set all tracks at time of frame
+        void apply(length_t const& frame) const
+        {
+            float64 const t = this->time(frame);
+            for (Track const& track : this->_tracks) {
+                track(t);
+            }
+        }
+
+        /// render frames one by one into figure of camera, and hand each frame to on_frame
+        ///
+        /// @return seconds used by rendering each frame, on_frame is not counted
+        ::std::vector<float64> render(World & world, FrameCallback const& on_frame) const
+        {
+            using namespace ::std::chrono;
+            ::std::vector<float64> seconds;
+            seconds.reserve(this->_num_frames);
+            for (length_t frame = 0; frame < this->_num_frames; ++frame) {
+                steady_clock::time_point const time_start = steady_clock::now();
+                this->apply(frame);
+                world.render_scenes();
+                seconds.push_back(duration<float64>(steady_clock::now() - time_start).count());
+                if (on_frame) {
+                    on_frame(world.camera()->figure(), frame);
+                }
+            }
+            return seconds;
+        }
+        /// render frames and write them by writer, encoding of each frame overlaps rendering of the next one
+        ::std::vector<float64> inline render(World & world, FrameWriter & writer) const
+        {
+            ::std::vector<float64> const seconds = this->render(world,
+                [&writer] (GraphicsBuffer const& figure, length_t const& frame) { writer.write(figure, frame); }
+            );
+            writer.flush();
+            return seconds;
+        }
+
+
+    private:
+        length_t _num_frames;
+        float64 _frames_per_second;
+        ::std::vector<Track> _tracks;
+    };
+
+} // namespace nyas
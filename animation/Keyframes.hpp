@@ -0,0 +1,75 @@
+/// @file animation/Keyframes.hpp
+#pragma once
+
+#include "../common/types.hpp"
+#include <algorithm>
+#include <vector>
+
+
+namespace nyas
+{
+    /// Values at some times, values between keys are linearly interpolated, and the first or last value is
+    /// held outside keys. T needs `T + T` and `T * float64`, e.g. float64, Point3D and Vector3D.
+    template<typename T>
+    class Keyframes final
+    {
+    public:
+        Keyframes()
+            : _times()
+            , _values()
+        {}
+
+        /// set value at time, keys are kept in order of time, a key at the same time is replaced
+        Keyframes inline & set(float64 const& time, T const& value)
+        {
+            auto const position = ::std::lower_bound(this->_times.begin(), this->_times.end(), time);
+            length_t const index = static_cast<length_t>(position - this->_times.begin());
+            if (position != this->_times.end() && *position == time) {
+                this->_values[index] = value;
+            }
+            else {
+                this->_times.insert(position, time);
+                this->_values.insert(this->_values.begin() + index, value);
+            }
+            return *this;
+        }
+
+        length_t inline size() const
+        {
+            return static_cast<length_t>(this->_times.size());
+        }
+        bool inline empty() const
+        {
+            return this->_times.empty();
+        }
+        ::std::vector<float64> inline const& times() const
+        {
+            return this->_times;
+        }
+        ::std::vector<T> inline const& values() const
+        {
+            return this->_values;
+        }
+
+        /// value at time, there must be at least one key
+        T at(float64 const& time) const
+        {
+            auto const position = ::std::upper_bound(this->_times.begin(), this->_times.end(), time);
+            if (position == this->_times.begin()) {
+                return this->_values.front();
+            }
+            if (position == this->_times.end()) {
+                return this->_values.back();
+            }
+            length_t const index = static_cast<length_t>(position - this->_times.begin());
+            float64 const s = (time - this->_times[index - 1]) / (this->_times[index] - this->_times[index - 1]);
+            return this->_values[index - 1] * (1. - s) + this->_values[index] * s;
+        }
+
+
+    private:
+        ::std::vector<float64> _times;
+        ::std::vector<T> _values;
+    };
+
+} // namespace nyas
@@ -2,6 +2,8 @@
 #pragma once
 
 #include "../common/types.hpp"
+#include "../common/constants.hpp"
+#include "../common/functions.hpp"
 #include "../common/randoms.hpp"
 #include "../samplers/Sampler.hpp"
 #include <memory>
@@ -32,13 +34,30 @@ namespace nyas
         /// @param outgoing outgoing ray direction, it should leave from surface
         float32 virtual operator()(Vector3D const& normal, Vector3D const& incident, Vector3D const& outgoing) const = 0;
 
+        /// fraction of light reflected, used as color of surface by denoising and previews. By default it is
+        /// the BRDF value at normal incidence.
+        float32 virtual albedo() const
+        {
+            Vector3D const normal(0., 0., 1.);
+            return (*this)(normal, -normal, normal);
+        }
+
         /// return outgoing ray direction meets the BRDF.
         ///
         /// @param normal surface normal that ray hit object, it should be facing out of surface
         /// @param incident incident ray direction, it should point to surface, instead of leaving
         Vector3D inline scatter(Vector3D const& normal, Vector3D const& incident) const
         {
-            Vector3D const tar = Sampler::map_to_hemisphere(this->_sampler->sample_uniform2D(), 1.);
+            return this->scatter(normal, incident, this->_sampler->sample_uniform2D());
+        }
+        /// return outgoing ray direction meets the BRDF, using a given sample instead of taking one from sampler.
+        ///
+        /// @param normal surface normal that ray hit object, it should be facing out of surface
+        /// @param incident incident ray direction, it should point to surface, instead of leaving
+        /// @param sample point in unit-square (range [0, 1]^2)
+        Vector3D scatter(Vector3D const& normal, Vector3D const& /*incident*/, Point2D const& sample) const
+        {
+            Vector3D const tar = Sampler::map_to_hemisphere(sample, 1.);
             //Vector3D const tar = Sampler::map_to_hemisphere(random::uniform2D(), 1.);
             float64 const
                 r3D = length(normal),
@@ -53,6 +72,15 @@ namespace nyas
                 cb * tar.z - sb * tar.y
             );
         }
+        /// density in solid angle of outgoing directions given by `scatter`, which are cosine-weighted around normal
+        ///
+        /// @param normal surface normal that ray hit object, it should be facing out of surface
+        /// @param outgoing outgoing ray direction, it should leave from surface
+        float64 inline pdf(Vector3D const& normal, Vector3D const& outgoing) const
+        {
+            float64 const c = dot(normal, outgoing) / (length(normal) * length(outgoing));
+            return (c > 0.) ? c * constants<float64>::one_over_pi : 0.;
+        }
 
 
     protected:
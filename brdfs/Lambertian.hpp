@@ -37,6 +37,10 @@ namespace nyas
             {
                 return this->_diffuse;
             }
+            float32 virtual albedo() const override
+            {
+                return this->_diffuse;
+            }
 
 
         private:
@@ -6,6 +6,8 @@
 #include "../common/functions.hpp"
 #include "../samplers/Sampler.hpp"
 #include "../Ray.hpp"
+#include "../RayBatch.hpp"
+#include "../Tile.hpp"
 #include "../Buffer2D.hpp"
 #include <memory>
 #include <tuple>
@@ -49,6 +51,7 @@ namespace nyas
             , _figure_u(figure_u)
             , _figure_v(figure_v)
             , _sampler(sampler)
+            , _revision(0)
         {
 #ifdef REDUCE_POINT_BEYOND_RANGE
             this->_inverse_figure_size = 1. / Point2D(this->_figure.size());
@@ -67,28 +70,33 @@ namespace nyas
         Camera inline & set_figure_direction_u(Vector3D const& u)
         {
             this->_figure_u = u;
+            ++this->_revision;
             return *this;
 
         }
         Camera inline & set_figure_direction_v(Vector3D const& v)
         {
             this->_figure_v = v;
+            ++this->_revision;
             return *this;
         }
         Camera inline & set_figure_directions(Vector3D const& u, Vector3D const& v)
         {
             this->_figure_u = u;
             this->_figure_v = v;
+            ++this->_revision;
             return *this;
         }
         Camera inline & set_figure_center(Point3D const& c)
         {
             this->_figure_center = c;
+            ++this->_revision;
             return *this;
         }
         Camera inline & set_sampler(SamplerPtr const& sampler)
         {
             this->_sampler = sampler;
+            ++this->_revision;
             return *this;
         }
 
@@ -124,6 +132,11 @@ namespace nyas
         {
             return this->_sampler;
         }
+        /// increased by every edit of camera through setters, pixels written into figure are not edits
+        uint64 inline revision() const
+        {
+            return this->_revision;
+        }
 
         /// get point position on figure in 3D-space
         ///
@@ -163,14 +176,93 @@ namespace nyas
 
         Ray virtual get_ray_sample(Length2D const& p) const = 0;
 
+        /// get rays of samples in range [sample_begin, sample_end) on all pixels in tile. Ray of sample n on
+        /// pixel (x, y) in tile is at ((y * tile.size.x + x) * (sample_end - sample_begin) + n - sample_begin).
+        /// Samples are taken at the same cursors as `World::render_sample`, so rays are the same as
+        /// `get_ray_sample` up to floating-point rounding.
+        ///
+        /// This default calls `get_ray` on each sample, cameras override it with loops over whole batch.
+        void virtual get_ray_samples(Tile const& tile, length_t const& sample_begin, length_t const& sample_end, RayBatch & rays) const
+        {
+            length_t const num_samples = sample_end - sample_begin;
+            rays.resize(tile.total() * num_samples);
+            Point2D const inverse_size = 1. / Point2D(this->_figure.size());
+            length_t i = 0;
+            for (length_t y = tile.start.y; y < tile.end().y; ++y) {
+                for (length_t x = tile.start.x; x < tile.end().x; ++x) {
+                    uint64 const cursor = this->_sample_cursor(Length2D(x, y), sample_begin);
+                    for (length_t n = 0; n < num_samples; ++n) {
+                        Point2D const p = (Point2D(x, y) + this->_sampler->sample_at(cursor + n)) * inverse_size * 2. - 1.;
+                        rays.set_ray(i++, this->get_ray(p));
+                    }
+                }
+            }
+        }
+
 
     protected:
+        /// sampler cursor of the first sample on pixel, same as `World::render_sample`
+        uint64 inline _sample_cursor(Length2D const& index, length_t const& sample) const
+        {
+            uint64 const pixel = static_cast<uint64>(index.y) * this->_figure.width() + index.x;
+            return pixel * this->_sampler->num_samples() + sample;
+        }
+
+        /// fill origins of `get_ray_samples` with jittered points on figure. Points on pixel corners are
+        /// stepped along each row, and range reduction is skipped if all samples are in unit square.
+        void _figure_points(Tile const& tile, length_t const& sample_begin, length_t const& sample_end, RayBatch & rays) const
+        {
+            length_t const num_samples = sample_end - sample_begin;
+            rays.resize(tile.total() * num_samples);
+            Point2D const inverse_size = 1. / Point2D(this->_figure.size());
+            Vector3D const step_u = (2. * inverse_size.x) * this->_figure_u;
+            Vector3D const step_v = (2. * inverse_size.y) * this->_figure_v;
+            Point3D const corner = this->_figure_center - this->_figure_u - this->_figure_v;     // point at (-1, -1)
+#ifdef REDUCE_POINT_BEYOND_RANGE
+            bool const in_range = this->_sampler->samples_in_unit_square();
+#else
+            bool constexpr in_range = true;
+#endif
+            SampleList const& samples = this->_sampler->samples();
+            length_t const num_total = this->_sampler->num_total();
+            float64 * const ox = rays.origin_x.data();
+            float64 * const oy = rays.origin_y.data();
+            float64 * const oz = rays.origin_z.data();
+
+            length_t i = 0;
+            for (length_t y = tile.start.y; y < tile.end().y; ++y) {
+                Point3D pixel = corner + float64(y) * step_v + float64(tile.start.x) * step_u;
+                for (length_t x = tile.start.x; x < tile.end().x; ++x, pixel += step_u, i += num_samples) {
+                    uint64 const cursor = this->_sample_cursor(Length2D(x, y), sample_begin);
+                    if (in_range && cursor % num_total + num_samples <= static_cast<uint64>(num_total)) {
+                        /* samples of pixel are consecutive in sampler, no reduction, no wrapping of cursor */
+                        Point2D const* jitter = samples.data() + cursor % num_total;
+                        for (length_t n = 0; n < num_samples; ++n) {
+                            ox[i + n] = pixel.x + jitter[n].x * step_u.x + jitter[n].y * step_v.x;
+                            oy[i + n] = pixel.y + jitter[n].x * step_u.y + jitter[n].y * step_v.y;
+                            oz[i + n] = pixel.z + jitter[n].x * step_u.z + jitter[n].y * step_v.z;
+                        }
+                    }
+                    else {
+                        for (length_t n = 0; n < num_samples; ++n) {
+                            Point3D const p3 = this->at((Point2D(x, y) + this->_sampler->sample_at(cursor + n)) * inverse_size * 2. - 1.);
+                            ox[i + n] = p3.x;
+                            oy[i + n] = p3.y;
+                            oz[i + n] = p3.z;
+                        }
+                    }
+                }
+            }
+        }
+
+
         GraphicsBuffer _figure;
         Point3D _figure_center;
         Vector3D _figure_u;
         Vector3D _figure_v;
         Point2D _inverse_figure_size;
         SamplerPtr _sampler;
+        uint64 _revision;
     };
 
     typedef shared_ptr<Camera> CameraPtr;
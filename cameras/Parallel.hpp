@@ -3,6 +3,7 @@
 
 #include "Camera.hpp"
 #include "../common/types.hpp"
+#include <algorithm>
 #include <memory>
 
 
@@ -42,6 +43,7 @@ namespace nyas
             Parallel inline & set_view_direction(Vector3D const& d)
             {
                 this->_view_direction = d;
+                ++this->_revision;
                 return *this;
             }
 
@@ -73,6 +75,13 @@ namespace nyas
                     this->_view_direction
                 );
             }
+            void virtual get_ray_samples(Tile const& tile, length_t const& sample_begin, length_t const& sample_end, RayBatch & rays) const override
+            {
+                this->_figure_points(tile, sample_begin, sample_end, rays);
+                ::std::fill(rays.direction_x.begin(), rays.direction_x.end(), this->_view_direction.x);
+                ::std::fill(rays.direction_y.begin(), rays.direction_y.end(), this->_view_direction.y);
+                ::std::fill(rays.direction_z.begin(), rays.direction_z.end(), this->_view_direction.z);
+            }
 
 
         private:
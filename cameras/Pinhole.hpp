@@ -42,6 +42,19 @@ namespace nyas
             Pinhole inline & set_view_point(Point3D const& view_point)
             {
                 this->_view_point = view_point;
+                ++this->_revision;
+                return *this;
+            }
+
+            /// aim camera from view_point at target, field of view and distance to figure are kept
+            Pinhole & look_at(Point3D const& view_point, Point3D const& target, Vector3D const& view_up = Camera::DEFAULT_VIEW_UP)
+            {
+                float64 const view_distance = length(this->_figure_center - this->_view_point);
+                Vector3D const view_direction = normalize(target - view_point);
+                Vector3D const u = normalize(cross(view_direction, view_up));
+                this->set_view_point(view_point);
+                this->set_figure_center(view_point + view_distance * view_direction);
+                this->set_figure_directions(length(this->_figure_u) * u, length(this->_figure_v) * normalize(cross(u, view_direction)));
                 return *this;
             }
 
@@ -77,6 +90,16 @@ namespace nyas
                 Point3D const p3 = this->at((Point2D(i) + this->_sampler->sample_uniform2D()) * this->_inverse_figure_size * 2. - 1.);
                 return Ray(p3, p3 - this->_view_point);
             }
+            void virtual get_ray_samples(Tile const& tile, length_t const& sample_begin, length_t const& sample_end, RayBatch & rays) const override
+            {
+                this->_figure_points(tile, sample_begin, sample_end, rays);
+                length_t const size = rays.size();
+                for (length_t i = 0; i < size; ++i) {
+                    rays.direction_x[i] = rays.origin_x[i] - this->_view_point.x;
+                    rays.direction_y[i] = rays.origin_y[i] - this->_view_point.y;
+                    rays.direction_z[i] = rays.origin_z[i] - this->_view_point.z;
+                }
+            }
 
 
         private:
@@ -25,6 +25,7 @@ namespace nyas
     typedef long double float128;
 
     typedef ::glm::length_t length_t;
+    typedef int64 offset_t;     // offsets and counts of elements in buffers, may be larger than 2^31
     template<length_t L, typename T> using vec = ::glm::vec<L, T, ::glm::qualifier::defaultp>;
 
     typedef vec<2, float64>  Point2D;
@@ -0,0 +1,440 @@
+/// @file distributed/Coordinator.hpp
+#pragma once
+
+#include "protocol.hpp"
+#include "Worker.hpp"
+#include "../common/setup.h"
+#include "../common/types.hpp"
+#include "../Buffer2D.hpp"
+#include "../Tile.hpp"
+#include "../World.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifndef WIN32
+    #include <signal.h>
+    #include <sys/socket.h>
+    #include <sys/types.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+
+namespace nyas
+{
+    namespace distributed
+    {
+        /// Spread rendering of one frame over worker processes. Coordinator hands out jobs (samples in
+        /// range on a tile) and merges sums returned by workers into figure of camera. Jobs of a failed
+        /// worker are given to other workers, and rendered by coordinator itself if no worker is left.
+        ///
+        /// Since samples only depend on pixel and sample index (see `World::render_sample`), the image
+        /// is the same as `World::render_scenes`. When a pixel is split into several sample ranges, only
+        /// the order of floating-point summation is different.
+        ///
+        /// Each worker has a thread blocking on reading its results while a frame is rendered, so any
+        /// stream works on every platform. Only spawning local workers needs POSIX.
+        class Coordinator final
+        {
+        public:
+            length_t static constexpr MAX_JOBS_IN_FLIGHT = 2;      // jobs queued on one worker at the same time
+
+
+            /// @param samples_per_job samples on each pixel in one job, 0 for all samples
+            explicit Coordinator(Length2D const& tile_size = Length2D(World::DEFAULT_TILE_SIZE), length_t const& samples_per_job = 0)
+                : _tile_size(tile_size)
+                , _samples_per_job(samples_per_job)
+                , _num_failures(0)
+            {
+                assert(tile_size.x > 0 && tile_size.y > 0 && samples_per_job >= 0);
+            }
+            Coordinator(Coordinator const&) = delete;
+
+            /* Destructor */
+            ~Coordinator()
+            {
+#ifndef WIN32
+                void (*old_sigpipe)(int) = ::signal(SIGPIPE, SIG_IGN);
+#endif
+                for (_WorkerHandle & worker : this->_workers) {
+                    if (worker.alive) {
+                        write_header(worker.write_fd, MessageHeader());     // quit
+                    }
+                    this->_close_worker(worker);
+                }
+#ifndef WIN32
+                for (_WorkerHandle const& worker : this->_workers) {
+                    if (worker.pid > 0) {
+                        ::waitpid(static_cast<::pid_t>(worker.pid), nullptr, 0);
+                    }
+                }
+                ::signal(SIGPIPE, old_sigpipe);
+#endif
+            }
+
+            Coordinator & operator=(Coordinator const&) = delete;
+
+            /// add a worker on any byte stream, e.g. pipes of `ssh host worker` or a tcp socket.
+            /// Coordinator owns the file descriptors after adding.
+            Coordinator inline & add_worker(int const& read_fd, int const& write_fd)
+            {
+                this->_workers.push_back(_WorkerHandle(read_fd, write_fd, -1));
+                return *this;
+            }
+
+            /// fork local worker processes serving on unix sockets. Workers share the world already
+            /// built in this process, so world must be complete before spawning.
+            ///
+            /// @return false for cannot spawn workers (unsupported platform or system error)
+            bool spawn_local_workers([[maybe_unused]] World const& world, [[maybe_unused]] length_t const& num_workers)
+            {
+#ifdef WIN32
+                return false;
+#else
+                if (!world.valid()) {
+                    return false;
+                }
+                for (length_t n = 0; n < num_workers; ++n) {
+                    int fds[2];
+                    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                        return false;
+                    }
+                    ::pid_t const pid = ::fork();
+                    if (pid < 0) {
+                        ::close(fds[0]);
+                        ::close(fds[1]);
+                        return false;
+                    }
+                    if (pid == 0) {     // worker process
+                        ::close(fds[0]);
+                        for (_WorkerHandle & worker : this->_workers) {
+                            this->_close_worker(worker);
+                        }
+                        bool const quit = serve(world, fds[1], fds[1]);
+                        ::_exit(quit ? 0 : 1);
+                    }
+                    ::close(fds[1]);
+                    this->_workers.push_back(_WorkerHandle(fds[0], fds[0], pid));
+                }
+                return true;
+#endif
+            }
+
+            Length2D inline tile_size() const
+            {
+                return this->_tile_size;
+            }
+            length_t inline samples_per_job() const
+            {
+                return this->_samples_per_job;
+            }
+            length_t num_workers() const
+            {
+                return static_cast<length_t>(::std::count_if(this->_workers.begin(), this->_workers.end(),
+                    [] (_WorkerHandle const& worker) { return worker.alive; }));
+            }
+            /// how many times a worker failed and its jobs were reassigned
+            length_t inline num_failures() const
+            {
+                return this->_num_failures;
+            }
+
+            /// render world into figure of camera
+            void render(World & world)
+            {
+                if (!world.valid()) {
+                    return;
+                }
+                length_t const num_samples = world.sampler()->num_samples();
+                length_t const samples_per_job = (this->_samples_per_job > 0) ? this->_samples_per_job : num_samples;
+                GraphicsBuffer & figure = world.camera()->figure();
+                figure.for_each([] (RGBColor & pixel) { pixel = constants<float32>::axis3D::O; });
+
+                /* make jobs */
+                this->_jobs.clear();
+                for (Tile const& tile : split_tiles(figure.size(), this->_tile_size)) {
+                    for (length_t s = 0; s < num_samples; s += samples_per_job) {
+                        this->_jobs.push_back(_Job(tile, s, ::std::min(s + samples_per_job, num_samples)));
+                    }
+                }
+                ::std::deque<length_t> pending;
+                for (length_t j = 0; j < static_cast<length_t>(this->_jobs.size()); ++j) {
+                    pending.push_back(j);
+                }
+
+#ifndef WIN32
+                // writing to a dead worker should fail instead of killing coordinator
+                void (*old_sigpipe)(int) = ::signal(SIGPIPE, SIG_IGN);
+#endif
+                _Inbox inbox;
+                ::std::vector<::std::thread> readers;
+                for (_WorkerHandle & worker : this->_workers) {
+                    if (worker.alive) {
+                        worker.num_sent = worker.num_read = 0;
+                        readers.push_back(::std::thread(&Coordinator::_read_results, this, ::std::ref(worker), ::std::ref(inbox)));
+                    }
+                }
+                length_t remaining = static_cast<length_t>(this->_jobs.size());
+                ::std::unique_lock<::std::mutex> lock(inbox.mutex);
+                while (remaining > 0) {
+                    /* hand out jobs */
+                    for (_WorkerHandle & worker : this->_workers) {
+                        while (worker.alive && !pending.empty() && static_cast<length_t>(worker.jobs.size()) < MAX_JOBS_IN_FLIGHT) {
+                            length_t const j = pending.front();
+                            pending.pop_front();
+                            worker.jobs.push_back(j);
+                            _Job const& job = this->_jobs[j];
+                            if (!write_header(worker.write_fd, MessageHeader(MessageType::Job, j, job.tile, job.sample_begin, job.sample_end))) {
+                                this->_fail(worker, pending);
+                            }
+                            else {
+                                ++worker.num_sent;
+                                inbox.sent.notify_all();
+                            }
+                        }
+                    }
+                    /* wait for results */
+                    bool const waiting = ::std::any_of(this->_workers.begin(), this->_workers.end(),
+                        [] (_WorkerHandle const& worker) { return worker.alive && !worker.jobs.empty(); });
+                    if (!waiting) {     // no worker is alive
+                        break;
+                    }
+                    inbox.arrived.wait(lock, [&inbox] () { return !inbox.results.empty(); });
+                    while (!inbox.results.empty()) {
+                        _Result const result = ::std::move(inbox.results.front());
+                        inbox.results.pop_front();
+                        if (result.worker->alive && !this->_merge_result(*result.worker, result, figure, remaining)) {
+                            this->_fail(*result.worker, pending);
+                        }
+                    }
+                }
+                inbox.stop = true;
+                inbox.sent.notify_all();
+                lock.unlock();
+                for (::std::thread & reader : readers) {
+                    reader.join();
+                }
+                for (_WorkerHandle & worker : this->_workers) {
+                    if (!worker.alive) {
+                        this->_close_worker(worker);
+                    }
+                }
+#ifndef WIN32
+                ::signal(SIGPIPE, old_sigpipe);
+#endif
+
+                /* render jobs left by coordinator itself */
+                for (_WorkerHandle & worker : this->_workers) {
+                    for (length_t const& j : worker.jobs) {
+                        pending.push_back(j);
+                    }
+                    worker.jobs.clear();
+                }
+                for (length_t const& j : pending) {
+                    _Job & job = this->_jobs[j];
+                    if (job.done) {
+                        continue;
+                    }
+                    GraphicsBuffer sums(job.tile.size);
+                    world.render_tile(job.tile, job.sample_begin, job.sample_end, sums);
+                    this->_merge(job, sums.data_pointer(), figure);
+                }
+
+                float32 const inverse_num_samples = 1.f / num_samples;
+                figure.for_each([inverse_num_samples] (RGBColor & pixel) { pixel = pixel * inverse_num_samples; });
+            }
+
+
+        private:
+            struct _WorkerHandle final
+            {
+                int read_fd;
+                int write_fd;
+                int64 pid;                      // process id for local worker, -1 for others
+                bool alive;
+                ::std::vector<length_t> jobs;   // jobs sent and not returned yet
+                length_t num_sent;              // jobs sent in this frame, guarded by mutex of `_Inbox`
+                length_t num_read;              // results read in this frame, only used by reader thread
+
+
+                explicit _WorkerHandle(int const& read_fd, int const& write_fd, int64 const& pid)
+                    : read_fd(read_fd)
+                    , write_fd(write_fd)
+                    , pid(pid)
+                    , alive(true)
+                    , jobs()
+                    , num_sent(0)
+                    , num_read(0)
+                {}
+            };
+
+            struct _Job final
+            {
+                Tile tile;
+                length_t sample_begin;
+                length_t sample_end;
+                bool done;
+
+
+                explicit _Job(Tile const& tile, length_t const& sample_begin, length_t const& sample_end)
+                    : tile(tile)
+                    , sample_begin(sample_begin)
+                    , sample_end(sample_end)
+                    , done(false)
+                {}
+            };
+
+            /// message read by reader thread of worker
+            struct _Result final
+            {
+                _WorkerHandle * worker;
+                bool ok;                        // false for broken stream
+                MessageHeader header;
+                ::std::vector<RGBColor> sums;
+
+
+                explicit _Result(_WorkerHandle * const& worker)
+                    : worker(worker)
+                    , ok(false)
+                    , header()
+                    , sums()
+                {}
+            };
+
+            /// results handed from reader threads to coordinator while rendering a frame
+            struct _Inbox final
+            {
+                ::std::mutex mutex;
+                ::std::condition_variable sent;         // reader threads wait for jobs sent
+                ::std::condition_variable arrived;      // coordinator waits for results
+                ::std::deque<_Result> results;
+                bool stop;
+
+
+                _Inbox()
+                    : results()
+                    , stop(false)
+                {}
+            };
+
+
+            void _close_worker(_WorkerHandle & worker)
+            {
+                if (worker.read_fd >= 0) {
+#ifdef WIN32
+                    ::_close(worker.read_fd);
+#else
+                    ::close(worker.read_fd);
+#endif
+                }
+                if (worker.write_fd >= 0 && worker.write_fd != worker.read_fd) {
+#ifdef WIN32
+                    ::_close(worker.write_fd);
+#else
+                    ::close(worker.write_fd);
+#endif
+                }
+                worker.read_fd = worker.write_fd = -1;
+                worker.alive = false;
+            }
+
+            /// stop using worker and give its jobs back
+            void _fail(_WorkerHandle & worker, ::std::deque<length_t> & pending)
+            {
+                for (length_t const& j : worker.jobs) {
+                    if (!this->_jobs[j].done) {
+                        pending.push_front(j);
+                    }
+                }
+                worker.jobs.clear();
+                worker.alive = false;       // streams are closed after its reader thread ends
+                ++this->_num_failures;
+            }
+
+            /// read results of jobs sent to worker until the frame ends or stream breaks, on a thread of its own.
+            /// Reading only when a result is due, so the thread never blocks on an idle worker at the end.
+            void _read_results(_WorkerHandle & worker, _Inbox & inbox) const
+            {
+                while (true) {
+                    {
+                        ::std::unique_lock<::std::mutex> lock(inbox.mutex);
+                        inbox.sent.wait(lock, [&worker, &inbox] () { return inbox.stop || worker.num_read < worker.num_sent; });
+                        if (worker.num_read >= worker.num_sent) {       // stop and nothing due
+                            return;
+                        }
+                    }
+                    _Result result(&worker);
+                    // tiles are never larger than tile size, so a broken header does not allocate much
+                    result.ok = read_header(worker.read_fd, result.header) && result.header.type == MessageType::Result
+                        && result.header.tile_width <= this->_tile_size.x && result.header.tile_height <= this->_tile_size.y;
+                    if (result.ok) {
+                        result.sums.resize(static_cast<::std::size_t>(result.header.tile_width) * result.header.tile_height);
+                        result.ok = read_all(worker.read_fd, result.sums.data(), result.header.payload_size());
+                    }
+                    ++worker.num_read;
+                    bool const ok = result.ok;
+                    {
+                        ::std::lock_guard<::std::mutex> lock(inbox.mutex);
+                        inbox.results.push_back(::std::move(result));
+                    }
+                    inbox.arrived.notify_one();
+                    if (!ok) {
+                        return;
+                    }
+                }
+            }
+
+            /// merge one result of worker into figure, false for broken worker
+            bool _merge_result(_WorkerHandle & worker, _Result const& result, GraphicsBuffer & figure, length_t & remaining)
+            {
+                MessageHeader const& header = result.header;
+                if (!result.ok) {
+                    return false;
+                }
+                auto const iter = ::std::find(worker.jobs.begin(), worker.jobs.end(), static_cast<length_t>(header.job_id));
+                if (iter == worker.jobs.end()) {
+                    return false;
+                }
+                _Job & job = this->_jobs[*iter];
+                if (header.tile_x != job.tile.start.x || header.tile_y != job.tile.start.y
+                    || header.tile_width != job.tile.size.x || header.tile_height != job.tile.size.y
+                    || header.sample_begin != job.sample_begin || header.sample_end != job.sample_end) {
+                    return false;
+                }
+                worker.jobs.erase(iter);
+                if (!job.done) {
+                    this->_merge(job, result.sums.data(), figure);
+                    --remaining;
+                }
+                return true;
+            }
+
+            void _merge(_Job & job, RGBColor const* sums, GraphicsBuffer & figure)
+            {
+                Buffer2DView<RGBColor const> const result(job.tile.size, sums);
+                GraphicsView const target = figure.view(job.tile);
+                for (length_t y = 0; y < job.tile.size.y; ++y) {
+                    RGBColor * out = target.row(y);
+                    RGBColor const* in = result.row(y);
+                    for (length_t x = 0; x < job.tile.size.x; ++x) {
+                        out[x] += in[x];
+                    }
+                }
+                job.done = true;
+            }
+
+
+            Length2D _tile_size;
+            length_t _samples_per_job;
+            length_t _num_failures;
+            ::std::vector<_WorkerHandle> _workers;
+            ::std::vector<_Job> _jobs;
+        };
+
+    } // namespace distributed
+
+} // namespace nyas
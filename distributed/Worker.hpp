@@ -0,0 +1,70 @@
+/// @file distributed/Worker.hpp
+#pragma once
+
+#include "protocol.hpp"
+#include "../common/types.hpp"
+#include "../Buffer2D.hpp"
+#include "../Tile.hpp"
+#include "../World.hpp"
+#include "../scenes/compiled.hpp"
+#include <functional>
+
+
+namespace nyas
+{
+    namespace distributed
+    {
+        typedef ::std::function<WorldPtr()> SceneBuilder;
+
+
+        /// serve render jobs read from in_fd and send results into out_fd, until coordinator asks
+        /// to quit or stream is closed. Any byte stream works (pipe, unix socket, tcp socket, ssh...).
+        ///
+        /// @return true for coordinator asks to quit, false for stream error
+        bool serve(World const& world, int const& in_fd, int const& out_fd)
+        {
+            if (!world.valid()) {
+                return false;
+            }
+            MessageHeader header;
+            while (read_header(in_fd, header)) {
+                if (header.type == MessageType::Quit) {
+                    return true;
+                }
+                if (header.type != MessageType::Job) {
+                    return false;
+                }
+                Tile const tile = header.tile();
+                if (tile.empty() || tile.start.x < 0 || tile.start.y < 0
+                    || tile.end().x > world.camera()->figure_size().x || tile.end().y > world.camera()->figure_size().y) {
+                    return false;
+                }
+                GraphicsBuffer sums(tile.size);
+                world.render_tile(tile, header.sample_begin, header.sample_end, sums);
+                header.type = MessageType::Result;
+                if (!write_header(out_fd, header) || !write_all(out_fd, sums.data_pointer(), header.payload_size())) {
+                    return false;
+                }
+            }
+            return false;
+        }
+
+        /// build world from shared scene description then serve render jobs. Remote workers should
+        /// use the same scene description as coordinator, so they render the same world.
+        bool inline serve(SceneBuilder const& build_world, int const& in_fd, int const& out_fd)
+        {
+            WorldPtr const world = build_world();
+            return world != nullptr && serve(*world, in_fd, out_fd);
+        }
+
+        /// load world from scene file (compiled or text, see `scenes::load_scene`) then serve render jobs.
+        /// Compiled scenes store samples of sampler, so workers render the same samples as coordinator.
+        bool inline serve(string const& scene_file, int const& in_fd, int const& out_fd)
+        {
+            WorldPtr const world = scenes::load_scene(scene_file);
+            return world != nullptr && serve(*world, in_fd, out_fd);
+        }
+
+    } // namespace distributed
+
+} // namespace nyas
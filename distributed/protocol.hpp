@@ -0,0 +1,137 @@
+/// @file distributed/protocol.hpp
+#pragma once
+
+#include "../common/setup.h"
+#include "../common/types.hpp"
+#include "../Tile.hpp"
+#include <cstddef>
+#ifdef WIN32    // Windows
+    #include <io.h>
+#else           // Linux
+    #include <unistd.h>
+    #include <errno.h>
+#endif
+
+
+namespace nyas
+{
+    namespace distributed
+    {
+        /* Messages between coordinator and workers are a fixed-size header, results are followed by
+           tile.width * tile.height RGBColor (sums of samples) in row-major order. Data is sent in
+           native byte order, so all machines in one render should have same endianness. */
+
+        uint32 constexpr PROTOCOL_MAGIC = 0x7361796E;     // "nyas" in little endian
+
+        enum class MessageType : uint32
+        {
+            Job = 1,        // coordinator -> worker, render samples on tile
+            Result = 2,     // worker -> coordinator, sums of samples on tile
+            Quit = 3        // coordinator -> worker, stop serving
+        };
+
+        struct MessageHeader final
+        {
+            uint32 magic;
+            MessageType type;
+            uint32 job_id;
+            int32 tile_x, tile_y, tile_width, tile_height;
+            int32 sample_begin, sample_end;
+
+
+            MessageHeader()
+                : magic(PROTOCOL_MAGIC)
+                , type(MessageType::Quit)
+                , job_id(0)
+                , tile_x(0), tile_y(0), tile_width(0), tile_height(0)
+                , sample_begin(0), sample_end(0)
+            {}
+            explicit MessageHeader(MessageType const& type, uint32 const& job_id, Tile const& tile, length_t const& sample_begin, length_t const& sample_end)
+                : magic(PROTOCOL_MAGIC)
+                , type(type)
+                , job_id(job_id)
+                , tile_x(tile.start.x), tile_y(tile.start.y), tile_width(tile.size.x), tile_height(tile.size.y)
+                , sample_begin(sample_begin), sample_end(sample_end)
+            {}
+
+            Tile inline tile() const
+            {
+                return Tile(this->tile_x, this->tile_y, this->tile_width, this->tile_height);
+            }
+
+            /// check header is not broken
+            bool inline valid() const
+            {
+                return this->magic == PROTOCOL_MAGIC
+                    && this->tile_width >= 0 && this->tile_height >= 0
+                    && 0 <= this->sample_begin && this->sample_begin <= this->sample_end;
+            }
+
+            /// size of data following this header in bytes
+            ::std::size_t inline payload_size() const
+            {
+                if (this->type != MessageType::Result) {
+                    return 0;
+                }
+                return static_cast<::std::size_t>(this->tile_width) * this->tile_height * sizeof(RGBColor);
+            }
+        };
+
+
+        /// read exactly size bytes from file descriptor, false for stream closed or error
+        bool read_all(int const& fd, void * data, ::std::size_t size)
+        {
+            char * ptr = static_cast<char *>(data);
+            while (size > 0) {
+#ifdef WIN32
+                int const got = _read(fd, ptr, static_cast<unsigned int>(size));
+#else
+                ::ssize_t const got = ::read(fd, ptr, size);
+                if (got < 0 && errno == EINTR) {
+                    continue;
+                }
+#endif
+                if (got <= 0) {
+                    return false;
+                }
+                ptr += got;
+                size -= static_cast<::std::size_t>(got);
+            }
+            return true;
+        }
+
+        /// write exactly size bytes into file descriptor, false for stream closed or error
+        bool write_all(int const& fd, void const* data, ::std::size_t size)
+        {
+            char const* ptr = static_cast<char const*>(data);
+            while (size > 0) {
+#ifdef WIN32
+                int const put = _write(fd, ptr, static_cast<unsigned int>(size));
+#else
+                ::ssize_t const put = ::write(fd, ptr, size);
+                if (put < 0 && errno == EINTR) {
+                    continue;
+                }
+#endif
+                if (put <= 0) {
+                    return false;
+                }
+                ptr += put;
+                size -= static_cast<::std::size_t>(put);
+            }
+            return true;
+        }
+
+        bool inline read_header(int const& fd, MessageHeader & header)
+        {
+            return read_all(fd, &header, sizeof(MessageHeader)) && header.valid();
+        }
+
+        bool inline write_header(int const& fd, MessageHeader const& header)
+        {
+            return write_all(fd, &header, sizeof(MessageHeader));
+        }
+
+    } // namespace distributed
+
+} // namespace nyas
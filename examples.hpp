@@ -4,6 +4,8 @@
 #include "nyasRayTracing.hpp"
 #include "common/vec_output.hpp"
 #include <chrono>
+#include <cstring>
+#include <fstream>
 
 using ::std::cout;
 using ::std::cerr;
@@ -15,6 +17,73 @@ std::string const output_dir = "outputs/";
 
 namespace nyas
 {
+    namespace _detail   // ! user should not use namespace '_detail'
+    {
+        /// fill buffer tile by tile then blur each tile, the access pattern of tile renderers and filters
+        template<typename Buff>
+        float64 time_tile_access(Buff & buff, Length2D const& tile_size)
+        {
+            using namespace ::std::chrono;
+            steady_clock::time_point const time_start = steady_clock::now();
+            for (Tile const& tile : split_tiles(buff.size(), tile_size)) {
+                for (length_t y = tile.start.y; y < tile.end().y; ++y) {
+                    for (length_t x = tile.start.x; x < tile.end().x; ++x) {
+                        buff(x, y) = RGBColor(float32(x ^ y) / 4096.f);
+                    }
+                }
+                for (length_t y = tile.start.y + 1; y < tile.end().y - 1; ++y) {
+                    for (length_t x = tile.start.x + 1; x < tile.end().x - 1; ++x) {
+                        buff(x, y) = (buff(x - 1, y) + buff(x + 1, y) + buff(x, y - 1) + buff(x, y + 1)) * 0.25f;
+                    }
+                }
+            }
+            return duration_cast<duration<float64>>(steady_clock::now() - time_start).count();
+        }
+
+        /// root mean square of differences between channels of figure and reference in the same size
+        float64 rms_error(GraphicsBuffer const& reference, GraphicsBuffer const& figure)
+        {
+            assert(figure.size() == reference.size());
+            float64 sum = 0.;
+            for (length_t y = 0; y < figure.height(); ++y) {
+                for (length_t x = 0; x < figure.width(); ++x) {
+                    sum += length2(Vector3D(figure(x, y) - reference(x, y))) / 3.;
+                }
+            }
+            return sqrt(sum / figure.total());
+        }
+
+        /// a floor and a ball under sky, the scene of `example_simple_scenes`, with pinhole camera looking at the ball
+        void build_floor_scene(World & world, Length2D const& figure_size)
+        {
+            BRDFs::LambertianPtr lamb1 = make_shared<BRDFs::Lambertian>(1.f);
+            BRDFs::LambertianPtr lamb2 = make_shared<BRDFs::Lambertian>(0.3f);
+            world.set_sky(make_shared<skies::Zenith>(RGBColor(0.5f, 0.7f, 1.f), RGBColor(1.f)));
+            world.add_object(make_shared<objects::Sphere>(lamb1, 99., Point3D(0., 3., -100.)));
+            world.add_object(make_shared<objects::Sphere>(lamb2, 1.,  Point3D(0., 3., 0.)));
+            world.set_camera(cameras::default_pinhole(
+                figure_size, constants<float64>::axis3D::O,
+                constants<float64>::axis3D::Y, 75._deg
+            ));
+        }
+
+        /// 200 small balls scattered on a floor around a big ball under sky, with 320x240 pinhole camera
+        void build_ball_field(World & world)
+        {
+            BRDFs::LambertianPtr lamb1 = make_shared<BRDFs::Lambertian>(0.8f);
+            BRDFs::LambertianPtr lamb2 = make_shared<BRDFs::Lambertian>(0.3f);
+            world.set_sky(make_shared<skies::Zenith>(RGBColor(0.5f, 0.7f, 1.f), RGBColor(1.f)));
+            world.add_object(make_shared<objects::Sphere>(lamb1, 1000., Point3D(0., 0., -1000.)));
+            for (length_t i = 0; i < 200; ++i) {
+                Point3D const center = (random::uniform3D() - 0.5) * Point3D(20., 20., 0.) + Point3D(0., 12., 0.3);
+                world.add_object(make_shared<objects::Sphere>((i % 2 == 0) ? lamb1 : lamb2, 0.3, center));
+            }
+            world.add_object(make_shared<objects::Sphere>(lamb2, 2., Point3D(0., 8., 2.)));
+            world.set_camera(cameras::default_pinhole(Length2D(320, 240), Point3D(0., -4., 3.), Vector3D(0., 1., -0.2), 60._deg));
+        }
+
+    } // namespace _detail
+
     /// test for fast inverse square root.
     void test_inersesqrt()
     {
@@ -313,4 +382,1084 @@ namespace nyas
         cout << endl;
     }
 
+    /// example for rendering one frame with several local worker processes
+    void example_distributed()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_distributed" << endl;
+
+        /* set and create output directory */
+        if (!makedir(output_dir)) {
+            cerr << "Cannot create directory: '" << output_dir << '\'' << endl;
+            return;
+        }
+
+        /* shared scene description, remote workers can build the same world by calling it */
+        auto build_world = [] () -> WorldPtr {
+            WorldPtr world = make_shared<World>();
+            _detail::build_floor_scene(*world, Length2D(320, 240));
+            world->set_sampler(make_shared<Sampler>(samples_generators::MultiJittered(83, 16)));
+            world->set_ray_tracer(make_shared<tracers::HemisphereModel>(3));
+            return world;
+        };
+        WorldPtr world = build_world();
+
+        /* render in this process */
+        steady_clock::time_point time_start = steady_clock::now();
+        world->render_scenes();
+        duration<float64> time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+        cout << "Single-process rendering used time: " << time_used.count() << " seconds." << endl;
+        GraphicsBuffer const single_process = world->camera()->figure();
+
+        /* render with local worker processes */
+        distributed::Coordinator coordinator;
+        if (!coordinator.spawn_local_workers(*world, 4)) {
+            cout << "Cannot spawn local workers, coordinator renders by itself." << endl;
+        }
+        time_start = steady_clock::now();
+        coordinator.render(*world);
+        time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+        cout << "Rendering with " << coordinator.num_workers() << " workers used time: " << time_used.count() << " seconds." << endl;
+
+        /* both renders should give the same image */
+        GraphicsBuffer & figure = world->camera()->figure();
+        bool const same = memcmp(single_process.data_pointer(), figure.data_pointer(), figure.total() * sizeof(RGBColor)) == 0;
+        cout << "Same image as single-process rendering: " << (same ? "yes" : "no") << endl;
+
+        /* output image */
+        gamma_correction(figure);
+        save_bmp(output_dir + "distributed.bmp", map_to_image(figure));
+
+        cout << endl;
+    }
+
+
+    /// example for progressive rendering with previews written on a background thread
+    void example_progressive()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_progressive" << endl;
+
+        /* set and create output directory */
+        if (!makedir(output_dir)) {
+            cerr << "Cannot create directory: '" << output_dir << '\'' << endl;
+            return;
+        }
+
+        /* build up world, same as example_simple_scenes */
+        World world;
+        _detail::build_floor_scene(world, Length2D(640, 480));
+        world.set_sampler(make_shared<Sampler>(samples_generators::MultiJittered(83, 256)));
+        world.set_ray_tracer(make_shared<tracers::HemisphereModel>(3));
+
+        /* preview image is replaced at most once per second while rendering */
+        SnapshotWriter preview(output_dir + "progressive.bmp", 1.);
+
+        steady_clock::time_point const time_start = steady_clock::now();
+        world.render_progressive(4,
+            [&preview, &time_start] (GraphicsBuffer const& sums, length_t const& num_samples) {
+                if (preview.publish(sums, num_samples)) {
+                    duration<float64> const time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+                    cout << "preview with " << num_samples << " samples per pixel after " << time_used.count() << " seconds." << endl;
+                }
+            }
+        );
+        duration<float64> const time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+        cout << "Rendering used time: " << time_used.count() << " seconds." << endl;
+
+        /* the final image */
+        preview.flush();
+        cout << preview.num_written() << " previews are written." << endl;
+        GraphicsBuffer & figure = world.camera()->figure();
+        // keep floating-point colors for compositing, before gamma correction and quantizing
+        save_exr(output_dir + "progressive.exr", figure);
+        save_pfm(output_dir + "progressive.pfm", figure);
+        gamma_correction(figure);
+        save_bmp(output_dir + "progressive.bmp", map_to_image(figure));
+
+        cout << endl;
+    }
+
+    /// example for post-processing floating-point colors into display colors
+    void example_tonemapping()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_tonemapping" << endl;
+
+        /* set and create output directory */
+        if (!makedir(output_dir)) {
+            cerr << "Cannot create directory: '" << output_dir << '\'' << endl;
+            return;
+        }
+
+        /* a high dynamic range gradient in 4K */
+        GraphicsBuffer gbuff(3840, 2160);
+        if (!gbuff.valid()) {
+            return;
+        }
+        gbuff.for_each_index(
+            [] (Length2D const& index, RGBColor & pixel) {
+                float32 const x = float32(index.x) / 3839.f, y = float32(index.y) / 2159.f;
+                pixel = RGBColor(4.f * x * x, 2.f * x * y, y * y);
+            }
+        );
+        ImageBuffer ibuff(gbuff.size());
+
+        /* gamma correction then mapping, two passes with a function call on each pixel */
+        GraphicsBuffer copy = gbuff;
+        steady_clock::time_point time_start = steady_clock::now();
+        gamma_correction(copy);
+        map_to_image(copy, ibuff);
+        duration<float64> time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+        cout << "gamma_correction + map_to_image used time: " << time_used.count() << " seconds." << endl;
+        save_bmp(output_dir + "tonemapping_clamp.bmp", ibuff);
+
+        /* the same mapping in one pass */
+        time_start = steady_clock::now();
+        tonemap_to_image(gbuff, ibuff);
+        time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+        cout << "tonemap_to_image used time: " << time_used.count() << " seconds." << endl;
+
+        /* a filmic curve keeps highlights */
+        tonemap_to_image(gbuff, ibuff, ToneMapping(1.f, ToneMappingOperator::ACES, 2.2f, true));
+        save_bmp(output_dir + "tonemapping_aces.bmp", ibuff);
+
+        cout << endl;
+    }
+
+    /// example for per-pixel cost of buffer algorithms with `std::function` and with lambda
+    void example_buffer_algorithms()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_buffer_algorithms" << endl;
+
+        GraphicsBuffer a(3840, 2160), b(3840, 2160), out(3840, 2160);
+        if (!a.valid() || !b.valid() || !out.valid()) {
+            return;
+        }
+        float64 const total = static_cast<float64>(a.total());
+        auto const report = [&total] (char const* name, steady_clock::time_point const& time_start) {
+            duration<float64, ::std::nano> const time_used = steady_clock::now() - time_start;
+            cout << name << ": " << time_used.count() / total << " ns per pixel." << endl;
+        };
+
+        /* fill, each pixel calls through std::function, then the same lambda inlined */
+        steady_clock::time_point time_start = steady_clock::now();
+        a.for_each_index(GraphicsBuffer::ConverWithIndexFunc(
+            [] (Length2D const& index, RGBColor & pixel) { pixel = RGBColor(float32(index.x), float32(index.y), 1.f); }
+        ));
+        report("for_each_index(ConverWithIndexFunc)", time_start);
+        time_start = steady_clock::now();
+        a.for_each_index(
+            [] (Length2D const& index, RGBColor & pixel) { pixel = RGBColor(float32(index.x), float32(index.y), 1.f); }
+        );
+        report("for_each_index(lambda)", time_start);
+
+        /* scale */
+        time_start = steady_clock::now();
+        b.for_each(GraphicsBuffer::ConverFunc([] (RGBColor & pixel) { pixel = pixel * 0.5f + 1.f; }));
+        report("for_each(ConverFunc)", time_start);
+        time_start = steady_clock::now();
+        b.for_each([] (RGBColor & pixel) { pixel = pixel * 0.5f + 1.f; });
+        report("for_each(lambda)", time_start);
+
+        /* blend two buffers, with a temporary buffer of a scaled copy, then in one fused pass */
+        time_start = steady_clock::now();
+        GraphicsBuffer scaled = a.map<RGBColor>(GraphicsBuffer::MapFunc<RGBColor>([] (RGBColor const& pixel) { return pixel * 0.25f; }));
+        out.for_each_index(GraphicsBuffer::ConverWithIndexFunc(
+            [&scaled, &b] (Length2D const& index, RGBColor & pixel) { pixel = scaled(index) + b(index) * 0.75f; }
+        ));
+        report("map + for_each_index(ConverWithIndexFunc)", time_start);
+        time_start = steady_clock::now();
+        transform([] (RGBColor const& x, RGBColor const& y) { return x * 0.25f + y * 0.75f; }, out, a, b);
+        report("transform(lambda)", time_start);
+
+        cout << endl;
+    }
+
+    /// example for memory layouts of Buffer2D under tile access
+    void example_buffer_layouts()
+    {
+        cout << "Example: example_buffer_layouts" << endl;
+
+        Length2D const size(3840, 2160), tile_size(32);
+        Buffer2D<RGBColor, RowMajor> row_major(size);
+        Buffer2D<RGBColor, Tiled<32>> tiled(size);
+        Buffer2D<RGBColor, Morton> morton(size);
+        if (!row_major.valid() || !tiled.valid() || !morton.valid()) {
+            return;
+        }
+        cout << "RowMajor used time: " << _detail::time_tile_access(row_major, tile_size) << " seconds." << endl;
+        cout << "Tiled<32> used time: " << _detail::time_tile_access(tiled, tile_size) << " seconds." << endl;
+        cout << "Morton used time: " << _detail::time_tile_access(morton, tile_size) << " seconds." << endl;
+
+        /* convert back into row-major for output, all layouts hold the same figure */
+        GraphicsBuffer const from_tiled(tiled), from_morton(morton);
+        bool const same = memcmp(row_major.data_pointer(), from_tiled.data_pointer(), row_major.total() * sizeof(RGBColor)) == 0
+            && memcmp(row_major.data_pointer(), from_morton.data_pointer(), row_major.total() * sizeof(RGBColor)) == 0;
+        cout << "Figures in all layouts are " << (same ? "the same." : "different!") << endl;
+
+        cout << endl;
+    }
+
+    /// example for figures stored in files instead of memory
+    void example_mapped_buffer()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_mapped_buffer" << endl;
+
+        /* set and create output directory */
+        if (!makedir(output_dir)) {
+            cerr << "Cannot create directory: '" << output_dir << '\'' << endl;
+            return;
+        }
+
+        /* mapped files are large, they are removed after buffers are unmapped */
+        string const figure_file = output_dir + "mapped_figure.raw";
+        string const image_file = output_dir + "mapped_image.raw";
+        {
+            /* pages of the buffer are loaded and written back by the OS, only pages in use take memory */
+            steady_clock::time_point time_start = steady_clock::now();
+            GraphicsBuffer gbuff(Length2D(8192, 8192), figure_file);
+            if (!gbuff.valid()) {
+                cerr << "Cannot map file: '" << figure_file << '\'' << endl;
+                ::std::remove(figure_file.c_str());
+                return;
+            }
+            gbuff.for_each_index(
+                [] (Length2D const& index, RGBColor & pixel) {
+                    Point2D const p = Point2D(index) / 8192. * 2. - 1.;
+                    pixel = RGBColor(float32(0.5 + 0.5 * ::std::sin(40. * dot(p, p))), float32(0.5 * (p.x + 1.)), float32(0.5 * (p.y + 1.)));
+                }
+            );
+            gbuff.flush();
+            duration<float64> time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+            cout << "fill " << gbuff.total() * sizeof(RGBColor) / (1 << 20) << " MiB of mapped figure used time: " << time_used.count() << " seconds." << endl;
+
+            time_start = steady_clock::now();
+            ImageBuffer ibuff(gbuff.size(), image_file);
+            tonemap_to_image(gbuff, ibuff);
+            save_bmp(output_dir + "mapped.bmp", ibuff);
+            time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+            cout << "tone map and save used time: " << time_used.count() << " seconds." << endl;
+        }
+        ::std::remove(figure_file.c_str());
+        ::std::remove(image_file.c_str());
+
+        cout << endl;
+    }
+
+    /// example for working on regions of a figure in place by views
+    void example_views()
+    {
+        cout << "Example: example_views" << endl;
+
+        /* set and create output directory */
+        if (!makedir(output_dir)) {
+            cerr << "Cannot create directory: '" << output_dir << '\'' << endl;
+            return;
+        }
+
+        ImageBuffer ibuff(640, 480);
+        if (!ibuff.valid()) {
+            return;
+        }
+        ibuff.for_each_index(
+            [] (Length2D const& index, ImageRGBColor & pixel) { pixel = ImageRGBColor(index.x * 255 / 639, index.y * 255 / 479, 128); }
+        );
+
+        /* invert colors in a window, then draw a frame around it, without any copy */
+        ImageView const window = ibuff.view(Tile(160, 120, 320, 240));
+        window.for_each([] (ImageRGBColor & pixel) { pixel = ImageRGBColor(255) - pixel; });
+        ImageRGBColor const frame_color(255, 255, 255);
+        window.subview(Tile(0, 0, 320, 2)).for_each([&frame_color] (ImageRGBColor & pixel) { pixel = frame_color; });
+        window.subview(Tile(0, 238, 320, 2)).for_each([&frame_color] (ImageRGBColor & pixel) { pixel = frame_color; });
+        window.subview(Tile(0, 0, 2, 240)).for_each([&frame_color] (ImageRGBColor & pixel) { pixel = frame_color; });
+        window.subview(Tile(318, 0, 2, 240)).for_each([&frame_color] (ImageRGBColor & pixel) { pixel = frame_color; });
+        save_bmp(output_dir + "views.bmp", ibuff);
+
+        /* copy the window out as a crop */
+        save_bmp(output_dir + "views_crop.bmp", ImageBuffer(window));
+
+        cout << endl;
+    }
+
+    /// example for re-rendering regions of a rendered figure
+    void example_crop_rendering()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_crop_rendering" << endl;
+
+        /* set and create output directory */
+        if (!makedir(output_dir)) {
+            cerr << "Cannot create directory: '" << output_dir << '\'' << endl;
+            return;
+        }
+
+        World world;
+        _detail::build_floor_scene(world, Length2D(640, 480));
+        world.set_sampler(make_shared<Sampler>(samples_generators::MultiJittered(83, 16)));
+        world.set_ray_tracer(make_shared<tracers::HemisphereModel>(3));
+
+        steady_clock::time_point time_start = steady_clock::now();
+        world.render_scenes();
+        duration<float64> time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+        cout << "Full rendering used time: " << time_used.count() << " seconds." << endl;
+        GraphicsBuffer const full = world.camera()->figure();
+
+        /* clear figure, then render only the ball and a corner */
+        GraphicsBuffer & figure = world.camera()->figure();
+        figure.for_each([] (RGBColor & pixel) { pixel = constants<float32>::axis3D::O; });
+        TileList const regions = {Tile(220, 140, 200, 200), Tile(560, 400, 100, 100)};
+        time_start = steady_clock::now();
+        world.render_scenes(regions);
+        time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+        cout << "Rendering regions used time: " << time_used.count() << " seconds." << endl;
+
+        /* pixels in regions are the same as full rendering */
+        bool same = true;
+        figure.for_each_index(
+            [&full, &regions, &same] (Length2D const& index, RGBColor const& pixel) {
+                if (regions[0].contains(index) || regions[1].contains(index)) {
+                    same = same && (pixel == full(index));
+                }
+            }
+        );
+        cout << "Regions are the same as full rendering: " << (same ? "yes" : "no") << endl;
+
+        gamma_correction(figure);
+        save_bmp(output_dir + "crop_rendering.bmp", map_to_image(figure));
+
+        cout << endl;
+    }
+
+    /// example for generating camera rays of a tile in one batch
+    void example_ray_batch()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_ray_batch" << endl;
+
+        cameras::PinholePtr camera = cameras::default_pinhole(
+            Length2D(3840, 2160), constants<float64>::axis3D::O,
+            constants<float64>::axis3D::Y, 75._deg
+        );
+        SamplerPtr sampler = make_shared<Sampler>(samples_generators::MultiJittered(83, 16));
+        camera->set_sampler(sampler);
+        length_t const num_samples = sampler->num_samples();
+        TileList const tiles = split_tiles(camera->figure_size(), Length2D(World::DEFAULT_TILE_SIZE));
+        float64 const num_rays = static_cast<float64>(camera->figure().total()) * num_samples;
+
+        /* one virtual call for each ray */
+        RayBatch rays;
+        float64 checksum = 0.;
+        steady_clock::time_point time_start = steady_clock::now();
+        for (Tile const& tile : tiles) {
+            for (length_t y = tile.start.y; y < tile.end().y; ++y) {
+                for (length_t x = tile.start.x; x < tile.end().x; ++x) {
+                    sampler->seek((static_cast<uint64>(y) * camera->figure_size().x + x) * num_samples);
+                    for (length_t n = 0; n < num_samples; ++n) {
+                        checksum += camera->get_ray_sample(Length2D(x, y)).direction.x;
+                    }
+                }
+            }
+        }
+        duration<float64, ::std::nano> time_used = steady_clock::now() - time_start;
+        cout << "get_ray_sample: " << time_used.count() / num_rays << " ns per ray." << endl;
+
+        /* one virtual call for each tile */
+        float64 batch_checksum = 0.;
+        time_start = steady_clock::now();
+        for (Tile const& tile : tiles) {
+            camera->get_ray_samples(tile, 0, num_samples, rays);
+            for (float64 const& dx : rays.direction_x) {
+                batch_checksum += dx;
+            }
+        }
+        time_used = steady_clock::now() - time_start;
+        cout << "get_ray_samples: " << time_used.count() / num_rays << " ns per ray." << endl;
+        cout << "relative difference of sums: " << abs(batch_checksum - checksum) / abs(checksum) << endl;
+
+        cout << endl;
+    }
+
+    /// example for rendering tiles in batches by `World::render_tile`, against rendering samples one by one
+    void example_tile_batch()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_tile_batch" << endl;
+
+        /* a floor with a grid of balls */
+        BRDFs::LambertianPtr lamb1 = make_shared<BRDFs::Lambertian>(0.8f);
+        BRDFs::LambertianPtr lamb2 = make_shared<BRDFs::Lambertian>(0.3f);
+        World world;
+        world.set_sky(make_shared<skies::Zenith>(RGBColor(0.5f, 0.7f, 1.f), RGBColor(1.f)));
+        world.add_object(make_shared<objects::Sphere>(lamb1, 1000., Point3D(0., 0., -1000.)));
+        for (length_t i = 0; i < 10; ++i) {
+            for (length_t j = 0; j < 10; ++j) {
+                world.add_object(make_shared<objects::Sphere>(lamb2, 0.4, Point3D(i - 4.5, j + 2., 0.4)));
+            }
+        }
+        world.set_camera(cameras::default_pinhole(
+            Length2D(320, 240), Point3D(0., -3., 3.),
+            Vector3D(0., 1., -0.5), 75._deg
+        ));
+        world.set_sampler(make_shared<Sampler>(samples_generators::MultiJittered(83, 16)));
+        world.set_ray_tracer(make_shared<tracers::HemisphereModel>(4));
+
+        TileList const tiles = split_tiles(world.camera()->figure_size(), Length2D(World::DEFAULT_TILE_SIZE));
+        length_t const num_samples = world.sampler()->num_samples();
+        float64 const num_paths = static_cast<float64>(world.camera()->figure().total()) * num_samples;
+        GraphicsBuffer single(world.camera()->figure_size()), batch(single.size());
+        auto const render = [&world, &tiles, &num_samples, &num_paths] (char const* name, GraphicsBuffer & sums, bool const& use_batch) {
+            steady_clock::time_point const time_start = steady_clock::now();
+            for (Tile const& tile : tiles) {
+                if (use_batch) {
+                    world.render_tile(tile, 0, num_samples, sums.view(tile));
+                }
+                else {
+                    for (length_t y = tile.start.y; y < tile.end().y; ++y) {
+                        for (length_t x = tile.start.x; x < tile.end().x; ++x) {
+                            sums(x, y) = world.render_pixel(Length2D(x, y), 0, num_samples);
+                        }
+                    }
+                }
+            }
+            duration<float64> const time_used = steady_clock::now() - time_start;
+            cout << name << ": " << num_paths / time_used.count() << " paths per second." << endl;
+        };
+        render("render_pixel", single, false);
+        render("render_tile", batch, true);
+
+        float32 difference = 0.f;
+        zip(
+            [&difference] (RGBColor const& a, RGBColor const& b) {
+                RGBColor const d = abs(a - b);
+                difference = ::std::max({difference, d.x, d.y, d.z});
+            },
+            single, batch
+        );
+        cout << "max difference of sums: " << difference << endl;
+
+        cout << endl;
+    }
+
+    /// example for choosing accelerators of closest-hit queries on a scene of particles
+    void example_accelerators()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_accelerators" << endl;
+
+        /* a floor with a cloud of small balls in similar sizes */
+        BRDFs::LambertianPtr lamb1 = make_shared<BRDFs::Lambertian>(0.8f);
+        BRDFs::LambertianPtr lamb2 = make_shared<BRDFs::Lambertian>(0.5f);
+        World world;
+        world.set_sky(make_shared<skies::Zenith>(RGBColor(0.5f, 0.7f, 1.f), RGBColor(1.f)));
+        world.add_object(make_shared<objects::Sphere>(lamb1, 1000., Point3D(0., 0., -1000.)));
+        for (length_t i = 0; i < 5000; ++i) {
+            Point3D const center = random::uniform3D() * Vector3D(8., 8., 4.) + Point3D(-4., 2., 0.);
+            world.add_object(make_shared<objects::Sphere>(lamb2, random::uniform(0.04, 0.08), center));
+        }
+        world.set_camera(cameras::default_pinhole(
+            Length2D(320, 240), Point3D(0., -3., 3.),
+            Vector3D(0., 1., -0.3), 75._deg
+        ));
+        world.set_sampler(make_shared<Sampler>(samples_generators::MultiJittered(83, 4)));
+        world.set_ray_tracer(make_shared<tracers::HemisphereModel>(3));
+
+        /* random rays from camera into the cloud */
+        ::std::vector<Ray> rays(20000);
+        for (Ray & ray : rays) {
+            ray = Ray(Point3D(0., -3., 3.), random::uniform3D() * Vector3D(1., 1., 0.6) - Vector3D(0.5, 0., 0.5));
+        }
+
+        cout << "size spread of objects: " << accelerators::size_spread(world.objects()) << endl;
+        ::std::vector<float64> reference;
+        for (AcceleratorPtr const& accelerator : {
+            AcceleratorPtr(make_shared<accelerators::Linear>()),
+            AcceleratorPtr(make_shared<accelerators::UniformGrid>()),
+            AcceleratorPtr(nullptr)
+        }) {
+            world.set_accelerator(accelerator);
+            AcceleratorConstptr const built = world.accelerator();
+            AcceleratorStats const& stats = built->stats();
+            cout << ((accelerator == nullptr) ? "auto: " : "") << built->name() << ": build " << stats.build_seconds * 1e3 << " ms, "
+                << stats.num_nodes << " cells, " << stats.num_references << " references, "
+                << stats.num_unbounded << " tested by every ray, " << stats.memory_bytes / 1024 << " KiB" << endl;
+
+            ::std::vector<float64> ts(rays.size());
+            steady_clock::time_point const time_start = steady_clock::now();
+            for (size_t i = 0; i < rays.size(); ++i) {
+                RayHittingRecord rec;
+                world.intersect(rays[i], rec.t, rec);
+                ts[i] = rec.t;
+            }
+            duration<float64, ::std::micro> const time_used = steady_clock::now() - time_start;
+            cout << "    query " << time_used.count() / rays.size() << " us per ray";
+            if (reference.empty()) {
+                reference = ts;
+                cout << endl;
+            }
+            else {
+                cout << ", same hits as Linear: " << (ts == reference ? "yes" : "no") << endl;
+            }
+        }
+
+        /* render with the automatic choice */
+        steady_clock::time_point const time_start = steady_clock::now();
+        world.render_scenes();
+        duration<float64> const time_used = steady_clock::now() - time_start;
+        cout << "Rendering used time: " << time_used.count() << " seconds." << endl;
+        GraphicsBuffer & figure = world.camera()->figure();
+        gamma_correction(figure);
+        save_bmp(output_dir + "accelerators.bmp", map_to_image(figure));
+
+        cout << endl;
+    }
+
+    /// example for building BVH over a million objects in different sizes
+    void example_bvh()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_bvh" << endl;
+
+        /* balls with radii from 0.01 to 1 in a 100^3 box */
+        BRDFs::LambertianPtr lamb = make_shared<BRDFs::Lambertian>(0.5f);
+        Object3DList objects(1000000);
+        for (Object3DPtr & obj : objects) {
+            obj = make_shared<objects::Sphere>(lamb, 0.01 * ::std::pow(100., random::uniform()), random::uniform3D() * 100.);
+        }
+        cout << "size spread of objects: " << accelerators::size_spread(objects) << endl;
+
+        ::std::vector<Ray> rays(100000);
+        for (Ray & ray : rays) {
+            ray = Ray(random::uniform3D() * 100., random::uniform3D() - 0.5);
+        }
+        auto const query = [&rays] (Accelerator const& accelerator) {
+            length_t num_hits = 0;
+            steady_clock::time_point const time_start = steady_clock::now();
+            for (Ray const& ray : rays) {
+                RayHittingRecord rec;
+                num_hits += accelerator.intersect(ray, rec.t, rec) ? 1 : 0;
+            }
+            duration<float64, ::std::micro> const time_used = steady_clock::now() - time_start;
+            cout << ", query " << time_used.count() / rays.size() << " us per ray, " << num_hits << " hits" << endl;
+        };
+
+        /* number of bins trades build time for tree quality */
+        for (length_t const& num_bins : {8, 16, 32}) {
+            accelerators::BVH bvh(num_bins);
+            bvh.build(objects);
+            cout << "BVH with " << num_bins << " bins: build " << bvh.stats().build_seconds * 1e3 << " ms on "
+                << bvh.num_threads() << " threads, SAH cost " << bvh.sah_cost() << ", depth " << bvh.depth();
+            query(bvh);
+        }
+        accelerators::BVH single_thread;
+        single_thread.set_num_threads(1).build(objects);
+        cout << "BVH with 16 bins: build " << single_thread.stats().build_seconds * 1e3 << " ms on 1 thread";
+        query(single_thread);
+
+        cout << "automatic choice: " << accelerators::choose_accelerator(objects)->name() << endl;
+
+        cout << endl;
+    }
+
+    /// example for keeping built BVH in files, so later runs on the same objects skip building
+    void example_bvh_cache()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_bvh_cache" << endl;
+
+        string const cache_directory = output_dir + "bvh_cache";
+        BRDFs::LambertianPtr lamb = make_shared<BRDFs::Lambertian>(0.5f);
+        Object3DList objects(1000000);
+        for (Object3DPtr & obj : objects) {
+            obj = make_shared<objects::Sphere>(lamb, 0.01 * ::std::pow(100., random::uniform()), random::uniform3D() * 100.);
+        }
+
+        /* the first BVH builds and writes the cache, the second one maps it */
+        accelerators::BVH first, second;
+        first.set_cache_directory(cache_directory).build(objects);
+        cout << "first build: " << first.stats().build_seconds * 1e3 << " ms, from cache: " << (first.from_cache() ? "yes" : "no") << endl;
+        second.set_cache_directory(cache_directory).build(objects);
+        cout << "second build: " << second.stats().build_seconds * 1e3 << " ms, from cache: " << (second.from_cache() ? "yes" : "no") << endl;
+
+        /* both trees give the same hits */
+        bool same = true;
+        for (length_t i = 0; i < 10000; ++i) {
+            Ray const ray(random::uniform3D() * 100., random::uniform3D() - 0.5);
+            RayHittingRecord a, b;
+            same = same && (first.intersect(ray, a.t, a) == second.intersect(ray, b.t, b)) && a.t == b.t && a.object == b.object;
+        }
+        cout << "same hits: " << (same ? "yes" : "no") << endl;
+
+        /* moving one object changes the key, so the cached tree is not used */
+        ::std::static_pointer_cast<objects::Sphere>(objects[0])->set_center(Point3D(-1.));
+        accelerators::BVH third;
+        third.set_cache_directory(cache_directory).build(objects);
+        cout << "after moving an object, from cache: " << (third.from_cache() ? "yes" : "no") << endl;
+
+        cout << endl;
+    }
+
+
+    /// example for scene text and compiled scene files
+    void example_scene_files()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_scene_files" << endl;
+
+        string const scene_directory = output_dir + "scenes/";
+        if (!makedir(scene_directory)) {
+            cerr << "Cannot create directory: '" << scene_directory << '\'' << endl;
+            return;
+        }
+
+        /* a generated scene text, 200000 small balls on a huge floor */
+        string const text_file = scene_directory + "balls.txt";
+        {
+            ::std::ofstream outfile(text_file);
+            outfile << "# generated by example_scene_files\n"
+                    << "camera pinhole 320 240  0 -40 12  0 1 -0.3  60\n"
+                    << "sampler multi_jittered 83 16\n"
+                    << "sky zenith  0.5 0.7 1  1 1 1\n"
+                    << "tracer hemisphere 3\n"
+                    << "brdf floor lambertian 0.8\n"
+                    << "brdf ball lambertian 0.4\n"
+                    << "sphere floor 1000  0 0 -1000\n";
+            for (length_t i = 0; i < 200000; ++i) {
+                Point3D const center = (random::uniform3D() - 0.5) * Point3D(100., 100., 0.) + Point3D(0., 30., 0.5);
+                outfile << "sphere ball 0.5  " << center.x << ' ' << center.y << ' ' << center.z << '\n';
+            }
+        }
+
+        /* parse text, then compile it */
+        string error;
+        steady_clock::time_point time_start = steady_clock::now();
+        WorldPtr const parsed = scenes::read_scene_text(text_file, &error);
+        duration<float64> time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+        if (parsed == nullptr) {
+            cerr << "Cannot read scene: " << error << endl;
+            return;
+        }
+        cout << "parsing text with " << parsed->objects().size() << " objects used time: " << time_used.count() * 1e3 << " ms" << endl;
+        string const compiled_file = scene_directory + "balls.scene";
+        if (!scenes::compile_scene(*parsed, compiled_file, &error)) {
+            cerr << "Cannot compile scene: " << error << endl;
+            return;
+        }
+
+        /* compiled scene is mapped without parsing */
+        time_start = steady_clock::now();
+        WorldPtr const loaded = scenes::load_scene(compiled_file, &error);
+        time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+        if (loaded == nullptr) {
+            cerr << "Cannot load compiled scene: " << error << endl;
+            return;
+        }
+        cout << "loading compiled scene used time: " << time_used.count() * 1e3 << " ms" << endl;
+
+        /* both worlds render the same image, since samples are stored in compiled scene */
+        parsed->render_scenes();
+        loaded->render_scenes();
+        GraphicsBuffer & figure = loaded->camera()->figure();
+        bool const same = memcmp(parsed->camera()->figure().data_pointer(), figure.data_pointer(), figure.total() * sizeof(RGBColor)) == 0;
+        cout << "Same image as parsed scene: " << (same ? "yes" : "no") << endl;
+        gamma_correction(figure);
+        save_bmp(output_dir + "scene_files.bmp", map_to_image(figure));
+
+        /* errors tell the line */
+        scenes::parse_scene("camera pinhole 320 240 0 0 0 0 1 0 60\nsphere metal 1 0 0 0\n", &error);
+        cout << "error of a bad scene: " << error << endl;
+
+        cout << endl;
+    }
+
+
+    /// example for re-rendering after edits, only state invalidated by edits is rebuilt
+    void example_incremental_rendering()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_incremental_rendering" << endl;
+
+        BRDFs::LambertianPtr lamb1 = make_shared<BRDFs::Lambertian>(0.8f);
+        BRDFs::LambertianPtr lamb2 = make_shared<BRDFs::Lambertian>(0.4f);
+        World world;
+        world.set_sky(make_shared<skies::Zenith>(RGBColor(0.5f, 0.7f, 1.f), RGBColor(1.f)));
+        world.add_object(make_shared<objects::Sphere>(lamb1, 1000., Point3D(0., 0., -1000.)));
+        for (length_t i = 0; i < 20000; ++i) {
+            Point3D const center = (random::uniform3D() - 0.5) * Point3D(60., 60., 0.) + Point3D(0., 30., 0.3);
+            world.add_object(make_shared<objects::Sphere>(lamb2, 0.3, center));
+        }
+        objects::SpherePtr ball = make_shared<objects::Sphere>(lamb2, 2., Point3D(0., 8., 2.));
+        world.add_object(ball);
+        cameras::PinholePtr camera = cameras::default_pinhole(Length2D(320, 240), Point3D(0., -10., 6.), Vector3D(0., 1., -0.3), 60._deg);
+        world.set_camera(camera);
+        world.set_sampler(make_shared<Sampler>(samples_generators::MultiJittered(83, 16)));
+        world.set_ray_tracer(make_shared<tracers::HemisphereModel>(3));
+
+        /* refine until all samples are taken, the result is the same as a full rendering */
+        auto const refine = [&world] (char const* what) {
+            steady_clock::time_point const time_start = steady_clock::now();
+            length_t const num_samples = world.refine(4);
+            duration<float64> const time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+            cout << what << ": " << num_samples << " samples, used time: " << time_used.count() * 1e3 << " ms"
+                 << ", accelerator built in " << world.accelerator()->stats().build_seconds * 1e3 << " ms" << endl;
+        };
+        refine("first call");
+        while (world.refine(4) < world.sampler()->num_samples()) {}
+        GraphicsBuffer const refined = world.camera()->figure();
+        world.render_scenes();
+        GraphicsBuffer & figure = world.camera()->figure();
+        bool const same = memcmp(refined.data_pointer(), figure.data_pointer(), figure.total() * sizeof(RGBColor)) == 0;
+        cout << "Same image as full rendering: " << (same ? "yes" : "no") << endl;
+
+        /* nothing is rendered without edits */
+        refine("without edits");
+
+        /* moving camera restarts samples but keeps accelerator, moving object rebuilds accelerator */
+        camera->set_view_point(Point3D(2., -10., 6.));
+        refine("after moving camera");
+        ball->set_center(Point3D(1., 8., 2.));
+        refine("after moving object");
+        lamb2->set_diffuse(0.6f);
+        world.touch();
+        refine("after editing BRDF");
+
+        cout << endl;
+    }
+
+
+    /// example for animating objects, BVH is refitted every frame and built again only when it is too degraded
+    void example_bvh_refit()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_bvh_refit" << endl;
+
+        /* balls flying in random directions */
+        length_t const num_balls = 200000;
+        BRDFs::LambertianPtr lamb = make_shared<BRDFs::Lambertian>(0.5f);
+        World world;
+        world.set_sky(make_shared<skies::Zenith>(RGBColor(0.5f, 0.7f, 1.f), RGBColor(1.f)));
+        ::std::vector<objects::SpherePtr> balls(num_balls);
+        ::std::vector<Vector3D> velocities(num_balls);
+        for (length_t i = 0; i < num_balls; ++i) {
+            balls[i] = make_shared<objects::Sphere>(lamb, 0.02 * ::std::pow(10., random::uniform()), (random::uniform3D() - 0.5) * 40.);
+            velocities[i] = (random::uniform3D() - 0.5) * 0.1;
+            world.add_object(balls[i]);
+        }
+        world.set_camera(cameras::default_pinhole(Length2D(160, 120), Point3D(0., -60., 0.), constants<float64>::axis3D::Y, 60._deg));
+        world.set_sampler(make_shared<Sampler>(samples_generators::MultiJittered(83, 4)));
+        world.set_ray_tracer(make_shared<tracers::HemisphereModel>(3));
+        accelerators::BVHPtr bvh = make_shared<accelerators::BVH>();
+        world.set_accelerator(bvh);
+
+        for (length_t frame = 0; frame < 30; ++frame) {
+            steady_clock::time_point const time_start = steady_clock::now();
+            if (frame > 0) {
+                for (length_t i = 0; i < num_balls; ++i) {
+                    balls[i]->set_center(balls[i]->center() + velocities[i]);
+                }
+            }
+            world.render_scenes();      // refits or builds accelerator on the first query
+            duration<float64> const time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+            if (frame % 5 == 0 || bvh->stats().refit_seconds == 0.) {
+                cout << "frame " << frame << ": used time " << time_used.count() * 1e3 << " ms, "
+                     << ((bvh->stats().refit_seconds == 0.) ? "built in " : "refitted in ")
+                     << ((bvh->stats().refit_seconds == 0.) ? bvh->stats().build_seconds : bvh->stats().refit_seconds) * 1e3 << " ms"
+                     << ", SAH cost " << bvh->sah_cost() << " (" << bvh->sah_cost() / bvh->built_sah_cost() << " of built tree)" << endl;
+            }
+        }
+
+        cout << endl;
+    }
+
+    /// example for sorting bounce rays on a scene whose BVH does not fit in cache
+    void example_ray_sorting()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_ray_sorting" << endl;
+
+        /* 200000 balls in different sizes, like `example_bvh_refit` */
+        length_t const num_balls = 200000;
+        BRDFs::LambertianPtr lamb = make_shared<BRDFs::Lambertian>(0.5f);
+        World world;
+        world.set_sky(make_shared<skies::Zenith>(RGBColor(0.5f, 0.7f, 1.f), RGBColor(1.f)));
+        for (length_t i = 0; i < num_balls; ++i) {
+            world.add_object(make_shared<objects::Sphere>(lamb, 0.02 * ::std::pow(10., random::uniform()), (random::uniform3D() - 0.5) * 40.));
+        }
+        world.set_camera(cameras::default_pinhole(Length2D(160, 120), Point3D(0., -60., 0.), constants<float64>::axis3D::Y, 60._deg));
+        world.set_sampler(make_shared<Sampler>(samples_generators::MultiJittered(83, 64)));
+        tracers::HemisphereModelPtr tracer = make_shared<tracers::HemisphereModel>(4);
+        world.set_ray_tracer(tracer);
+        world.set_accelerator(make_shared<accelerators::BVH>());
+        world.render_scenes();      // builds accelerator, so it is not timed below
+
+        /* best of 3 renders with and without sorting */
+        float64 const num_paths = static_cast<float64>(world.camera()->figure().total()) * world.sampler()->num_samples();
+        GraphicsBuffer unsorted, sorted;
+        auto const render = [&world, &tracer, &num_paths] (char const* name, GraphicsBuffer & figure, bool const& sorting) {
+            tracer->set_ray_sorting(sorting);
+            float64 best = constants<float64>::infinity;
+            for (length_t n = 0; n < 3; ++n) {
+                steady_clock::time_point const time_start = steady_clock::now();
+                world.render_scenes();
+                best = ::std::min(best, duration<float64>(steady_clock::now() - time_start).count());
+            }
+            figure = world.camera()->figure();
+            cout << name << ": " << num_paths / best << " paths per second." << endl;
+        };
+        render("without sorting", unsorted, false);
+        render("with sorting", sorted, true);
+
+        float32 difference = 0.f;
+        zip(
+            [&difference] (RGBColor const& a, RGBColor const& b) {
+                RGBColor const d = abs(a - b);
+                difference = ::std::max({difference, d.x, d.y, d.z});
+            },
+            unsorted, sorted
+        );
+        cout << "max difference of figures: " << difference << endl;
+
+        cout << endl;
+    }
+
+
+    /// example for rendering an animation, encoding of frames overlaps rendering of next frames
+    void example_animation()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_animation" << endl;
+
+        string const animation_directory = output_dir + "animation/";
+        if (!makedir(animation_directory)) {
+            cerr << "Cannot create directory: '" << animation_directory << '\'' << endl;
+            return;
+        }
+
+        /* scene is built once, keyframes move a ball and the camera */
+        BRDFs::LambertianPtr lamb1 = make_shared<BRDFs::Lambertian>(0.8f);
+        BRDFs::LambertianPtr lamb2 = make_shared<BRDFs::Lambertian>(0.4f);
+        World world;
+        world.set_sky(make_shared<skies::Zenith>(RGBColor(0.5f, 0.7f, 1.f), RGBColor(1.f)));
+        world.add_object(make_shared<objects::Sphere>(lamb1, 1000., Point3D(0., 0., -1000.)));
+        for (length_t i = 0; i < 5000; ++i) {
+            Point3D const center = (random::uniform3D() - 0.5) * Point3D(40., 40., 0.) + Point3D(0., 20., 0.3);
+            world.add_object(make_shared<objects::Sphere>(lamb2, 0.3, center));
+        }
+        objects::SpherePtr ball = make_shared<objects::Sphere>(lamb2, 2., Point3D(-6., 12., 2.));
+        world.add_object(ball);
+        cameras::PinholePtr camera = cameras::default_pinhole(Length2D(320, 240), Point3D(0., -10., 6.), Vector3D(0., 1., -0.3), 60._deg);
+        world.set_camera(camera);
+        world.set_sampler(make_shared<Sampler>(samples_generators::MultiJittered(83, 4)));
+        world.set_ray_tracer(make_shared<tracers::HemisphereModel>(3));
+
+        Animation animation(12, 12.);
+        animation.add_track(Keyframes<Point3D>().set(0., Point3D(-6., 12., 2.)).set(0.5, Point3D(0., 10., 6.)).set(1., Point3D(6., 12., 2.)),
+            [ball] (Point3D const& center) { ball->set_center(center); }
+        );
+        animation.add_track(Keyframes<Point3D>().set(0., Point3D(-4., -10., 6.)).set(1., Point3D(4., -10., 6.)),
+            [camera] (Point3D const& view_point) { camera->look_at(view_point, Point3D(0., 12., 0.)); }
+        );
+
+        /* encode frames in this thread after rendering */
+        steady_clock::time_point time_start = steady_clock::now();
+        FrameWriter serial_names(animation_directory + "serial_");
+        for (length_t frame = 0; frame < animation.num_frames(); ++frame) {
+            animation.apply(frame);
+            world.render_scenes();
+            save_bmp(serial_names.file_name(frame), tonemap_to_image(world.camera()->figure()));
+        }
+        duration<float64> time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+        cout << "Rendering then encoding each frame used time: " << time_used.count() << " seconds." << endl;
+
+        /* encode frames on writer thread while next frames are rendered */
+        time_start = steady_clock::now();
+        FrameWriter writer(animation_directory + "frame_");
+        animation.render(world, writer);
+        time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+        cout << "Pipelined rendering used time: " << time_used.count() << " seconds, waited for writer "
+             << writer.wait_seconds() << " seconds, " << writer.num_written() << " frames written." << endl;
+
+        cout << endl;
+    }
+
+
+    /// example for emissive objects, sampling lights on each bounce reduces noise of small lights
+    void example_light_sampling()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_light_sampling" << endl;
+
+        /* a small bright ball is the only light */
+        BRDFs::LambertianPtr lamb1 = make_shared<BRDFs::Lambertian>(0.8f);
+        BRDFs::LambertianPtr lamb2 = make_shared<BRDFs::Lambertian>(0.5f);
+        World world;
+        world.set_sky(make_shared<skies::NoSky>());
+        world.add_object(make_shared<objects::Sphere>(lamb1, 1000., Point3D(0., 0., -1000.)));
+        world.add_object(make_shared<objects::Sphere>(lamb2, 1., Point3D(0., 5., 1.)));
+        world.add_object(make_shared<objects::Sphere>(lamb2, 1., Point3D(2.5, 6., 1.)));
+        objects::SpherePtr light = make_shared<objects::Sphere>(lamb1, 0.3, Point3D(-1., 4., 3.));
+        light->set_emission(RGBColor(40.f));
+        world.add_object(light);
+        world.set_camera(cameras::default_pinhole(Length2D(320, 240), Point3D(0., -3., 2.), Vector3D(0., 1., -0.1), 60._deg));
+        tracers::HemisphereModelPtr tracer = make_shared<tracers::HemisphereModel>(4);
+        world.set_ray_tracer(tracer);
+
+        /* reference by many samples, light sampling does not change the expected color */
+        world.set_sampler(make_shared<Sampler>(samples_generators::Hammersley(1024)));
+        world.render_scenes();
+        GraphicsBuffer const reference = world.camera()->figure();
+
+        world.set_sampler(make_shared<Sampler>(samples_generators::Hammersley(16)));
+        for (bool const sampling : {false, true}) {
+            tracer->set_light_sampling(sampling);
+            world.touch();
+            steady_clock::time_point const time_start = steady_clock::now();
+            world.render_scenes();
+            duration<float64> const time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+            cout << (sampling ? "With" : "Without") << " light sampling: used time " << time_used.count() * 1e3
+                 << " ms, RMS error " << _detail::rms_error(reference, world.camera()->figure()) << endl;
+            save_bmp(output_dir + (sampling ? "light_sampling.bmp" : "no_light_sampling.bmp"), tonemap_to_image(world.camera()->figure()));
+        }
+
+        cout << endl;
+    }
+
+
+    /// example for denoising a render of few samples, guided by albedo, normal and depth of the first hits
+    void example_denoise()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_denoise" << endl;
+
+        World world;
+        _detail::build_ball_field(world);
+        world.set_ray_tracer(make_shared<tracers::HemisphereModel>(4));
+
+        /* brute-force reference */
+        world.set_sampler(make_shared<Sampler>(samples_generators::MultiJittered(83, 256)));
+        steady_clock::time_point time_start = steady_clock::now();
+        world.render_scenes();
+        duration<float64> time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+        GraphicsBuffer const reference = world.camera()->figure();
+        cout << "256 samples used time " << time_used.count() * 1e3 << " ms" << endl;
+
+        /* few samples, then denoise */
+        world.set_sampler(make_shared<Sampler>(samples_generators::MultiJittered(83, 16)));
+        time_start = steady_clock::now();
+        world.render_scenes();
+        AuxiliaryBuffers aux;
+        world.render_auxiliary(aux);
+        GraphicsBuffer const denoised = denoise(world.camera()->figure(), aux);
+        time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+        cout << "16 samples with denoising used time " << time_used.count() * 1e3 << " ms, RMS error "
+             << _detail::rms_error(reference, world.camera()->figure()) << " before denoising, "
+             << _detail::rms_error(reference, denoised) << " after" << endl;
+
+        save_bmp(output_dir + "denoise_reference.bmp", tonemap_to_image(reference));
+        save_bmp(output_dir + "denoise_noisy.bmp", tonemap_to_image(world.camera()->figure()));
+        save_bmp(output_dir + "denoise_denoised.bmp", tonemap_to_image(denoised));
+        save_bmp(output_dir + "denoise_normal.bmp", tonemap_to_image(aux.normal.map<RGBColor>([] (RGBColor const& n) { return n * 0.5f + 0.5f; })));
+
+        cout << endl;
+    }
+
+
+    /// example for previewing a scene by ambient occlusion, albedo and normal, compared with path tracing
+    void example_preview()
+    {
+        using namespace ::std::chrono;
+        cout << "Example: example_preview" << endl;
+
+        World world;
+        _detail::build_ball_field(world);
+        // occlusion rays take samples after camera samples, so sampler needs more than one sample
+        world.set_sampler(make_shared<Sampler>(samples_generators::Hammersley(4)));
+
+        auto const render = [&world] (string const& name) {
+            steady_clock::time_point const time_start = steady_clock::now();
+            world.render_scenes();
+            duration<float64> const time_used = duration_cast<duration<float64>>(steady_clock::now() - time_start);
+            cout << name << ": used time " << time_used.count() * 1e3 << " ms" << endl;
+            save_bmp(output_dir + name + ".bmp", tonemap_to_image(world.camera()->figure()));
+        };
+
+        /* previews with 4 samples per pixel */
+        tracers::PreviewPtr preview = make_shared<tracers::Preview>();
+        preview->set_occlusion_rays(4).set_occlusion_distance(2.);
+        world.set_ray_tracer(preview);
+        render("preview_ambient_occlusion");
+        preview->set_mode(tracers::PreviewMode::Albedo);
+        world.touch();
+        render("preview_albedo");
+        preview->set_mode(tracers::PreviewMode::Normal);
+        world.touch();
+        render("preview_normal");
+
+        /* path tracing with the same samples */
+        world.set_ray_tracer(make_shared<tracers::HemisphereModel>(4));
+        render("preview_path_tracing");
+
+        cout << endl;
+    }
+
+
+    /// example for rendering in a time budget instead of a sample count
+    void example_time_budget()
+    {
+        cout << "Example: example_time_budget" << endl;
+
+        World world;
+        _detail::build_ball_field(world);
+        world.set_sampler(make_shared<Sampler>(samples_generators::MultiJittered(83, 1024)));
+        world.set_ray_tracer(make_shared<tracers::HemisphereModel>(4));
+
+        /* more time gives more samples, passes grow from 1 up to 8 samples */
+        Buffer2D<length_t> sample_counts;
+        for (float64 const& seconds : {0.1, 0.5, 2.}) {
+            TimedRenderStats const stats = world.render_timed(seconds, sample_counts, 8);
+            cout << "budget " << seconds * 1e3 << " ms: used " << stats.seconds * 1e3 << " ms in " << stats.num_passes
+                 << " passes, " << stats.min_samples << " to " << stats.max_samples << " samples per pixel" << endl;
+            save_bmp(output_dir + "time_budget_" + ::std::to_string(static_cast<int>(seconds * 1e3)) + "ms.bmp", tonemap_to_image(world.camera()->figure()));
+        }
+
+        cout << endl;
+    }
+
+
+    /// example for finding slow parts of figure by heatmaps of time and rays used by pixels
+    void example_render_profile()
+    {
+        cout << "Example: example_render_profile" << endl;
+
+        /* a cluster of balls under a light costs more bounces and shadow rays than open ground */
+        BRDFs::LambertianPtr lamb1 = make_shared<BRDFs::Lambertian>(0.8f);
+        BRDFs::LambertianPtr lamb2 = make_shared<BRDFs::Lambertian>(0.3f);
+        World world;
+        world.set_sky(make_shared<skies::Zenith>(RGBColor(0.5f, 0.7f, 1.f), RGBColor(1.f)));
+        world.add_object(make_shared<objects::Sphere>(lamb1, 1000., Point3D(0., 0., -1000.)));
+        for (length_t i = 0; i < 100; ++i) {
+            Point3D const center = (random::uniform3D() - 0.5) * Point3D(4., 4., 4.) + Point3D(-2., 8., 2.);
+            world.add_object(make_shared<objects::Sphere>((i % 2 == 0) ? lamb1 : lamb2, 0.4, center));
+        }
+        objects::SpherePtr light = make_shared<objects::Sphere>(lamb1, 0.5, Point3D(3., 6., 4.));
+        light->set_emission(RGBColor(20.f));
+        world.add_object(light);
+        world.set_camera(cameras::default_pinhole(Length2D(320, 240), Point3D(0., -4., 3.), Vector3D(0., 1., -0.2), 60._deg));
+        world.set_sampler(make_shared<Sampler>(samples_generators::MultiJittered(83, 16)));
+        world.set_ray_tracer(make_shared<tracers::HemisphereModel>(4));
+
+        RenderProfile profile;
+        world.render_scenes(profile);
+        cout << "thread time " << profile.total_seconds() * 1e3 << " ms, " << profile.total_rays() << " rays" << endl;
+
+        /* heatmaps of pixels and of tiles next to the beauty output */
+        save_bmp(output_dir + "render_profile.bmp", tonemap_to_image(world.camera()->figure()));
+        save_heatmaps(output_dir + "render_profile", profile);
+        save_heatmaps(output_dir + "render_profile_tiles", profile, World::DEFAULT_TILE_SIZE);
+
+        cout << endl;
+    }
+
 } // namespace nyas
@@ -0,0 +1,147 @@
+/// @file images/BackgroundWriter.hpp
+#pragma once
+
+#include "../common/types.hpp"
+#include "../Buffer2D.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+namespace nyas
+{
+    namespace _detail   // ! user should not use namespace '_detail'
+    {
+        /// background thread shared by `SnapshotWriter` and `FrameWriter`.
+        ///
+        /// Rendering thread only copies a figure into a pending buffer in `hand`, figure is encoded on writer
+        /// thread without holding lock. If a figure is handed while the one before is still pending, the pending
+        /// one is replaced if `drop_pending`, otherwise `hand` waits until writer thread takes it.
+        class BackgroundWriter final
+        {
+        public:
+            /// called on writer thread for each figure taken
+            ///
+            /// @param tag value handed with figure, e.g. number of samples or frame
+            typedef ::std::function<void(GraphicsBuffer const& figure, length_t const& tag)> Encode;
+
+
+            explicit BackgroundWriter(Encode const& encode, bool const& drop_pending)
+                : _encode(encode)
+                , _drop_pending(drop_pending)
+                , _pending()
+                , _pending_tag(0)
+                , _has_pending(false)
+                , _writing(false)
+                , _stop(false)
+                , _num_written(0)
+                , _wait_seconds(0.)
+                , _thread()
+            {
+                this->_thread = ::std::thread(&BackgroundWriter::_run, this);
+            }
+            BackgroundWriter(BackgroundWriter const&) = delete;
+
+            /* Destructor */
+            /// figure still pending is written before thread ends
+            ~BackgroundWriter()
+            {
+                {
+                    ::std::lock_guard<::std::mutex> lock(this->_mutex);
+                    this->_stop = true;
+                }
+                this->_wake.notify_one();
+                this->_thread.join();
+            }
+
+            BackgroundWriter & operator=(BackgroundWriter const&) = delete;
+
+            length_t num_written() const
+            {
+                ::std::lock_guard<::std::mutex> lock(this->_mutex);
+                return this->_num_written;
+            }
+            /// seconds the rendering thread waited in `hand` for writer thread, always 0 if `drop_pending`
+            float64 wait_seconds() const
+            {
+                ::std::lock_guard<::std::mutex> lock(this->_mutex);
+                return this->_wait_seconds;
+            }
+
+            /// hand a copy of figure to writer thread
+            void hand(GraphicsBuffer const& figure, length_t const& tag)
+            {
+                using namespace ::std::chrono;
+                {
+                    ::std::unique_lock<::std::mutex> lock(this->_mutex);
+                    if (!this->_drop_pending) {
+                        steady_clock::time_point const time_start = steady_clock::now();
+                        this->_done.wait(lock, [this] () { return !this->_has_pending; });
+                        this->_wait_seconds += duration<float64>(steady_clock::now() - time_start).count();
+                    }
+                    if (this->_pending.size() != figure.size()) {
+                        this->_pending = GraphicsBuffer(figure.size());
+                    }
+                    memcpy(this->_pending.data_pointer(), figure.data_pointer(), figure.total() * sizeof(RGBColor));
+                    this->_pending_tag = tag;
+                    this->_has_pending = true;
+                }
+                this->_wake.notify_one();
+            }
+
+            /// wait until all handed figures are written
+            void flush()
+            {
+                ::std::unique_lock<::std::mutex> lock(this->_mutex);
+                this->_done.wait(lock, [this] () { return !this->_has_pending && !this->_writing; });
+            }
+
+
+        private:
+            void _run()
+            {
+                GraphicsBuffer working;
+                ::std::unique_lock<::std::mutex> lock(this->_mutex);
+                while (true) {
+                    this->_wake.wait(lock, [this] () { return this->_has_pending || this->_stop; });
+                    if (!this->_has_pending) {      // stop and nothing left
+                        break;
+                    }
+                    ::std::swap(working, this->_pending);
+                    length_t const tag = this->_pending_tag;
+                    this->_has_pending = false;
+                    this->_writing = true;
+                    this->_done.notify_all();       // rendering thread may hand the next figure now
+                    lock.unlock();
+
+                    this->_encode(working, tag);
+
+                    lock.lock();
+                    this->_writing = false;
+                    ++this->_num_written;
+                    this->_done.notify_all();
+                }
+            }
+
+
+            Encode _encode;
+            bool _drop_pending;
+            GraphicsBuffer _pending;
+            length_t _pending_tag;
+            bool _has_pending;
+            bool _writing;
+            bool _stop;
+            length_t _num_written;
+            float64 _wait_seconds;
+            mutable ::std::mutex _mutex;
+            ::std::condition_variable _wake;
+            ::std::condition_variable _done;
+            ::std::thread _thread;
+        };
+
+    } // namespace _detail
+
+} // namespace nyas
@@ -0,0 +1,89 @@
+/// @file images/FrameWriter.hpp
+#pragma once
+
+#include "BackgroundWriter.hpp"
+#include "tonemap.hpp"
+#include "../common/types.hpp"
+#include "../Buffer2D.hpp"
+#include <cstdio>
+#include <string>
+
+
+namespace nyas
+{
+    /// Write frames of an animation into numbered image files on a background thread.
+    ///
+    /// Rendering thread only copies the figure into a pending buffer in `write`, tone mapping and encoding
+    /// are done on writer thread while the next frame is rendered. Unlike `SnapshotWriter` no frame is
+    /// dropped: `write` waits if the frame written before is not taken by writer thread yet.
+    class FrameWriter final
+    {
+    public:
+        /// @param prefix frame n is written into prefix + n in 4 digits + ".bmp"
+        /// @param mapping tone mapping of frames, figures are average colors
+        explicit FrameWriter(string const& prefix, ToneMapping const& mapping = ToneMapping())
+            : _prefix(prefix)
+            , _mapping(mapping)
+            , _image()
+            , _writer([this] (GraphicsBuffer const& figure, length_t const& frame) { this->_encode(figure, frame); }, false)
+        {}
+        FrameWriter(FrameWriter const&) = delete;
+
+        FrameWriter & operator=(FrameWriter const&) = delete;
+
+        string inline const& prefix() const
+        {
+            return this->_prefix;
+        }
+        ToneMapping inline const& tone_mapping() const
+        {
+            return this->_mapping;
+        }
+        string file_name(length_t const& frame) const
+        {
+            char number[16];
+            ::std::snprintf(number, sizeof(number), "%04d", static_cast<int>(frame));
+            return this->_prefix + number + ".bmp";
+        }
+        length_t inline num_written() const
+        {
+            return this->_writer.num_written();
+        }
+        /// seconds the rendering thread waited in `write` for writer thread
+        float64 inline wait_seconds() const
+        {
+            return this->_writer.wait_seconds();
+        }
+
+        /// hand a copy of figure to writer thread
+        void inline write(GraphicsBuffer const& figure, length_t const& frame)
+        {
+            this->_writer.hand(figure, frame);
+        }
+
+        /// wait until all frames are written
+        void inline flush()
+        {
+            this->_writer.flush();
+        }
+
+
+    private:
+        /// tone map and encode on writer thread
+        void _encode(GraphicsBuffer const& figure, length_t const& frame)
+        {
+            if (this->_image.size() != figure.size()) {
+                this->_image = ImageBuffer(figure.size());
+            }
+            tonemap_to_image(figure, this->_image, this->_mapping, 1);     // leave other cores to rendering threads
+            save_bmp(this->file_name(frame), this->_image);
+        }
+
+
+        string _prefix;
+        ToneMapping _mapping;
+        ImageBuffer _image;                 // used only on writer thread
+        _detail::BackgroundWriter _writer;  // last member, so its thread ends before other members are destroyed
+    };
+
+} // namespace nyas
@@ -0,0 +1,109 @@
+/// @file images/SnapshotWriter.hpp
+#pragma once
+
+#include "BackgroundWriter.hpp"
+#include "tonemap.hpp"
+#include "../common/types.hpp"
+#include "../Buffer2D.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+
+namespace nyas
+{
+    /// Write snapshots of a rendering figure into image file on a background thread.
+    ///
+    /// Rendering thread only copies sums of colors into a pending buffer in `publish`, normalizing, tone
+    /// mapping and encoding are done on writer thread. If writer is still busy when a new snapshot is
+    /// published, the older pending snapshot is replaced, so rendering never waits for disk.
+    class SnapshotWriter final
+    {
+    public:
+        /// @param file_name output bmp image, it is replaced by each snapshot
+        /// @param interval minimum seconds between two snapshots
+        /// @param mapping tone mapping of snapshots, exposure is applied on average colors
+        explicit SnapshotWriter(string const& file_name, float64 const& interval = 1., ToneMapping const& mapping = ToneMapping())
+            : _file_name(file_name)
+            , _interval(interval)
+            , _mapping(mapping)
+            , _last_publish()
+            , _num_published(0)
+            , _image()
+            , _writer([this] (GraphicsBuffer const& sums, length_t const& num_samples) { this->_encode(sums, num_samples); }, true)
+        {}
+        SnapshotWriter(SnapshotWriter const&) = delete;
+
+        SnapshotWriter & operator=(SnapshotWriter const&) = delete;
+
+        string inline const& file_name() const
+        {
+            return this->_file_name;
+        }
+        float64 inline interval() const
+        {
+            return this->_interval;
+        }
+        ToneMapping inline const& tone_mapping() const
+        {
+            return this->_mapping;
+        }
+        length_t inline num_written() const
+        {
+            return this->_writer.num_written();
+        }
+
+        /// hand a snapshot to writer thread if interval is passed since last snapshot
+        ///
+        /// @param sums sums of colors on each pixel
+        /// @param num_samples number of samples summed on each pixel
+        /// @param force publish even interval is not passed, e.g. the final image
+        /// @return true for snapshot is published
+        bool publish(GraphicsBuffer const& sums, length_t const& num_samples, bool const& force = false)
+        {
+            using namespace ::std::chrono;
+            steady_clock::time_point const now = steady_clock::now();
+            if (!force && this->_num_published > 0 && duration<float64>(now - this->_last_publish).count() < this->_interval) {
+                return false;
+            }
+            this->_writer.hand(sums, num_samples);
+            this->_last_publish = now;
+            ++this->_num_published;
+            return true;
+        }
+
+        /// wait until all published snapshots are written
+        void inline flush()
+        {
+            this->_writer.flush();
+        }
+
+
+    private:
+        /// normalize, tone map and encode on writer thread
+        void _encode(GraphicsBuffer const& sums, length_t const& num_samples)
+        {
+            ToneMapping mapping = this->_mapping;
+            mapping.exposure /= ::std::max(num_samples, 1);
+            if (this->_image.size() != sums.size()) {
+                this->_image = ImageBuffer(sums.size());
+            }
+            tonemap_to_image(sums, this->_image, mapping, 1);     // leave other cores to rendering threads
+            // write into temporary file then replace, so viewers never see half written image
+            string const temp_name = this->_file_name + ".tmp";
+            save_bmp(temp_name, this->_image);
+            ::std::remove(this->_file_name.c_str());
+            ::std::rename(temp_name.c_str(), this->_file_name.c_str());
+        }
+
+
+        string _file_name;
+        float64 _interval;
+        ToneMapping _mapping;
+        ::std::chrono::steady_clock::time_point _last_publish;
+        length_t _num_published;
+        ImageBuffer _image;                 // used only on writer thread
+        _detail::BackgroundWriter _writer;  // last member, so its thread ends before other members are destroyed
+    };
+
+} // namespace nyas
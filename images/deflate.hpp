@@ -0,0 +1,446 @@
+/// @file images/deflate.hpp
+#pragma once
+
+#include "../common/types.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <queue>
+#include <vector>
+
+
+namespace nyas
+{
+    /// a small deflate (RFC 1951) compressor with zlib (RFC 1950) wrapper, enough for image formats
+    /// that need zlib streams. It uses hash-chain LZ77 matching and a dynamic Huffman code for each block.
+    namespace deflate
+    {
+        typedef ::std::vector<uint8> ByteList;
+
+
+        namespace _detail   // ! user should not use namespace '_detail'
+        {
+            length_t constexpr WINDOW_SIZE = 32768;
+            length_t constexpr MIN_MATCH = 3;
+            length_t constexpr MAX_MATCH = 258;
+            length_t constexpr HASH_BITS = 15;
+            length_t constexpr MAX_CHAIN = 32;                  // how many earlier positions are tried to find a match
+            length_t constexpr BLOCK_TOKENS = 1 << 16;          // tokens in one deflate block
+            length_t constexpr NUM_LITLEN_CODES = 286;
+            length_t constexpr NUM_DIST_CODES = 30;
+            length_t constexpr NUM_CODELEN_CODES = 19;
+
+            uint16 constexpr length_base[29] = {
+                3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+            };
+            uint8 constexpr length_extra[29] = {
+                0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+            };
+            uint16 constexpr dist_base[30] = {
+                1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+            };
+            uint8 constexpr dist_extra[30] = {
+                0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+            };
+            uint8 constexpr codelen_order[19] = {
+                16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+            };
+
+            length_t inline length_code(length_t const& length)    // return index in length_base
+            {
+                length_t code = 28;
+                while (length_base[code] > length) {
+                    --code;
+                }
+                return code;
+            }
+            length_t inline dist_code(length_t const& dist)        // return index in dist_base
+            {
+                length_t code = 29;
+                while (dist_base[code] > dist) {
+                    --code;
+                }
+                return code;
+            }
+
+
+            /// literal (dist == 0) or match
+            struct Token final
+            {
+                uint16 value;   // literal byte or match length
+                uint16 dist;
+            };
+
+
+            /// write bits from least significant bit
+            class BitWriter final
+            {
+            public:
+                explicit BitWriter(ByteList & out)
+                    : _out(out)
+                    , _buffer(0)
+                    , _count(0)
+                {}
+
+                void inline write(uint32 const& bits, length_t const& count)
+                {
+                    this->_buffer |= static_cast<uint64>(bits) << this->_count;
+                    this->_count += count;
+                    while (this->_count >= 8) {
+                        this->_out.push_back(static_cast<uint8>(this->_buffer));
+                        this->_buffer >>= 8;
+                        this->_count -= 8;
+                    }
+                }
+                void inline flush()
+                {
+                    if (this->_count > 0) {
+                        this->_out.push_back(static_cast<uint8>(this->_buffer));
+                    }
+                    this->_buffer = 0;
+                    this->_count = 0;
+                }
+
+
+            private:
+                ByteList & _out;
+                uint64 _buffer;
+                length_t _count;
+            };
+
+
+            /// compute Huffman code lengths no longer than max_length, symbols with zero frequency get zero length
+            void huffman_lengths(::std::vector<uint32> const& freqs, length_t const& max_length, ::std::vector<uint8> & lengths)
+            {
+                length_t const num = static_cast<length_t>(freqs.size());
+                lengths.assign(num, 0);
+                ::std::vector<length_t> used;
+                for (length_t s = 0; s < num; ++s) {
+                    if (freqs[s] > 0) {
+                        used.push_back(s);
+                    }
+                }
+                // a complete code needs at least 2 symbols
+                for (length_t s = 0; used.size() < 2 && s < num; ++s) {
+                    if (freqs[s] == 0) {
+                        used.push_back(s);
+                    }
+                }
+                ::std::sort(used.begin(), used.end());
+
+                /* build Huffman tree, nodes [0, n) are leaves */
+                length_t const n = static_cast<length_t>(used.size());
+                ::std::vector<uint64> weight(2 * n);
+                ::std::vector<length_t> parent(2 * n, -1);
+                typedef ::std::pair<uint64, length_t> Node;
+                ::std::priority_queue<Node, ::std::vector<Node>, ::std::greater<Node>> heap;
+                for (length_t i = 0; i < n; ++i) {
+                    weight[i] = ::std::max<uint64>(freqs[used[i]], 1);
+                    heap.push(Node(weight[i], i));
+                }
+                length_t next = n;
+                while (heap.size() > 1) {
+                    Node const a = heap.top(); heap.pop();
+                    Node const b = heap.top(); heap.pop();
+                    weight[next] = a.first + b.first;
+                    parent[a.second] = parent[b.second] = next;
+                    heap.push(Node(weight[next], next));
+                    ++next;
+                }
+                ::std::vector<length_t> depth(next, 0);
+                for (length_t i = next - 2; i >= 0; --i) {
+                    depth[i] = depth[parent[i]] + 1;
+                }
+
+                /* limit code lengths, then give shorter codes to more frequent symbols */
+                ::std::vector<length_t> count(::std::max(max_length, n) + 1, 0);
+                length_t longest = 0;
+                for (length_t i = 0; i < n; ++i) {
+                    ++count[depth[i]];
+                    longest = ::std::max(longest, depth[i]);
+                }
+                for (; longest > max_length; --longest) {
+                    while (count[longest] > 0) {
+                        length_t j = longest - 2;
+                        while (count[j] == 0) {
+                            --j;
+                        }
+                        count[longest] -= 2;
+                        count[longest - 1] += 1;
+                        count[j + 1] += 2;
+                        count[j] -= 1;
+                    }
+                }
+                ::std::vector<length_t> order(used);
+                ::std::stable_sort(order.begin(), order.end(),
+                    [&freqs] (length_t const& a, length_t const& b) { return freqs[a] > freqs[b]; });
+                length_t k = 0;
+                for (length_t len = 1; len <= max_length; ++len) {
+                    for (length_t c = 0; c < count[len]; ++c) {
+                        lengths[order[k++]] = static_cast<uint8>(len);
+                    }
+                }
+            }
+
+            /// canonical Huffman codes from code lengths, codes are bit-reversed because Huffman codes
+            /// are packed from most significant bit while other data is packed from least significant bit
+            void huffman_codes(::std::vector<uint8> const& lengths, ::std::vector<uint32> & codes)
+            {
+                uint32 count[16] = {0}, next_code[16] = {0};
+                for (uint8 const& len : lengths) {
+                    ++count[len];
+                }
+                count[0] = 0;
+                uint32 code = 0;
+                for (length_t len = 1; len < 16; ++len) {
+                    code = (code + count[len - 1]) << 1;
+                    next_code[len] = code;
+                }
+                codes.assign(lengths.size(), 0);
+                for (::std::size_t s = 0; s < lengths.size(); ++s) {
+                    if (lengths[s] != 0) {
+                        uint32 const code = next_code[lengths[s]]++;
+                        for (length_t n = 0; n < lengths[s]; ++n) {
+                            codes[s] |= ((code >> n) & 1) << (lengths[s] - 1 - n);
+                        }
+                    }
+                }
+            }
+
+
+            /// write one block with dynamic Huffman codes
+            void write_block(Token const* tokens, length_t const& num_tokens, bool const& final, BitWriter & writer)
+            {
+                ::std::vector<uint32> litlen_freqs(NUM_LITLEN_CODES, 0), dist_freqs(NUM_DIST_CODES, 0);
+                for (length_t t = 0; t < num_tokens; ++t) {
+                    if (tokens[t].dist == 0) {
+                        ++litlen_freqs[tokens[t].value];
+                    }
+                    else {
+                        ++litlen_freqs[257 + length_code(tokens[t].value)];
+                        ++dist_freqs[dist_code(tokens[t].dist)];
+                    }
+                }
+                ++litlen_freqs[256];    // end of block
+
+                ::std::vector<uint8> litlen_lengths, dist_lengths;
+                huffman_lengths(litlen_freqs, 15, litlen_lengths);
+                huffman_lengths(dist_freqs, 15, dist_lengths);
+                length_t num_litlen = NUM_LITLEN_CODES, num_dist = NUM_DIST_CODES;
+                while (num_litlen > 257 && litlen_lengths[num_litlen - 1] == 0) {
+                    --num_litlen;
+                }
+                while (num_dist > 1 && dist_lengths[num_dist - 1] == 0) {
+                    --num_dist;
+                }
+
+                /* run-length encode code lengths of both trees as one sequence */
+                ::std::vector<uint8> all_lengths(litlen_lengths.begin(), litlen_lengths.begin() + num_litlen);
+                all_lengths.insert(all_lengths.end(), dist_lengths.begin(), dist_lengths.begin() + num_dist);
+                ::std::vector<uint8> rle_symbols, rle_extras;
+                ::std::vector<uint32> codelen_freqs(NUM_CODELEN_CODES, 0);
+                length_t const total = static_cast<length_t>(all_lengths.size());
+                for (length_t i = 0; i < total;) {
+                    uint8 const len = all_lengths[i];
+                    length_t run = 1;
+                    while (i + run < total && all_lengths[i + run] == len) {
+                        ++run;
+                    }
+                    if (len == 0 && run >= 11) {
+                        run = ::std::min<length_t>(run, 138);
+                        rle_symbols.push_back(18);
+                        rle_extras.push_back(static_cast<uint8>(run - 11));
+                    }
+                    else if (len == 0 && run >= 3) {
+                        rle_symbols.push_back(17);
+                        rle_extras.push_back(static_cast<uint8>(run - 3));
+                    }
+                    else if (len != 0 && run >= 4) {
+                        run = ::std::min<length_t>(run, 7);
+                        rle_symbols.push_back(len);
+                        rle_extras.push_back(0);
+                        rle_symbols.push_back(16);
+                        rle_extras.push_back(static_cast<uint8>(run - 4));
+                        ++codelen_freqs[len];
+                    }
+                    else {
+                        run = 1;
+                        rle_symbols.push_back(len);
+                        rle_extras.push_back(0);
+                    }
+                    ++codelen_freqs[rle_symbols.back()];
+                    i += run;
+                }
+                ::std::vector<uint8> codelen_lengths;
+                huffman_lengths(codelen_freqs, 7, codelen_lengths);
+                length_t num_codelen = NUM_CODELEN_CODES;
+                while (num_codelen > 4 && codelen_lengths[codelen_order[num_codelen - 1]] == 0) {
+                    --num_codelen;
+                }
+
+                ::std::vector<uint32> litlen_codes, dist_codes, codelen_codes;
+                huffman_codes(litlen_lengths, litlen_codes);
+                huffman_codes(dist_lengths, dist_codes);
+                huffman_codes(codelen_lengths, codelen_codes);
+
+                /* block header */
+                writer.write(final ? 1 : 0, 1);
+                writer.write(2, 2);     // dynamic Huffman
+                writer.write(num_litlen - 257, 5);
+                writer.write(num_dist - 1, 5);
+                writer.write(num_codelen - 4, 4);
+                for (length_t i = 0; i < num_codelen; ++i) {
+                    writer.write(codelen_lengths[codelen_order[i]], 3);
+                }
+                for (::std::size_t i = 0; i < rle_symbols.size(); ++i) {
+                    uint8 const sym = rle_symbols[i];
+                    writer.write(codelen_codes[sym], codelen_lengths[sym]);
+                    if (sym == 16) {
+                        writer.write(rle_extras[i], 2);
+                    }
+                    else if (sym == 17) {
+                        writer.write(rle_extras[i], 3);
+                    }
+                    else if (sym == 18) {
+                        writer.write(rle_extras[i], 7);
+                    }
+                }
+
+                /* compressed data */
+                for (length_t t = 0; t < num_tokens; ++t) {
+                    Token const& token = tokens[t];
+                    if (token.dist == 0) {
+                        writer.write(litlen_codes[token.value], litlen_lengths[token.value]);
+                    }
+                    else {
+                        length_t const lc = length_code(token.value);
+                        writer.write(litlen_codes[257 + lc], litlen_lengths[257 + lc]);
+                        writer.write(token.value - length_base[lc], length_extra[lc]);
+                        length_t const dc = dist_code(token.dist);
+                        writer.write(dist_codes[dc], dist_lengths[dc]);
+                        writer.write(token.dist - dist_base[dc], dist_extra[dc]);
+                    }
+                }
+                writer.write(litlen_codes[256], litlen_lengths[256]);
+            }
+
+        } // namespace _detail
+
+
+        /// Adler-32 checksum used in zlib stream
+        uint32 adler32(uint8 const* data, ::std::size_t size)
+        {
+            uint32 a = 1, b = 0;
+            while (size > 0) {
+                ::std::size_t const block = ::std::min<::std::size_t>(size, 5552);     // largest block without overflow
+                for (::std::size_t i = 0; i < block; ++i) {
+                    a += data[i];
+                    b += a;
+                }
+                a %= 65521;
+                b %= 65521;
+                data += block;
+                size -= block;
+            }
+            return (b << 16) | a;
+        }
+
+        /// compress data into raw deflate stream, append to out
+        void compress_raw(uint8 const* data, ::std::size_t const& size, ByteList & out)
+        {
+            using namespace _detail;
+            BitWriter writer(out);
+            ::std::vector<Token> tokens;
+            tokens.reserve(BLOCK_TOKENS);
+            ::std::vector<int64> head(::std::size_t(1) << HASH_BITS, -1);
+            ::std::vector<int64> prev(WINDOW_SIZE, -1);
+            auto const hash = [data] (::std::size_t const& i) -> ::std::size_t {
+                uint32 const v = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+                return (v * 2654435761u) >> (32 - HASH_BITS);
+            };
+            auto const insert = [&head, &prev, &hash] (::std::size_t const& i) {
+                ::std::size_t const h = hash(i);
+                prev[i % WINDOW_SIZE] = head[h];
+                head[h] = static_cast<int64>(i);
+            };
+
+            ::std::size_t i = 0;
+            while (i < size) {
+                length_t best_length = 0, best_dist = 0;
+                if (i + MIN_MATCH <= size) {
+                    length_t const max_length = static_cast<length_t>(::std::min<::std::size_t>(MAX_MATCH, size - i));
+                    int64 candidate = head[hash(i)];
+                    for (length_t chain = 0; candidate >= 0 && chain < MAX_CHAIN; ++chain) {
+                        ::std::size_t const dist = i - static_cast<::std::size_t>(candidate);
+                        if (dist > static_cast<::std::size_t>(WINDOW_SIZE)) {
+                            break;
+                        }
+                        uint8 const* a = data + candidate;
+                        uint8 const* b = data + i;
+                        if (a[best_length] == b[best_length]) {
+                            length_t length = 0;
+                            while (length < max_length && a[length] == b[length]) {
+                                ++length;
+                            }
+                            if (length > best_length) {
+                                best_length = length;
+                                best_dist = static_cast<length_t>(dist);
+                                if (length == max_length) {
+                                    break;
+                                }
+                            }
+                        }
+                        int64 const older = prev[candidate % WINDOW_SIZE];
+                        if (older >= candidate) {    // slot is already reused by a newer position
+                            break;
+                        }
+                        candidate = older;
+                    }
+                }
+                if (best_length >= MIN_MATCH) {
+                    tokens.push_back(Token{static_cast<uint16>(best_length), static_cast<uint16>(best_dist)});
+                    for (::std::size_t end = i + best_length; i < end; ++i) {
+                        if (i + MIN_MATCH <= size) {
+                            insert(i);
+                        }
+                    }
+                }
+                else {
+                    tokens.push_back(Token{data[i], 0});
+                    if (i + MIN_MATCH <= size) {
+                        insert(i);
+                    }
+                    ++i;
+                }
+                if (static_cast<length_t>(tokens.size()) == BLOCK_TOKENS && i < size) {
+                    write_block(tokens.data(), BLOCK_TOKENS, false, writer);
+                    tokens.clear();
+                }
+            }
+            write_block(tokens.data(), static_cast<length_t>(tokens.size()), true, writer);
+            writer.flush();
+        }
+
+        /// compress data into zlib stream
+        ByteList compress(uint8 const* data, ::std::size_t const& size)
+        {
+            ByteList out;
+            out.reserve(size / 2 + 64);
+            out.push_back(0x78);    // deflate with 32K window
+            out.push_back(0x9C);    // default level, header checksum
+            compress_raw(data, size, out);
+            uint32 const checksum = adler32(data, size);
+            out.push_back(static_cast<uint8>(checksum >> 24));
+            out.push_back(static_cast<uint8>(checksum >> 16));
+            out.push_back(static_cast<uint8>(checksum >> 8));
+            out.push_back(static_cast<uint8>(checksum));
+            return out;
+        }
+
+    } // namespace deflate
+
+} // namespace nyas
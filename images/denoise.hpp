@@ -0,0 +1,231 @@
+/// @file images/denoise.hpp
+#pragma once
+
+#include "../common/types.hpp"
+#include "../common/constants.hpp"
+#include "../common/functions.hpp"
+#include "../Buffer2D.hpp"
+#include "../AuxiliaryBuffers.hpp"
+#include "../utils.hpp"
+#include <assert.h>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <vector>
+
+
+namespace nyas
+{
+    /// settings of `denoise`, sigmas are tolerances of differences between pixels, larger sigma blurs more
+    struct DenoiseOptions final
+    {
+        length_t iterations;    // passes of filter, the filter reaches 2^(iterations + 1) pixels away
+        float32 sigma_color;    // on colors compressed by c / (1 + c), halved after each pass
+        float32 sigma_normal;   // on difference of unit normals
+        float32 sigma_depth;    // on depth difference relative to depth and distance in pixels
+        float32 sigma_albedo;   // on difference of albedos
+        bool demodulate;        // filter colors divided by albedo, so texture of albedo is not blurred
+
+
+        DenoiseOptions()
+            : iterations(5)
+            , sigma_color(0.1f)
+            , sigma_normal(0.3f)
+            , sigma_depth(0.02f)
+            , sigma_albedo(0.1f)
+            , demodulate(true)
+        {}
+    };
+
+
+    namespace _detail   // ! user should not use namespace '_detail'
+    {
+        float32 constexpr DEMODULATE_MIN_ALBEDO = 1e-3f;
+        float32 constexpr SKY_DEPTH = 1e30f;                // finite depth of sky, so differences stay finite
+        float32 constexpr MAX_WEIGHT_EXPONENT = 20.f;       // weights below exp(-20) are taken as exp(-20)
+        int32 constexpr MAX_WEIGHT_EXPONENT_BITS = ::std::bit_cast<int32>(MAX_WEIGHT_EXPONENT);
+        length_t constexpr ATROUS_CHUNK = 64;               // pixels filtered together in a row
+
+        /// weights of B3 spline, the 5x5 kernel is their outer product
+        float32 constexpr ATROUS_KERNEL[5] = {1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f};
+
+        /// exp(-min(x, MAX_WEIGHT_EXPONENT)) for x >= 0, relative error below 1e-6. Only arithmetic and bit
+        /// casts, so loops calling it are vectorized by compilers, unlike `std::exp`. x is clamped on its bits
+        /// (ordered the same as non-negative floats), a float comparison would keep loops from vectorizing.
+        float32 inline exp_negative(float32 const& x)
+        {
+            int32 const bits = ::std::bit_cast<int32>(x);
+            float32 const t = ::std::bit_cast<float32>((bits < MAX_WEIGHT_EXPONENT_BITS) ? bits : MAX_WEIGHT_EXPONENT_BITS) * -1.44269504f;     // exp(-x) = 2^t
+            int32 const i = static_cast<int32>(t);              // toward zero, so f is in (-1, 0]
+            float32 const f = t - static_cast<float32>(i);
+            float32 const p = 1.f + f * (0.693147182f + f * (0.240226507f + f * (0.0555041087f + f * (0.00961812911f + f * 0.00133335581f))));
+            return p * ::std::bit_cast<float32>((i + 127) << 23);
+        }
+
+        /// figure and features in separate planes of floats, so filtering loops read contiguous floats
+        struct DenoisePlanes final
+        {
+            length_t width, height;
+            ::std::vector<float32> r, g, b;             // colors
+            ::std::vector<float32> cr, cg, cb;          // colors compressed by c / (1 + c)
+            ::std::vector<float32> nx, ny, nz;          // normals
+            ::std::vector<float32> ar, ag, ab;          // albedos
+            ::std::vector<float32> depth;
+
+
+            explicit DenoisePlanes(AuxiliaryBuffers const& aux)
+                : width(aux.size().x), height(aux.size().y)
+                , r(aux.albedo.total()), g(aux.albedo.total()), b(aux.albedo.total())
+                , cr(aux.albedo.total()), cg(aux.albedo.total()), cb(aux.albedo.total())
+                , nx(aux.albedo.total()), ny(aux.albedo.total()), nz(aux.albedo.total())
+                , ar(aux.albedo.total()), ag(aux.albedo.total()), ab(aux.albedo.total())
+                , depth(aux.albedo.total())
+            {
+                for (offset_t i = 0; i < aux.albedo.total(); ++i) {
+                    RGBColor const n = aux.normal.data_pointer()[i], a = aux.albedo.data_pointer()[i];
+                    float32 const z = aux.depth.data_pointer()[i];
+                    this->nx[i] = n.x;  this->ny[i] = n.y;  this->nz[i] = n.z;
+                    this->ar[i] = a.x;  this->ag[i] = a.y;  this->ab[i] = a.z;
+                    this->depth[i] = (z < SKY_DEPTH) ? z : SKY_DEPTH;
+                }
+            }
+
+            /// set color, and its compressed copy
+            void inline set_color(offset_t const& i, RGBColor const& c)
+            {
+                this->r[i] = c.x;   this->g[i] = c.y;   this->b[i] = c.z;
+                this->cr[i] = c.x / (1.f + c.x);    this->cg[i] = c.y / (1.f + c.y);    this->cb[i] = c.z / (1.f + c.z);
+            }
+        };
+
+        /// albedo dividing colors, dark channels are clamped so colors on black surfaces survive
+        RGBColor inline demodulation_albedo(RGBColor const& albedo)
+        {
+            return RGBColor(::std::max(albedo.x, DEMODULATE_MIN_ALBEDO), ::std::max(albedo.y, DEMODULATE_MIN_ALBEDO), ::std::max(albedo.z, DEMODULATE_MIN_ALBEDO));
+        }
+
+        /// one pass of edge-avoiding a-trous filter on row y, taps are step pixels apart. Taps out of figure
+        /// are skipped and weights of the others are normalized. Row is done in chunks, for each tap a chunk
+        /// is done in one loop without branches. Sums are in local arrays, which never alias the planes, so
+        /// compilers vectorize the loop.
+        void atrous_row(DenoisePlanes const& in, RGBColor * out, length_t const& y, length_t const& step, float32 const& sigma_color, DenoiseOptions const& options)
+        {
+            length_t const width = in.width;
+            float32 const inverse_color = 1.f / (sigma_color * sigma_color);
+            float32 const inverse_normal = 1.f / (options.sigma_normal * options.sigma_normal);
+            float32 const inverse_albedo = 1.f / (options.sigma_albedo * options.sigma_albedo);
+            float32 const inverse_depth = 1.f / (options.sigma_depth * step);
+            float32 const* const r = in.r.data(), * const g = in.g.data(), * const b = in.b.data();
+            float32 const* const cr = in.cr.data(), * const cg = in.cg.data(), * const cb = in.cb.data();
+            float32 const* const nx = in.nx.data(), * const ny = in.ny.data(), * const nz = in.nz.data();
+            float32 const* const ar = in.ar.data(), * const ag = in.ag.data(), * const ab = in.ab.data();
+            float32 const* const depth = in.depth.data();
+            length_t const row_p = y * width;
+
+            for (length_t chunk_begin = 0; chunk_begin < width; chunk_begin += ATROUS_CHUNK) {
+                length_t const chunk_end = ::std::min(chunk_begin + ATROUS_CHUNK, width);
+                float32 sum_r[ATROUS_CHUNK] = {}, sum_g[ATROUS_CHUNK] = {}, sum_b[ATROUS_CHUNK] = {}, sum_w[ATROUS_CHUNK] = {};
+                for (length_t j = 0; j < 5; ++j) {
+                    int64 const qy = static_cast<int64>(y) + (static_cast<int64>(j) - 2) * step;
+                    if (qy < 0 || qy >= in.height) {
+                        continue;
+                    }
+                    for (length_t i = 0; i < 5; ++i) {
+                        int64 const dx = (static_cast<int64>(i) - 2) * step;
+                        length_t const x_begin = static_cast<length_t>(::std::max<int64>(chunk_begin, -dx));
+                        length_t const x_end = static_cast<length_t>(::std::min<int64>(chunk_end, width - dx));
+                        length_t const shift = static_cast<length_t>(qy * width + dx) - row_p;      // q = p + shift
+                        float32 const kernel = ATROUS_KERNEL[i] * ATROUS_KERNEL[j];
+                        for (length_t x = x_begin; x < x_end; ++x) {
+                            length_t const p = row_p + x;
+                            length_t const q = p + shift;
+                            float32 const dcr = cr[q] - cr[p], dcg = cg[q] - cg[p], dcb = cb[q] - cb[p];
+                            float32 const dnx = nx[q] - nx[p], dny = ny[q] - ny[p], dnz = nz[q] - nz[p];
+                            float32 const dar = ar[q] - ar[p], dag = ag[q] - ag[p], dab = ab[q] - ab[p];
+                            float32 const zp = depth[p], zq = depth[q];
+                            // depth difference relative to the nearer one, so sky (SKY_DEPTH) is never alike to objects
+                            float32 const exponent =
+                                (dcr * dcr + dcg * dcg + dcb * dcb) * inverse_color +
+                                (dnx * dnx + dny * dny + dnz * dnz) * inverse_normal +
+                                (dar * dar + dag * dag + dab * dab) * inverse_albedo +
+                                ::std::abs(zq - zp) * inverse_depth / ::std::min(zp, zq);
+                            float32 const weight = kernel * exp_negative(exponent);
+                            length_t const c = x - chunk_begin;
+                            sum_r[c] += r[q] * weight;
+                            sum_g[c] += g[q] * weight;
+                            sum_b[c] += b[q] * weight;
+                            sum_w[c] += weight;
+                        }
+                    }
+                }
+                for (length_t x = chunk_begin; x < chunk_end; ++x) {
+                    length_t const c = x - chunk_begin;
+                    out[x] = RGBColor(sum_r[c], sum_g[c], sum_b[c]) / sum_w[c];     // tap on pixel itself has weight > 0
+                }
+            }
+        }
+
+    } // namespace _detail
+
+
+    /// edge-avoiding a-trous wavelet filter (Dammertz et al. 2010) guided by first-hit features in aux.
+    /// Each pass is a 5x5 kernel with holes, rows are split between threads. Pixels keep colors of
+    /// neighbours only if their colors, normals, albedos and depths are alike.
+    ///
+    /// @param color average colors of samples, e.g. `Camera::figure()`
+    /// @param aux features of the same figure, see `World::render_auxiliary`
+    /// @param output may be color itself
+    GraphicsBuffer & denoise(GraphicsBuffer const& color, AuxiliaryBuffers const& aux, GraphicsBuffer & output,
+                             DenoiseOptions const& options = DenoiseOptions(), length_t const& num_threads = default_num_threads())
+    {
+        using namespace _detail;
+        assert(color.size() == aux.size() && color.size() == output.size());
+        if (!color.valid()) {
+            return output;
+        }
+        length_t constexpr rows_per_job = 16;
+        length_t const width = color.width(), height = color.height();
+        length_t const num_jobs = (height + rows_per_job - 1) / rows_per_job;
+        offset_t const total = color.total();
+
+        /* filter colors divided by albedo */
+        DenoisePlanes planes(aux);
+        for (offset_t i = 0; i < total; ++i) {
+            RGBColor const c = color.data_pointer()[i];
+            planes.set_color(i, options.demodulate ? c / demodulation_albedo(aux.albedo.data_pointer()[i]) : c);
+        }
+
+        GraphicsBuffer filtered(color.size());
+        float32 sigma_color = options.sigma_color;
+        for (length_t iteration = 0; iteration < options.iterations; ++iteration) {
+            length_t const step = length_t(1) << iteration;
+            parallel_for(num_jobs, num_threads,
+                [&planes, &filtered, &width, &height, &step, &sigma_color, &options] (length_t const& job) {
+                    length_t const end_row = ::std::min((job + 1) * rows_per_job, height);
+                    for (length_t y = job * rows_per_job; y < end_row; ++y) {
+                        atrous_row(planes, filtered.data_pointer() + static_cast<offset_t>(y) * width, y, step, sigma_color, options);
+                    }
+                }
+            );
+            for (offset_t i = 0; i < total; ++i) {
+                planes.set_color(i, filtered.data_pointer()[i]);
+            }
+            sigma_color *= 0.5f;
+        }
+
+        for (offset_t i = 0; i < total; ++i) {
+            RGBColor const c(planes.r[i], planes.g[i], planes.b[i]);
+            output.data_pointer()[i] = options.demodulate ? c * demodulation_albedo(aux.albedo.data_pointer()[i]) : c;
+        }
+        return output;
+    }
+
+    GraphicsBuffer inline denoise(GraphicsBuffer const& color, AuxiliaryBuffers const& aux, DenoiseOptions const& options = DenoiseOptions(),
+                                  length_t const& num_threads = default_num_threads())
+    {
+        GraphicsBuffer output(color.size());
+        denoise(color, aux, output, options, num_threads);
+        return output;
+    }
+
+} // namespace nyas
@@ -0,0 +1,214 @@
+/// @file images/exr.hpp
+#pragma once
+
+#include "deflate.hpp"
+#include "../common/types.hpp"
+#include "../Buffer2D.hpp"
+#include "../utils.hpp"
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+namespace nyas
+{
+    /// compression methods of OpenEXR supported by `save_exr`
+    enum class EXRCompression : uint8
+    {
+        None = 0,       // uncompressed, 1 scanline in each chunk
+        ZIPS = 2,       // zlib, 1 scanline in each chunk
+        ZIP = 3         // zlib, 16 scanlines in each chunk
+    };
+
+
+    namespace _detail   // ! user should not use namespace '_detail'
+    {
+        typedef ::std::vector<uint8> ByteList;
+
+        length_t constexpr EXR_CHUNKS_IN_BAND = 8;     // chunks encoded by each thread before writing
+
+        template<typename T>
+        void inline put_le(ByteList & out, T const& value)
+        {
+            uint8 bytes[sizeof(T)];
+            memcpy(bytes, &value, sizeof(T));
+            if (::std::endian::native == ::std::endian::big) {
+                ::std::reverse(bytes, bytes + sizeof(T));
+            }
+            out.insert(out.end(), bytes, bytes + sizeof(T));
+        }
+
+        void inline put_string(ByteList & out, char const* str)
+        {
+            out.insert(out.end(), str, str + strlen(str) + 1);
+        }
+
+        void put_attribute(ByteList & out, char const* name, char const* type, ByteList const& value)
+        {
+            put_string(out, name);
+            put_string(out, type);
+            put_le<int32>(out, static_cast<int32>(value.size()));
+            out.insert(out.end(), value.begin(), value.end());
+        }
+
+        length_t inline exr_lines_per_chunk(EXRCompression const& compression)
+        {
+            return (compression == EXRCompression::ZIP) ? 16 : 1;
+        }
+
+        ByteList exr_header(Length2D const& size, EXRCompression const& compression)
+        {
+            ByteList out, value;
+            put_le<uint32>(out, 20000630);      // magic number
+            put_le<uint32>(out, 2);             // version 2, single-part scanline
+
+            for (char const* channel : {"B", "G", "R"}) {       // channels are sorted by name
+                put_string(value, channel);
+                put_le<int32>(value, 2);        // FLOAT
+                put_le<uint32>(value, 0);       // pLinear and reserved
+                put_le<int32>(value, 1);        // x sampling
+                put_le<int32>(value, 1);        // y sampling
+            }
+            value.push_back(0);
+            put_attribute(out, "channels", "chlist", value);
+
+            value.assign(1, static_cast<uint8>(compression));
+            put_attribute(out, "compression", "compression", value);
+
+            value.clear();
+            put_le<int32>(value, 0);
+            put_le<int32>(value, 0);
+            put_le<int32>(value, size.x - 1);
+            put_le<int32>(value, size.y - 1);
+            put_attribute(out, "dataWindow", "box2i", value);
+            put_attribute(out, "displayWindow", "box2i", value);
+
+            value.assign(1, 0);                 // INCREASING_Y
+            put_attribute(out, "lineOrder", "lineOrder", value);
+
+            value.clear();
+            put_le<float32>(value, 1.f);
+            put_attribute(out, "pixelAspectRatio", "float", value);
+
+            value.clear();
+            put_le<float32>(value, 0.f);
+            put_le<float32>(value, 0.f);
+            put_attribute(out, "screenWindowCenter", "v2f", value);
+
+            value.clear();
+            put_le<float32>(value, 1.f);
+            put_attribute(out, "screenWindowWidth", "float", value);
+
+            out.push_back(0);                   // end of header
+            return out;
+        }
+
+        /// encode scanlines [first_line, first_line + num_lines) into one chunk, EXR line y is
+        /// GraphicsBuffer row (height - 1 - y) because EXR stores lines from top to bottom
+        void encode_exr_chunk(GraphicsBuffer const& buff, length_t const& first_line, length_t const& num_lines, EXRCompression const& compression, ByteList & chunk)
+        {
+            length_t const width = buff.width();
+            ::std::size_t const raw_size = static_cast<::std::size_t>(num_lines) * width * 3 * sizeof(float32);
+            ByteList raw(raw_size);
+            float32 * out = reinterpret_cast<float32 *>(raw.data());
+            for (length_t line = first_line; line < first_line + num_lines; ++line) {
+                RGBColor const* row = buff.data_pointer() + static_cast<::std::size_t>(buff.height() - 1 - line) * width;
+                for (length_t c = 2; c >= 0; --c) {    // B, G, R
+                    for (length_t x = 0; x < width; ++x) {
+                        *(out++) = row[x][c];
+                    }
+                }
+            }
+            if (::std::endian::native == ::std::endian::big) {
+                for (::std::size_t i = 0; i < raw_size; i += 4) {
+                    ::std::reverse(raw.begin() + i, raw.begin() + i + 4);
+                }
+            }
+
+            ByteList const* data = &raw;
+            ByteList compressed;
+            if (compression != EXRCompression::None) {
+                /* split even and odd bytes, then store differences, zlib compresses them much better */
+                ByteList predicted(raw_size);
+                ::std::size_t const half = (raw_size + 1) / 2;
+                for (::std::size_t i = 0; i < raw_size; ++i) {
+                    predicted[(i & 1) ? half + i / 2 : i / 2] = raw[i];
+                }
+                for (::std::size_t i = raw_size - 1; i > 0; --i) {
+                    predicted[i] = static_cast<uint8>(predicted[i] - predicted[i - 1] + 128);
+                }
+                compressed = deflate::compress(predicted.data(), raw_size);
+                if (compressed.size() < raw_size) {     // otherwise data is stored uncompressed
+                    data = &compressed;
+                }
+            }
+
+            chunk.clear();
+            chunk.reserve(data->size() + 8);
+            put_le<int32>(chunk, first_line);
+            put_le<int32>(chunk, static_cast<int32>(data->size()));
+            chunk.insert(chunk.end(), data->begin(), data->end());
+        }
+
+    } // namespace _detail
+
+
+    /// save floating-point colors into single-part scanline OpenEXR image with 32-bit float channels.
+    ///
+    /// Chunks are encoded in bands on multiple threads, then each band is written sequentially.
+    bool save_exr(char const* file_name, GraphicsBuffer const& buff, EXRCompression const& compression = EXRCompression::ZIP, length_t const& num_threads = default_num_threads())
+    {
+        using namespace _detail;
+        static_assert(sizeof(RGBColor) == 3 * sizeof(float32), "'save_exr' requires tightly packed RGBColor");
+
+        ::std::ofstream outfile(file_name, ::std::ios::out | ::std::ios::binary | ::std::ios::trunc);
+        if (!outfile || !buff.valid()) {
+            return false;
+        }
+        length_t const lines_per_chunk = exr_lines_per_chunk(compression);
+        length_t const num_chunks = (buff.height() + lines_per_chunk - 1) / lines_per_chunk;
+
+        /* header and a placeholder of offset table, which is filled after all chunks are written */
+        ByteList const header = exr_header(buff.size(), compression);
+        outfile.write(reinterpret_cast<char const*>(header.data()), header.size());
+        ::std::vector<uint64> offsets(num_chunks, 0);
+        outfile.write(reinterpret_cast<char const*>(offsets.data()), num_chunks * sizeof(uint64));
+        uint64 position = header.size() + num_chunks * sizeof(uint64);
+
+        length_t const band_size = num_threads * EXR_CHUNKS_IN_BAND;
+        ::std::vector<ByteList> chunks(::std::min(band_size, num_chunks));
+        for (length_t band_start = 0; band_start < num_chunks; band_start += band_size) {
+            length_t const band_end = ::std::min(band_start + band_size, num_chunks);
+            parallel_for(band_end - band_start, num_threads,
+                [&buff, &chunks, &band_start, &lines_per_chunk, &compression] (length_t const& i) {
+                    length_t const first_line = (band_start + i) * lines_per_chunk;
+                    length_t const num_lines = ::std::min(lines_per_chunk, buff.height() - first_line);
+                    encode_exr_chunk(buff, first_line, num_lines, compression, chunks[i]);
+                }
+            );
+            for (length_t i = 0; i < band_end - band_start; ++i) {
+                offsets[band_start + i] = position;
+                outfile.write(reinterpret_cast<char const*>(chunks[i].data()), chunks[i].size());
+                position += chunks[i].size();
+            }
+        }
+
+        /* fill offset table */
+        ByteList table;
+        table.reserve(num_chunks * sizeof(uint64));
+        for (uint64 const& offset : offsets) {
+            put_le<uint64>(table, offset);
+        }
+        outfile.seekp(header.size());
+        outfile.write(reinterpret_cast<char const*>(table.data()), table.size());
+        outfile.close();
+        return outfile.good();
+    }
+    bool inline save_exr(string const& str, GraphicsBuffer const& buff, EXRCompression const& compression = EXRCompression::ZIP, length_t const& num_threads = default_num_threads())
+    {
+        return save_exr(str.c_str(), buff, compression, num_threads);
+    }
+
+} // namespace nyas
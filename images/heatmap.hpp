@@ -0,0 +1,78 @@
+/// @file images/heatmap.hpp
+#pragma once
+
+#include "../common/types.hpp"
+#include "../Buffer2D.hpp"
+#include "../RenderProfile.hpp"
+#include <assert.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+namespace nyas
+{
+    namespace _detail
+    {
+        /// colors of heatmap at 0, 1/4, 2/4, 3/4 and 1
+        RGBColor const HEATMAP_STOPS[] = {
+            RGBColor(0.f, 0.f, 0.5f),       // dark blue
+            RGBColor(0.f, 0.8f, 1.f),       // cyan
+            RGBColor(0.f, 0.9f, 0.f),       // green
+            RGBColor(1.f, 0.9f, 0.f),       // yellow
+            RGBColor(1.f, 0.f, 0.f)         // red
+        };
+
+        /// color of value in [0, 1], linear between stops
+        ImageRGBColor inline heatmap_color(float32 const& value)
+        {
+            float32 const position = ::std::clamp(value, 0.f, 1.f) * 4.f;
+            length_t const stop = ::std::min(static_cast<length_t>(position), 3);
+            float32 const s = position - stop;
+            RGBColor const color = HEATMAP_STOPS[stop] * (1.f - s) + HEATMAP_STOPS[stop + 1] * s;
+            return ImageRGBColor(color * 255.f + 0.5f);
+        }
+
+    } // namespace _detail
+
+
+    /// false-color image of values, from dark blue at zero through cyan, green and yellow to red at the largest
+    /// value, so hot spots are seen at a glance. Colors are linear in values.
+    ///
+    /// @param block values are summed over blocks of block x block pixels from the top-left corner, each block is
+    ///              painted by its sum, e.g. `World::DEFAULT_TILE_SIZE` for costs of tiles
+    template<typename T, typename L>
+    ImageBuffer heatmap(Buffer2D<T, L> const& values, length_t const& block = 1)
+    {
+        assert(block > 0);
+        if (!values.valid()) {
+            return ImageBuffer();
+        }
+        length_t const blocks_x = (values.width() + block - 1) / block;
+        length_t const blocks_y = (values.height() + block - 1) / block;
+        ::std::vector<float64> sums(static_cast<size_t>(blocks_x) * blocks_y, 0.);
+        for (length_t y = 0; y < values.height(); ++y) {
+            for (length_t x = 0; x < values.width(); ++x) {
+                sums[(y / block) * blocks_x + x / block] += static_cast<float64>(values(x, y));
+            }
+        }
+        float64 const largest = *::std::max_element(sums.begin(), sums.end());
+        float64 const scale = (largest > 0.) ? 1. / largest : 0.;
+        ImageBuffer image(values.size());
+        for (length_t y = 0; y < values.height(); ++y) {
+            for (length_t x = 0; x < values.width(); ++x) {
+                image(x, y) = _detail::heatmap_color(static_cast<float32>(sums[(y / block) * blocks_x + x / block] * scale));
+            }
+        }
+        return image;
+    }
+
+    /// write heatmaps of profile into prefix + "_seconds.bmp" and prefix + "_rays.bmp", e.g. next to the
+    /// beauty output written into prefix + ".bmp"
+    void inline save_heatmaps(string const& prefix, RenderProfile const& profile, length_t const& block = 1)
+    {
+        save_bmp(prefix + "_seconds.bmp", heatmap(profile.seconds, block));
+        save_bmp(prefix + "_rays.bmp", heatmap(profile.rays, block));
+    }
+
+} // namespace nyas
@@ -0,0 +1,38 @@
+/// @file images/pfm.hpp
+#pragma once
+
+#include "../common/types.hpp"
+#include "../Buffer2D.hpp"
+#include <bit>
+#include <fstream>
+#include <string>
+
+
+namespace nyas
+{
+    /// save floating-point colors into portable float map (PFM) without clamping or quantizing.
+    ///
+    /// PFM stores scanlines from bottom to top, same as GraphicsBuffer, so header and pixels are
+    /// written directly from the buffer in two writes.
+    bool save_pfm(char const* file_name, GraphicsBuffer const& buff)
+    {
+        static_assert(sizeof(RGBColor) == 3 * sizeof(float32), "'save_pfm' requires tightly packed RGBColor");
+
+        ::std::ofstream outfile(file_name, ::std::ios::out | ::std::ios::binary | ::std::ios::trunc);
+        if (!outfile) {
+            return false;
+        }
+        // negative scale for little endian data
+        string const header = "PF\n" + ::std::to_string(buff.width()) + ' ' + ::std::to_string(buff.height()) + '\n'
+            + ((::std::endian::native == ::std::endian::little) ? "-1.0\n" : "1.0\n");
+        outfile.write(header.data(), header.size());
+        outfile.write(reinterpret_cast<char const*>(buff.data_pointer()), static_cast<::std::streamsize>(buff.total()) * sizeof(RGBColor));
+        outfile.close();
+        return outfile.good();
+    }
+    bool inline save_pfm(string const& str, GraphicsBuffer const& buff)
+    {
+        return save_pfm(str.c_str(), buff);
+    }
+
+} // namespace nyas
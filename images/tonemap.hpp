@@ -0,0 +1,169 @@
+/// @file images/tonemap.hpp
+#pragma once
+
+#include "../common/types.hpp"
+#include "../common/functions.hpp"
+#include "../Buffer2D.hpp"
+#include "../utils.hpp"
+#include <assert.h>
+
+
+namespace nyas
+{
+    enum class ToneMappingOperator
+    {
+        Clamp,          // clamp colors into [0, 1]
+        Reinhard,       // c / (1 + c) on each channel
+        ACES            // Narkowicz's fit of ACES filmic curve
+    };
+
+    /// settings of mapping floating-point colors to display colors
+    struct ToneMapping final
+    {
+        float32 exposure;               // colors are multiplied by exposure before tone mapping
+        ToneMappingOperator op;
+        float32 gamma;                  // display gamma, 1 for linear output
+        bool dither;                    // add noise before quantizing to hide banding
+
+
+        ToneMapping()
+            : exposure(1.f)
+            , op(ToneMappingOperator::Clamp)
+            , gamma(2.2f)
+            , dither(true)
+        {}
+        explicit ToneMapping(float32 const& exposure, ToneMappingOperator const& op, float32 const& gamma, bool const& dither)
+            : exposure(exposure)
+            , op(op)
+            , gamma(gamma)
+            , dither(dither)
+        {}
+    };
+
+
+    namespace _detail   // ! user should not use namespace '_detail'
+    {
+        length_t constexpr GAMMA_LUT_SIZE = 4096;
+
+        /// table of 255 * x^(1/gamma) on x = i / GAMMA_LUT_SIZE, with one more entry for interpolation
+        struct GammaLUT final
+        {
+            float32 values[GAMMA_LUT_SIZE + 2];
+
+            explicit GammaLUT(float32 const& gamma)
+            {
+                float64 const inverse_gamma = 1. / gamma;
+                for (length_t i = 0; i <= GAMMA_LUT_SIZE; ++i) {
+                    this->values[i] = static_cast<float32>(255. * pow(static_cast<float64>(i) / GAMMA_LUT_SIZE, inverse_gamma));
+                }
+                this->values[GAMMA_LUT_SIZE + 1] = this->values[GAMMA_LUT_SIZE];
+            }
+        };
+
+        template<ToneMappingOperator OP>
+        float32 inline tone_curve(float32 const& c)
+        {
+            if constexpr (OP == ToneMappingOperator::Reinhard) {
+                return c / (1.f + c);
+            }
+            else if constexpr (OP == ToneMappingOperator::ACES) {
+                return (c * (2.51f * c + 0.03f)) / (c * (2.43f * c + 0.59f) + 0.14f);
+            }
+            else {
+                return c;
+            }
+        }
+
+        /// cheap integer hash to uniform float in [0, 1), used as dither noise
+        float32 inline dither_noise(uint32 const& row, uint32 const& i)
+        {
+            uint32 h = row * 0x9E3779B1u ^ i * 0x85EBCA77u;
+            h ^= h >> 15;
+            h *= 0x2C1B3C6Du;
+            h ^= h >> 12;
+            h *= 0x297A2D39u;
+            h ^= h >> 15;
+            return static_cast<float32>(h >> 8) * (1.f / 16777216.f);
+        }
+
+        /// map count channels in one row, all steps in one loop without any indirect call
+        template<ToneMappingOperator OP, bool DITHER>
+        void tonemap_row(float32 const* in, uint8 * out, length_t const& count, uint32 const& row, float32 const& exposure, GammaLUT const& lut)
+        {
+            for (length_t i = 0; i < count; ++i) {
+                float32 c = tone_curve<OP>(in[i] * exposure);
+                c = (c > 0.f) ? ((c < 1.f) ? c : 1.f) : 0.f;           // also maps NaN to 0
+                float32 const position = c * GAMMA_LUT_SIZE;
+                length_t const index = static_cast<length_t>(position);
+                float32 const fraction = position - index;
+                float32 v = lut.values[index] + fraction * (lut.values[index + 1] - lut.values[index]);
+                if constexpr (DITHER) {
+                    v += dither_noise(row, static_cast<uint32>(i));
+                }
+                else {
+                    v += 0.5f;
+                }
+                out[i] = static_cast<uint8>((v < 255.f) ? v : 255.f);
+            }
+        }
+
+        template<ToneMappingOperator OP>
+        void tonemap_rows(GraphicsBuffer const& gbuff, ImageBuffer & ibuff, length_t const& first_row, length_t const& end_row, ToneMapping const& mapping, GammaLUT const& lut)
+        {
+            static_assert(sizeof(RGBColor) == 3 * sizeof(float32) && sizeof(ImageRGBColor) == 3, "'tonemap_to_image' requires tightly packed colors");
+            length_t const count = 3 * gbuff.width();
+            for (length_t y = first_row; y < end_row; ++y) {
+                float32 const* in = reinterpret_cast<float32 const*>(gbuff.data_pointer() + static_cast<offset_t>(y) * gbuff.width());
+                uint8 * out = reinterpret_cast<uint8 *>(ibuff.data_pointer() + static_cast<offset_t>(y) * ibuff.width());
+                if (mapping.dither) {
+                    tonemap_row<OP, true>(in, out, count, static_cast<uint32>(y), mapping.exposure, lut);
+                }
+                else {
+                    tonemap_row<OP, false>(in, out, count, static_cast<uint32>(y), mapping.exposure, lut);
+                }
+            }
+        }
+
+    } // namespace _detail
+
+
+    /// map floating-point colors to display colors in a single pass over memory: exposure, tone mapping,
+    /// gamma correction (interpolated table) and dithered quantizing. Rows are split between threads.
+    ImageBuffer & tonemap_to_image(GraphicsBuffer const& gbuff, ImageBuffer & ibuff, ToneMapping const& mapping = ToneMapping(), length_t const& num_threads = default_num_threads())
+    {
+        using namespace _detail;
+        assert(gbuff.size() == ibuff.size());
+        if (!gbuff.valid() || !ibuff.valid()) {
+            return ibuff;
+        }
+        GammaLUT const lut(mapping.gamma);
+        length_t constexpr rows_per_job = 16;
+        length_t const num_jobs = (gbuff.height() + rows_per_job - 1) / rows_per_job;
+        parallel_for(num_jobs, num_threads,
+            [&gbuff, &ibuff, &mapping, &lut] (length_t const& job) {
+                length_t const first_row = job * rows_per_job;
+                length_t const end_row = ::std::min(first_row + rows_per_job, gbuff.height());
+                switch (mapping.op) {
+                case ToneMappingOperator::Reinhard:
+                    tonemap_rows<ToneMappingOperator::Reinhard>(gbuff, ibuff, first_row, end_row, mapping, lut);
+                    break;
+                case ToneMappingOperator::ACES:
+                    tonemap_rows<ToneMappingOperator::ACES>(gbuff, ibuff, first_row, end_row, mapping, lut);
+                    break;
+                default:
+                    tonemap_rows<ToneMappingOperator::Clamp>(gbuff, ibuff, first_row, end_row, mapping, lut);
+                    break;
+                }
+            }
+        );
+        return ibuff;
+    }
+
+    ImageBuffer inline tonemap_to_image(GraphicsBuffer const& gbuff, ToneMapping const& mapping = ToneMapping(), length_t const& num_threads = default_num_threads())
+    {
+        ImageBuffer ibuff(gbuff.size());
+        tonemap_to_image(gbuff, ibuff, mapping, num_threads);
+        return ibuff;
+    }
+
+} // namespace nyas
@@ -13,4 +13,50 @@ int main() {
     nyas::example_cameras();
 
     nyas::example_simple_scenes();
+
+    nyas::example_distributed();
+
+    nyas::example_progressive();
+
+    nyas::example_tonemapping();
+
+    nyas::example_buffer_algorithms();
+
+    nyas::example_buffer_layouts();
+
+    nyas::example_mapped_buffer();
+
+    nyas::example_views();
+
+    nyas::example_crop_rendering();
+
+    nyas::example_ray_batch();
+
+    nyas::example_tile_batch();
+
+    nyas::example_accelerators();
+
+    nyas::example_bvh();
+
+    nyas::example_bvh_cache();
+
+    nyas::example_scene_files();
+
+    nyas::example_incremental_rendering();
+
+    nyas::example_bvh_refit();
+
+    nyas::example_ray_sorting();
+
+    nyas::example_animation();
+
+    nyas::example_light_sampling();
+
+    nyas::example_denoise();
+
+    nyas::example_preview();
+
+    nyas::example_time_budget();
+
+    nyas::example_render_profile();
 }
@@ -17,6 +17,9 @@
 #include "utils.hpp"
 
 // buffer 2D
+#include "MappedFile.hpp"
+#include "BufferLayout.hpp"
+#include "Buffer2DView.hpp"
 #include "Buffer2D.hpp"
 
 // sampler
@@ -31,6 +34,8 @@
 
 // ray
 #include "Ray.hpp"
+#include "RayBatch.hpp"
+#include "AABB.hpp"
 
 // camera
 #include "cameras/Camera.hpp"
@@ -51,9 +56,43 @@
 //#include "objects/MultiObject3D.hpp"
 #include "objects/Sphere.hpp"
 
+// accelerator
+#include "accelerators/Accelerator.hpp"
+#include "accelerators/Linear.hpp"
+#include "accelerators/UniformGrid.hpp"
+#include "accelerators/BVH.hpp"
+#include "accelerators/choose.hpp"
+
 // ray tracer
 #include "tracers/RayTracer.hpp"
 #include "tracers/HemisphereModel.hpp"
+#include "tracers/Preview.hpp"
 
 // world
+#include "Tile.hpp"
+#include "AuxiliaryBuffers.hpp"
+#include "RenderProfile.hpp"
 #include "World.hpp"
+
+// animation
+#include "animation/Keyframes.hpp"
+#include "animation/Animation.hpp"
+
+// scene files
+#include "scenes/text.hpp"
+#include "scenes/compiled.hpp"
+
+// images
+#include "images/tonemap.hpp"
+#include "images/SnapshotWriter.hpp"
+#include "images/FrameWriter.hpp"
+#include "images/denoise.hpp"
+#include "images/heatmap.hpp"
+#include "images/deflate.hpp"
+#include "images/pfm.hpp"
+#include "images/exr.hpp"
+
+// distributed rendering
+#include "distributed/protocol.hpp"
+#include "distributed/Worker.hpp"
+#include "distributed/Coordinator.hpp"
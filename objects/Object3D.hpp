@@ -5,8 +5,11 @@
 #include "../common/constants.hpp"
 #include "../samplers/Sampler.hpp"
 #include "../Ray.hpp"
+#include "../AABB.hpp"
 #include "../brdfs/BRDF.hpp"
+#include <atomic>
 #include <memory>
+#include <vector>
 
 
 namespace nyas
@@ -20,6 +23,7 @@ namespace nyas
         Point3D hitting_point;  // where ray hit, i.e., ray.position + t * ray.direction
         Vector3D normal;        // surface normal that ray hit, it should be facing out of surface
         Object3D const* object; // what object ray hit
+        uint32 primitive;       // which part of object ray hit, 0 for objects of one part
 
 
         RayHittingRecord()
@@ -27,24 +31,41 @@ namespace nyas
             , hitting_point(constants<float64>::infinity)
             , normal(0.)
             , object(nullptr)
+            , primitive(0)
         {}
     };
 
 
 
+    /// Object in world. Setters of objects count edits in revisions, so holders of objects (e.g. `World`) find
+    /// edits by comparing revisions with saved ones, instead of being told.
     class Object3D
     {
     public:
         Object3D()
             : _brdf(nullptr)
+            , _emission(0.f)
+            , _revision(0)
+            , _geometry_revision(0)
         {}
         explicit Object3D(BRDFPtr brdf)
             : _brdf(brdf)
+            , _emission(0.f)
+            , _revision(0)
+            , _geometry_revision(0)
         {}
 
         Object3D inline & set_BRDF(BRDFPtr const& brdf)
         {
             _brdf = brdf;
+            this->_changed(false);
+            return *this;
+        }
+        /// set radiance emitted from every point of surface in every direction, black for no light
+        Object3D inline & set_emission(RGBColor const& emission)
+        {
+            this->_emission = emission;
+            this->_changed(false);
             return *this;
         }
         Object3D inline & set_sampler(SamplerPtr const& sampler)
@@ -64,16 +85,113 @@ namespace nyas
         {
             return this->_sampler;
         }
+        RGBColor inline emission() const
+        {
+            return this->_emission;
+        }
+        bool inline emissive() const
+        {
+            return this->_emission != RGBColor(0.f);
+        }
+        /// increased by every edit of this object
+        uint64 inline revision() const
+        {
+            return this->_revision;
+        }
+        /// increased by every edit changing shape or position of this object
+        uint64 inline geometry_revision() const
+        {
+            return this->_geometry_revision;
+        }
+        /// increased by every edit of any object, holders of many objects check it before checking each object
+        uint64 static inline global_revision()
+        {
+            return Object3D::_global_revision.load(::std::memory_order_relaxed);
+        }
+        /// increased by every geometry edit of any object
+        uint64 static inline global_geometry_revision()
+        {
+            return Object3D::_global_geometry_revision.load(::std::memory_order_relaxed);
+        }
+
+        /// closest-hit query, only finds where ray hits. Searches call it on many objects and keep the
+        /// closest result, so it must not compute anything else.
+        ///
+        /// @return true if ray hits object at t in [0, t_max], then t and primitive are written
+        bool virtual intersect(Ray const& ray, float64 const& t_max, float64 & t, uint32 & primitive) const = 0;
+
+        /// fill `hitting_point` and `normal` of rec, whose t and primitive are given by `intersect` of this
+        /// object with the same ray. Called once for the final hit of a search.
+        void virtual interact(Ray const& ray, RayHittingRecord & rec) const = 0;
+
+        /// any-hit query for shadow rays and visibility tests: true if ray hits object at t in [0, t_max].
+        /// Objects made of many primitives override it to stop at the first primitive hit.
+        bool virtual occluded(Ray const& ray, float64 const& t_max) const
+        {
+            float64 t;
+            uint32 primitive;
+            return this->intersect(ray, t_max, t, primitive);
+        }
+
+        /// `intersect` and `interact`, for a hit on this object alone
+        bool inline hit(Ray const& ray, float64 const& t_max, RayHittingRecord & rec) const
+        {
+            if (!this->intersect(ray, t_max, rec.t, rec.primitive)) {
+                return false;
+            }
+            rec.object = this;
+            this->interact(ray, rec);
+            return true;
+        }
+
+        /// box containing whole object, used by accelerators to skip objects away from rays.
+        /// Objects without finite bounds keep this default, they are tested by every ray.
+        AABB virtual bounding_box() const
+        {
+            return AABB::infinite();
+        }
 
-        bool virtual hit(Ray const& ray, float64 const& t_max, RayHittingRecord & rec) const = 0;
+        /// sample a unit direction from point `from` toward this object, for sampling lights. Objects not
+        /// supporting it keep this default, then light from them is only found by scattered rays.
+        ///
+        /// @param sample point in unit-square (range [0, 1]^2)
+        /// @return false if no direction can be sampled, e.g. `from` is inside object
+        bool virtual sample_direction(Point3D const& /*from*/, Point2D const& /*sample*/, Vector3D & /*direction*/) const
+        {
+            return false;
+        }
+        /// density in solid angle of `sample_direction` giving unit direction from point `from`, 0 if it
+        /// never gives the direction
+        float64 virtual direction_pdf(Point3D const& /*from*/, Vector3D const& /*direction*/) const
+        {
+            return 0.;
+        }
 
 
     protected:
+        /// called by setters of derived objects after an edit
+        void inline _changed(bool const& geometry)
+        {
+            ++this->_revision;
+            Object3D::_global_revision.fetch_add(1, ::std::memory_order_relaxed);
+            if (geometry) {
+                ++this->_geometry_revision;
+                Object3D::_global_geometry_revision.fetch_add(1, ::std::memory_order_relaxed);
+            }
+        }
+
+
         BRDFPtr _brdf;
         SamplerPtr _sampler;
+        RGBColor _emission;
+        uint64 _revision;
+        uint64 _geometry_revision;
+        ::std::atomic<uint64> inline static _global_revision = 0;
+        ::std::atomic<uint64> inline static _global_geometry_revision = 0;
     };
 
     typedef shared_ptr<Object3D> Object3DPtr;
     typedef shared_ptr<Object3D const> Object3DConstptr;
+    typedef ::std::vector<Object3DPtr> Object3DList;
 
 } // namespace nyas
@@ -4,6 +4,7 @@
 #include "Object3D.hpp"
 #include "../common/constants.hpp"
 #include "../common/functions.hpp"
+#include <cmath>
 
 
 namespace nyas
@@ -32,11 +33,13 @@ namespace nyas
             Sphere inline & set_radius(float64 const& radius)
             {
                 this->_radius = radius;
+                this->_changed(true);
                 return *this;
             }
             Sphere inline & set_center(Point3D const& center)
             {
                 this->_center = center;
+                this->_changed(true);
                 return *this;
             }
 
@@ -49,7 +52,7 @@ namespace nyas
                 return this->_center;
             }
 
-            bool virtual hit(Ray const& ray, float64 const& t_max, RayHittingRecord & rec) const override
+            bool virtual intersect(Ray const& ray, float64 const& t_max, float64 & t, uint32 & primitive) const override
             {
                 // get time that ray hit sphere using quadratic equation
                 Vector3D const c2o = ray.origin - this->_center;
@@ -60,28 +63,81 @@ namespace nyas
                     return false;
                 }
                 disc = sqrt(disc);
-                float64 t = (-disc - half_b) / a;
-                if (t < 0.) {       // sphere is not in front of ray ?
-                    t = (disc - half_b) / a;
-                    if (t < 0.) {   // is sphere behind ray ?
+                float64 t_hit = (-disc - half_b) / a;
+                if (t_hit < 0.) {   // sphere is not in front of ray ?
+                    t_hit = (disc - half_b) / a;
+                    if (t_hit < 0.) {   // is sphere behind ray ?
                         return false;
                     }
                     // else: ray.origin in sphere
                 }
                 // is not sphere closer to ray.origin than other objects?
-                if (t > t_max) {
+                if (t_hit > t_max) {
                     return false;
                 }
-                // write sphere data into record
-                rec.t = t;
-                rec.hitting_point = ray.at(t);
+                t = t_hit;
+                primitive = 0;
+                return true;
+            }
+
+            void virtual interact(Ray const& ray, RayHittingRecord & rec) const override
+            {
+                rec.hitting_point = ray.at(rec.t);
                 rec.normal = (this->_center - rec.hitting_point) * (1. / this->_radius);
-                rec.object = this;
+            }
+
+            AABB virtual bounding_box() const override
+            {
+                Vector3D const r(::std::abs(this->_radius));
+                return AABB(this->_center - r, this->_center + r);
+            }
+
+            /// directions are uniform in the cone of directions from `from` to sphere
+            bool virtual sample_direction(Point3D const& from, Point2D const& sample, Vector3D & direction) const override
+            {
+                float64 cos_max;
+                Vector3D w;
+                if (!this->_cone(from, cos_max, w)) {
+                    return false;
+                }
+                float64 const cos_theta = 1. - sample.x * (1. - cos_max);
+                float64 const sin_theta = sqrt(::std::max(0., 1. - cos_theta * cos_theta));
+                float64 const phi = constants<float64>::two_pi * sample.y;
+                Vector3D const u = normalize(cross((::std::abs(w.x) > 0.9) ? constants<float64>::axis3D::Y : constants<float64>::axis3D::X, w));
+                Vector3D const v = cross(w, u);
+                direction = (u * cos(phi) + v * sin(phi)) * sin_theta + w * cos_theta;
                 return true;
             }
+            float64 virtual direction_pdf(Point3D const& from, Vector3D const& direction) const override
+            {
+                float64 cos_max;
+                Vector3D w;
+                if (!this->_cone(from, cos_max, w) || dot(direction, w) < cos_max) {
+                    return 0.;
+                }
+                return constants<float64>::one_over_two_pi / (1. - cos_max);
+            }
 
 
         private:
+            /// cone of directions from point to sphere, false if point is inside sphere
+            ///
+            /// @param cos_max cosine of half angle of cone
+            /// @param axis unit direction from point to center
+            bool inline _cone(Point3D const& from, float64 & cos_max, Vector3D & axis) const
+            {
+                Vector3D const to_center = this->_center - from;
+                float64 const distance2 = length2(to_center);
+                float64 const radius2 = this->_radius * this->_radius;
+                if (distance2 <= radius2 * (1. + 1e-9)) {
+                    return false;
+                }
+                cos_max = sqrt(1. - radius2 / distance2);
+                axis = to_center * (1. / sqrt(distance2));
+                return true;
+            }
+
+
             float64 _radius;
             Point3D _center;
         };
@@ -6,6 +6,9 @@
 #include "../common/functions.hpp"
 #include "../common/randoms.hpp"
 #include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
 
 
 namespace nyas
@@ -63,7 +66,7 @@ namespace nyas
         explicit Sampler(SamplesGenerator const& generator)
             : _num_sets(generator.num_sets())
             , _num_samples(generator.num_samples())
-            , _ele_count(0)
+            , _id(Sampler::_next_id++)
             //, _set_count(0)
         {
             assert(generator.num_sets() > 0 && generator.num_samples() > 0);
@@ -74,8 +77,39 @@ namespace nyas
             else {
                 this->_samples = generator.generate_samples();
             }
-            this->_num_total = this->_samples.size();
-            assert(this->_num_sets * this->_num_samples == this->_num_total);
+            this->_init_samples();
+        }
+        /// sampler over given samples, e.g. samples of another sampler stored in a file, so the same
+        /// samples are used without generating them again
+        ///
+        /// @param samples num_sets * num_samples samples, sets one after another
+        explicit Sampler(length_t const& num_sets, length_t const& num_samples, SampleList const& samples)
+            : _num_sets(num_sets)
+            , _num_samples(num_samples)
+            , _id(Sampler::_next_id++)
+            , _samples(samples)
+        {
+            assert(num_sets > 0 && num_samples > 0);
+            this->_init_samples();
+        }
+        /// copy has the same samples but its own cursors
+        Sampler(Sampler const& sampler)
+            : _num_sets(sampler._num_sets)
+            , _num_samples(sampler._num_samples)
+            , _num_total(sampler._num_total)
+            , _id(Sampler::_next_id++)
+            , _samples(sampler._samples)
+            , _in_unit_square(sampler._in_unit_square)
+        {}
+
+        Sampler & operator=(Sampler const& sampler)
+        {
+            this->_num_sets = sampler._num_sets;
+            this->_num_samples = sampler._num_samples;
+            this->_num_total = sampler._num_total;
+            this->_samples = sampler._samples;
+            this->_in_unit_square = sampler._in_unit_square;
+            return *this;
         }
 
         length_t inline num_sets() const
@@ -94,10 +128,29 @@ namespace nyas
         {
             return this->_samples;
         }
+        /// true if all samples are in range [0, 1]^2, then points jittered by samples need no range reduction
+        bool inline samples_in_unit_square() const
+        {
+            return this->_in_unit_square;
+        }
+
+        /// move cursor to a fixed position, samples taken after seeking depend only on the cursor,
+        /// so same cursor always reproduces same sample stream no matter what was sampled before.
+        Sampler inline & seek(uint64 const& cursor)
+        {
+            this->_cursor() = cursor;
+            return *this;
+        }
+
+        /// return the sample at cursor, without moving the cursor
+        Point2D inline sample_at(uint64 const& cursor) const
+        {
+            return this->_samples[cursor % this->_num_total];
+        }
 
         Point2D inline sample_uniform2D()
         {
-            return this->_samples[(this->_ele_count++) % this->_num_total];
+            return this->_samples[(this->_cursor()++) % this->_num_total];
             //if (this->_ele_count % this->_num_samples == 0) {
             //    this->_set_count = (random::integer() % this->_num_sets) * this->_num_samples;
             //}
@@ -106,12 +159,53 @@ namespace nyas
 
 
     private:
+        /// cursors of samplers on one thread by id of sampler, the one used last is looked up without hashing
+        struct _ThreadCursors final
+        {
+            uint64 last_id;     // 0 for none
+            uint64 * last;
+            ::std::unordered_map<uint64, uint64> cursors;
+
+
+            _ThreadCursors()
+                : last_id(0)
+                , last(nullptr)
+                , cursors()
+            {}
+        };
+
+
+        /// cursor of this sampler on this thread. Cursors are kept per thread, so threads can take samples from the
+        /// same sampler, and per sampler, so samplers on the same thread do not move cursors of each other.
+        uint64 inline & _cursor() const
+        {
+            _ThreadCursors & thread = Sampler::_thread_cursors;
+            if (thread.last_id != this->_id) {
+                thread.last = &thread.cursors[this->_id];      // elements of unordered_map never move
+                thread.last_id = this->_id;
+            }
+            return *thread.last;
+        }
+
+        void _init_samples()
+        {
+            this->_num_total = this->_samples.size();
+            assert(this->_num_sets * this->_num_samples == this->_num_total);
+            this->_in_unit_square = ::std::all_of(this->_samples.begin(), this->_samples.end(),
+                [] (Point2D const& p) { return 0. <= p.x && p.x <= 1. && 0. <= p.y && p.y <= 1.; }
+            );
+        }
+
+
         length_t _num_sets;
         length_t _num_samples;
         length_t _num_total;
-        length_t _ele_count;
+        uint64 _id;             // key of cursors, unique in process
         //length_t _set_count;    // randomly selectee sample set
         SampleList _samples;
+        bool _in_unit_square;
+        ::std::atomic<uint64> inline static _next_id = 1;
+        _ThreadCursors inline static thread_local _thread_cursors;
     };
 
     typedef shared_ptr<Sampler> SamplerPtr;
@@ -0,0 +1,366 @@
+/// @file scenes/compiled.hpp
+#pragma once
+
+#include "text.hpp"
+#include "../common/types.hpp"
+#include "../MappedFile.hpp"
+#include "../World.hpp"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace nyas
+{
+    namespace scenes
+    {
+        enum class CameraType : uint32
+        {
+            Pinhole = 1,
+            Parallel = 2
+        };
+        enum class SkyType : uint32
+        {
+            None = 1,
+            Zenith = 2
+        };
+        enum class BRDFType : uint32
+        {
+            Lambertian = 1
+        };
+        enum class ObjectType : uint32
+        {
+            Sphere = 1
+        };
+        enum class TracerType : uint32
+        {
+            Hemisphere = 1
+        };
+
+
+        /// head of compiled scene file, followed by arrays of `CompiledBRDF`, `CompiledObject` and samples of
+        /// sampler at 8-byte aligned offsets. Camera, sky, sampler and tracer are stored in header.
+        struct CompiledSceneHeader final
+        {
+            char magic[8];              // "nyasSCN"
+            uint32 version;
+            uint32 header_size;         // sizeof(CompiledSceneHeader)
+            CameraType camera_type;
+            uint32 figure_width;
+            uint32 figure_height;
+            SkyType sky_type;
+            float64 figure_center[3];
+            float64 figure_u[3];
+            float64 figure_v[3];
+            float64 camera_view[3];     // view point of pinhole, view direction of parallel
+            float32 sky_zenith[3];
+            float32 sky_ambient[3];
+            TracerType tracer_type;
+            uint32 max_steps;
+            uint32 num_sets;
+            uint32 num_samples;         // samples in one set
+            uint32 num_brdfs;
+            uint32 num_objects;
+            uint64 brdfs_offset;
+            uint64 objects_offset;
+            uint64 samples_offset;      // num_sets * num_samples Point2D
+        };
+
+        struct CompiledBRDF final
+        {
+            BRDFType type;
+            float32 diffuse;            // lambertian
+        };
+
+        struct CompiledObject final
+        {
+            ObjectType type;
+            uint32 brdf;                // index of brdf
+            float64 params[4];          // sphere: radius, center
+            float32 emission[3];
+            uint32 reserved;            // 0
+        };
+
+        uint32 constexpr COMPILED_SCENE_VERSION = 1;
+
+
+        namespace _detail
+        {
+            void inline copy_vector(float64 (&to)[3], Vector3D const& from)
+            {
+                to[0] = from.x; to[1] = from.y; to[2] = from.z;
+            }
+            void inline copy_vector(float32 (&to)[3], RGBColor const& from)
+            {
+                to[0] = from.x; to[1] = from.y; to[2] = from.z;
+            }
+            bool inline fail(string * error, string const& message)
+            {
+                if (error != nullptr) {
+                    *error = message;
+                }
+                return false;
+            }
+        } // namespace _detail
+
+
+        /// write world into compiled scene file, which is loaded by `load_compiled_scene` without parsing.
+        /// Samples of sampler are stored, so the loaded world renders the same image as this world.
+        ///
+        /// @param error set if world has types of camera, sky, BRDF, object or tracer not supported by
+        ///              compiled scenes, or file cannot be written. May be nullptr
+        bool compile_scene(World const& world, char const* file_name, string * error = nullptr)
+        {
+            static_assert(sizeof(Point2D) == 2 * sizeof(float64), "compiled scenes require tightly packed Point2D");
+            if (!world.valid()) {
+                return _detail::fail(error, "world is not valid");
+            }
+            CompiledSceneHeader header;
+            ::std::memset(&header, 0, sizeof(header));
+            ::std::memcpy(header.magic, "nyasSCN", 8);
+            header.version = COMPILED_SCENE_VERSION;
+            header.header_size = sizeof(CompiledSceneHeader);
+
+            /* camera */
+            CameraPtr const camera = world.camera();
+            if (auto const pinhole = ::std::dynamic_pointer_cast<cameras::Pinhole>(camera)) {
+                header.camera_type = CameraType::Pinhole;
+                _detail::copy_vector(header.camera_view, pinhole->view_point());
+            }
+            else if (auto const parallel = ::std::dynamic_pointer_cast<cameras::Parallel>(camera)) {
+                header.camera_type = CameraType::Parallel;
+                _detail::copy_vector(header.camera_view, parallel->view_direction());
+            }
+            else {
+                return _detail::fail(error, "camera type is not supported");
+            }
+            header.figure_width = static_cast<uint32>(camera->figure_size().x);
+            header.figure_height = static_cast<uint32>(camera->figure_size().y);
+            _detail::copy_vector(header.figure_center, camera->figure_center());
+            _detail::copy_vector(header.figure_u, camera->figure_direction_u());
+            _detail::copy_vector(header.figure_v, camera->figure_direction_v());
+
+            /* sky */
+            if (::std::dynamic_pointer_cast<skies::NoSky>(world.sky()) != nullptr) {
+                header.sky_type = SkyType::None;
+            }
+            else if (auto const zenith = ::std::dynamic_pointer_cast<skies::Zenith>(world.sky())) {
+                header.sky_type = SkyType::Zenith;
+                _detail::copy_vector(header.sky_zenith, zenith->zenith());
+                _detail::copy_vector(header.sky_ambient, zenith->ambient());
+            }
+            else {
+                return _detail::fail(error, "sky type is not supported");
+            }
+
+            /* tracer */
+            if (auto const hemisphere = ::std::dynamic_pointer_cast<tracers::HemisphereModel>(world.ray_tracer())) {
+                header.tracer_type = TracerType::Hemisphere;
+                header.max_steps = static_cast<uint32>(hemisphere->max_steps());
+            }
+            else {
+                return _detail::fail(error, "ray tracer type is not supported");
+            }
+
+            /* sampler */
+            Sampler const& sampler = *world.sampler();
+            header.num_sets = static_cast<uint32>(sampler.num_sets());
+            header.num_samples = static_cast<uint32>(sampler.num_samples());
+
+            /* objects, shared BRDFs are stored once */
+            ::std::vector<CompiledBRDF> brdfs;
+            ::std::vector<CompiledObject> objects;
+            ::std::unordered_map<BRDF const*, uint32> brdf_indices;
+            objects.reserve(world.objects().size());
+            for (Object3DPtr const& obj : world.objects()) {
+                CompiledObject record;
+                ::std::memset(&record, 0, sizeof(record));
+                auto const found = brdf_indices.find(obj->BRDF().get());
+                if (found != brdf_indices.end()) {
+                    record.brdf = found->second;
+                }
+                else if (auto const lambertian = ::std::dynamic_pointer_cast<BRDFs::Lambertian>(obj->BRDF())) {
+                    record.brdf = static_cast<uint32>(brdfs.size());
+                    brdf_indices[lambertian.get()] = record.brdf;
+                    brdfs.push_back(CompiledBRDF{BRDFType::Lambertian, lambertian->diffuse()});
+                }
+                else {
+                    return _detail::fail(error, "BRDF type is not supported");
+                }
+                if (auto const sphere = dynamic_cast<objects::Sphere const*>(obj.get())) {
+                    record.type = ObjectType::Sphere;
+                    record.params[0] = sphere->radius();
+                    record.params[1] = sphere->center().x;
+                    record.params[2] = sphere->center().y;
+                    record.params[3] = sphere->center().z;
+                }
+                else {
+                    return _detail::fail(error, "object type is not supported");
+                }
+                _detail::copy_vector(record.emission, obj->emission());
+                objects.push_back(record);
+            }
+            header.num_brdfs = static_cast<uint32>(brdfs.size());
+            header.num_objects = static_cast<uint32>(objects.size());
+
+            /* write arrays after header at aligned offsets, into a temporary file renamed at the end */
+            uint64 constexpr ALIGNMENT = 8;
+            auto const align = [&ALIGNMENT] (uint64 const& offset) { return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; };
+            header.brdfs_offset = align(sizeof(CompiledSceneHeader));
+            header.objects_offset = align(header.brdfs_offset + brdfs.size() * sizeof(CompiledBRDF));
+            header.samples_offset = align(header.objects_offset + objects.size() * sizeof(CompiledObject));
+
+            string const temporary = string(file_name) + ".tmp";
+            ::std::FILE * file = ::std::fopen(temporary.c_str(), "wb");
+            if (file == nullptr) {
+                return _detail::fail(error, "cannot open '" + temporary + "'");
+            }
+            uint64 written = 0;
+            auto const put = [&file, &written] (void const* data, uint64 const& offset, uint64 const& size) {
+                uint8 const zeros[ALIGNMENT] = {0};
+                bool good = ::std::fwrite(zeros, 1, offset - written, file) == offset - written;
+                good = good && (size == 0 || ::std::fwrite(data, 1, size, file) == size);
+                written = offset + size;
+                return good;
+            };
+            bool good = put(&header, 0, sizeof(header));
+            good = good && put(brdfs.data(), header.brdfs_offset, brdfs.size() * sizeof(CompiledBRDF));
+            good = good && put(objects.data(), header.objects_offset, objects.size() * sizeof(CompiledObject));
+            good = good && put(sampler.samples().data(), header.samples_offset, sampler.samples().size() * sizeof(Point2D));
+            good = (::std::fclose(file) == 0) && good;
+            if (good) {
+                ::std::remove(file_name);
+                good = ::std::rename(temporary.c_str(), file_name) == 0;
+            }
+            if (!good) {
+                ::std::remove(temporary.c_str());
+                return _detail::fail(error, "cannot write '" + string(file_name) + "'");
+            }
+            return true;
+        }
+        bool inline compile_scene(World const& world, string const& str, string * error = nullptr)
+        {
+            return compile_scene(world, str.c_str(), error);
+        }
+
+
+        namespace _detail
+        {
+            /// build world from mapped compiled scene file, see `load_compiled_scene`
+            WorldPtr load_compiled_scene(MappedFile const& file, char const* file_name, string * error)
+            {
+                if (!file.valid() || file.size() < sizeof(CompiledSceneHeader)) {
+                    _detail::fail(error, "cannot map '" + string(file_name) + "' or file is too small");
+                    return nullptr;
+                }
+                CompiledSceneHeader header;
+                ::std::memcpy(&header, file.data(), sizeof(header));
+                auto const fits = [&file] (uint64 const& offset, uint64 const& size, uint64 const& alignment) {
+                    return offset % alignment == 0 && offset <= file.size() && size <= file.size() - offset;
+                };
+                uint64 const num_total = uint64(header.num_sets) * header.num_samples;
+                if (::std::memcmp(header.magic, "nyasSCN", 8) != 0 || header.version != COMPILED_SCENE_VERSION
+                    || header.header_size != sizeof(CompiledSceneHeader)
+                    || !fits(header.brdfs_offset, uint64(header.num_brdfs) * sizeof(CompiledBRDF), alignof(CompiledBRDF))
+                    || !fits(header.objects_offset, uint64(header.num_objects) * sizeof(CompiledObject), alignof(CompiledObject))
+                    || !fits(header.samples_offset, num_total * sizeof(Point2D), alignof(Point2D))
+                    || header.figure_width == 0 || header.figure_height == 0 || num_total == 0 || header.max_steps == 0) {
+                    _detail::fail(error, "'" + string(file_name) + "' is not a compiled scene of version " + ::std::to_string(COMPILED_SCENE_VERSION));
+                    return nullptr;
+                }
+                uint8 const* const base = static_cast<uint8 const*>(file.data());
+                CompiledBRDF const* const brdf_records = reinterpret_cast<CompiledBRDF const*>(base + header.brdfs_offset);
+                CompiledObject const* const object_records = reinterpret_cast<CompiledObject const*>(base + header.objects_offset);
+                Point2D const* const samples = reinterpret_cast<Point2D const*>(base + header.samples_offset);
+                auto const vector = [] (float64 const (&v)[3]) { return Vector3D(v[0], v[1], v[2]); };
+                auto const color = [] (float32 const (&c)[3]) { return RGBColor(c[0], c[1], c[2]); };
+
+                ::std::vector<BRDFPtr> brdfs(header.num_brdfs);
+                for (uint32 i = 0; i < header.num_brdfs; ++i) {
+                    if (brdf_records[i].type != BRDFType::Lambertian) {
+                        _detail::fail(error, "unknown BRDF type in '" + string(file_name) + "'");
+                        return nullptr;
+                    }
+                    brdfs[i] = make_shared<BRDFs::Lambertian>(brdf_records[i].diffuse);
+                }
+
+                WorldPtr const world = make_shared<World>();
+                if (header.sky_type == SkyType::None) {
+                    world->set_sky(make_shared<skies::NoSky>());
+                }
+                else if (header.sky_type == SkyType::Zenith) {
+                    world->set_sky(make_shared<skies::Zenith>(color(header.sky_zenith), color(header.sky_ambient)));
+                }
+                world->objects().reserve(header.num_objects);
+                for (uint32 i = 0; i < header.num_objects; ++i) {
+                    CompiledObject const& record = object_records[i];
+                    if (record.type != ObjectType::Sphere || record.brdf >= header.num_brdfs) {
+                        _detail::fail(error, "unknown object type or BRDF in '" + string(file_name) + "'");
+                        return nullptr;
+                    }
+                    objects::SpherePtr const sphere = make_shared<objects::Sphere>(brdfs[record.brdf], record.params[0], Point3D(record.params[1], record.params[2], record.params[3]));
+                    sphere->set_emission(color(record.emission));
+                    world->add_object(sphere);
+                }
+
+                Length2D const figure_size(header.figure_width, header.figure_height);
+                if (header.camera_type == CameraType::Pinhole) {
+                    cameras::PinholePtr const pinhole = make_shared<cameras::Pinhole>(figure_size);
+                    pinhole->set_view_point(vector(header.camera_view));
+                    world->set_camera(pinhole);
+                }
+                else if (header.camera_type == CameraType::Parallel) {
+                    cameras::ParallelPtr const parallel = make_shared<cameras::Parallel>(figure_size);
+                    parallel->set_view_direction(vector(header.camera_view));
+                    world->set_camera(parallel);
+                }
+                if (world->camera() == nullptr || world->sky() == nullptr || header.tracer_type != TracerType::Hemisphere) {
+                    _detail::fail(error, "unknown camera, sky or tracer type in '" + string(file_name) + "'");
+                    return nullptr;
+                }
+                world->camera()->set_figure_center(vector(header.figure_center));
+                world->camera()->set_figure_directions(vector(header.figure_u), vector(header.figure_v));
+
+                world->set_sampler(make_shared<Sampler>(header.num_sets, header.num_samples, SampleList(samples, samples + num_total)));
+                world->set_ray_tracer(make_shared<tracers::HemisphereModel>(header.max_steps));
+                return world;
+            }
+
+        } // namespace _detail
+
+
+        /// build world from compiled scene file by mapping it, records are read in place without parsing.
+        /// Header and ranges of arrays are checked, records themselves are trusted.
+        ///
+        /// @param error set if file is missing or not a compiled scene of this version, may be nullptr
+        /// @return nullptr if file cannot be used
+        WorldPtr load_compiled_scene(char const* file_name, string * error = nullptr)
+        {
+            return _detail::load_compiled_scene(MappedFile(file_name, MapMode::Read), file_name, error);
+        }
+        WorldPtr inline load_compiled_scene(string const& str, string * error = nullptr)
+        {
+            return load_compiled_scene(str.c_str(), error);
+        }
+
+        /// load compiled scene or scene text, decided by the beginning of file. File is mapped once, and
+        /// a compiled scene is read from the same mapping.
+        WorldPtr load_scene(char const* file_name, string * error = nullptr)
+        {
+            MappedFile file(file_name, MapMode::Read);
+            if (file.valid() && file.size() >= 8 && ::std::memcmp(file.data(), "nyasSCN", 8) == 0) {
+                return _detail::load_compiled_scene(file, file_name, error);
+            }
+            file = MappedFile();     // release mapping before reading text
+            return read_scene_text(file_name, error);
+        }
+        WorldPtr inline load_scene(string const& str, string * error = nullptr)
+        {
+            return load_scene(str.c_str(), error);
+        }
+
+    } // namespace scenes
+
+} // namespace nyas
@@ -0,0 +1,334 @@
+/// @file scenes/text.hpp
+#pragma once
+
+#include "../common/types.hpp"
+#include "../common/constants.hpp"
+#include "../samplers/Regular.hpp"
+#include "../samplers/PureRandom.hpp"
+#include "../samplers/Jittered.hpp"
+#include "../samplers/NRooks.hpp"
+#include "../samplers/MultiJittered.hpp"
+#include "../samplers/Hammersley.hpp"
+#include "../samplers/Sampler.hpp"
+#include "../cameras/Pinhole.hpp"
+#include "../cameras/Parallel.hpp"
+#include "../skies/NoSky.hpp"
+#include "../skies/Zenith.hpp"
+#include "../brdfs/Lambertian.hpp"
+#include "../objects/Sphere.hpp"
+#include "../tracers/HemisphereModel.hpp"
+#include "../World.hpp"
+#include <cctype>
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+
+/*
+Scene text, one statement on one line, words are separated by spaces, '#' starts a comment till end of line.
+Vectors and colors are written as 3 numbers.
+
+    camera pinhole <width> <height> <view point> <view direction> <fov in degrees> [<view up>]
+    camera parallel <width> <height> <figure width in space> <figure center> <view direction> [<view up>]
+    sampler regular|hammersley <samples>
+    sampler pure_random|jittered|n_rooks|multi_jittered <sets> <samples>
+    sky none
+    sky zenith <zenith color> <ambient color>
+    brdf <name> lambertian <diffuse>
+    sphere <brdf name> <radius> <center> [emission <color>]
+    tracer hemisphere <max steps>
+
+BRDFs must be defined before objects using them. camera, sampler and tracer are required, sky is none by
+default. Statements may be in any other order, the last one wins for camera, sampler, sky and tracer.
+*/
+
+
+namespace nyas
+{
+    namespace scenes
+    {
+        namespace _detail
+        {
+            /// words of one statement, numbers are parsed without locale
+            class Words final
+            {
+            public:
+                explicit Words(::std::string_view const& line)
+                    : _rest(line)
+                {}
+
+                /// next word, empty at the end of line
+                ::std::string_view next()
+                {
+                    length_t begin = 0;
+                    while (begin < static_cast<length_t>(this->_rest.size()) && ::std::isspace(static_cast<unsigned char>(this->_rest[begin]))) {
+                        ++begin;
+                    }
+                    length_t end = begin;
+                    while (end < static_cast<length_t>(this->_rest.size()) && !::std::isspace(static_cast<unsigned char>(this->_rest[end]))) {
+                        ++end;
+                    }
+                    ::std::string_view const word = this->_rest.substr(begin, end - begin);
+                    this->_rest.remove_prefix(end);
+                    return word;
+                }
+                /// true if no word is left, words are not consumed
+                bool inline finished() const
+                {
+                    return Words(this->_rest).next().empty();
+                }
+
+                template<typename T>
+                bool read(T & value)
+                {
+                    ::std::string_view const word = this->next();
+                    ::std::from_chars_result const result = ::std::from_chars(word.data(), word.data() + word.size(), value);
+                    return !word.empty() && result.ec == ::std::errc() && result.ptr == word.data() + word.size();
+                }
+                template<typename T>
+                bool read(vec<3, T> & v)
+                {
+                    return this->read(v.x) && this->read(v.y) && this->read(v.z);
+                }
+
+
+            private:
+                ::std::string_view _rest;
+            };
+
+            /// parts of world in parsing, they are put into world at the end, when their order is known
+            struct SceneParts final
+            {
+                CameraPtr camera;
+                SamplerPtr sampler;
+                SkyPtr sky;
+                RayTracerPtr tracer;
+                ::std::unordered_map<string, BRDFPtr> brdfs;
+                Object3DList objects;
+            };
+
+            /// parse one statement into parts, return error message or empty string
+            string parse_statement(Words & words, SceneParts & parts)
+            {
+                ::std::string_view const keyword = words.next();
+                if (keyword.empty()) {
+                    return "";
+                }
+
+                if (keyword == "camera") {
+                    ::std::string_view const type = words.next();
+                    Length2D size;
+                    if (!words.read(size.x) || !words.read(size.y) || size.x <= 0 || size.y <= 0) {
+                        return "camera needs positive figure width and height";
+                    }
+                    Vector3D view_up = Camera::DEFAULT_VIEW_UP;
+                    if (type == "pinhole") {
+                        Point3D view_point;
+                        Vector3D view_direction;
+                        float64 fov;
+                        if (!words.read(view_point) || !words.read(view_direction) || !words.read(fov)) {
+                            return "usage: camera pinhole <width> <height> <view point> <view direction> <fov in degrees> [<view up>]";
+                        }
+                        if ((!words.finished() && !words.read(view_up)) || !words.finished()) {
+                            return "view up of camera needs 3 numbers";
+                        }
+                        parts.camera = cameras::default_pinhole(size, view_point, view_direction, fov * constants<float64>::pi / 180., view_up);
+                    }
+                    else if (type == "parallel") {
+                        float64 width;
+                        Point3D figure_center;
+                        Vector3D view_direction;
+                        if (!words.read(width) || !words.read(figure_center) || !words.read(view_direction)) {
+                            return "usage: camera parallel <width> <height> <figure width in space> <figure center> <view direction> [<view up>]";
+                        }
+                        if ((!words.finished() && !words.read(view_up)) || !words.finished()) {
+                            return "view up of camera needs 3 numbers";
+                        }
+                        parts.camera = cameras::default_parallel(size, width, figure_center, view_direction, view_up);
+                    }
+                    else {
+                        return "unknown camera '" + string(type) + "', expect pinhole or parallel";
+                    }
+                    return parts.camera->valid() ? "" : "camera has zero view direction or figure directions";
+                }
+
+                if (keyword == "sampler") {
+                    ::std::string_view const type = words.next();
+                    length_t num_sets = 1, num_samples = 0;
+                    bool const one_set = (type == "regular" || type == "hammersley");
+                    if ((!one_set && !words.read(num_sets)) || !words.read(num_samples) || !words.finished() || num_sets <= 0 || num_samples <= 0) {
+                        return one_set ? "usage: sampler " + string(type) + " <samples>" : "usage: sampler <type> <sets> <samples>, sets and samples are positive";
+                    }
+                    if (type == "regular") {
+                        parts.sampler = make_shared<Sampler>(samples_generators::Regular(num_samples));
+                    }
+                    else if (type == "hammersley") {
+                        parts.sampler = make_shared<Sampler>(samples_generators::Hammersley(num_samples));
+                    }
+                    else if (type == "pure_random") {
+                        parts.sampler = make_shared<Sampler>(samples_generators::PureRandom(num_sets, num_samples));
+                    }
+                    else if (type == "jittered") {
+                        parts.sampler = make_shared<Sampler>(samples_generators::Jittered(num_sets, num_samples));
+                    }
+                    else if (type == "n_rooks") {
+                        parts.sampler = make_shared<Sampler>(samples_generators::NRooks(num_sets, num_samples));
+                    }
+                    else if (type == "multi_jittered") {
+                        parts.sampler = make_shared<Sampler>(samples_generators::MultiJittered(num_sets, num_samples));
+                    }
+                    else {
+                        return "unknown sampler '" + string(type) + "'";
+                    }
+                    return "";
+                }
+
+                if (keyword == "sky") {
+                    ::std::string_view const type = words.next();
+                    if (type == "none") {
+                        if (!words.finished()) {
+                            return "usage: sky none";
+                        }
+                        parts.sky = make_shared<skies::NoSky>();
+                    }
+                    else if (type == "zenith") {
+                        RGBColor zenith, ambient;
+                        if (!words.read(zenith) || !words.read(ambient) || !words.finished()) {
+                            return "usage: sky zenith <zenith color> <ambient color>";
+                        }
+                        parts.sky = make_shared<skies::Zenith>(zenith, ambient);
+                    }
+                    else {
+                        return "unknown sky '" + string(type) + "', expect none or zenith";
+                    }
+                    return "";
+                }
+
+                if (keyword == "brdf") {
+                    string const name(words.next());
+                    ::std::string_view const type = words.next();
+                    if (name.empty()) {
+                        return "usage: brdf <name> <type> ...";
+                    }
+                    if (parts.brdfs.count(name) != 0) {
+                        return "brdf '" + name + "' is already defined";
+                    }
+                    if (type == "lambertian") {
+                        float32 diffuse;
+                        if (!words.read(diffuse) || !words.finished()) {
+                            return "usage: brdf <name> lambertian <diffuse>";
+                        }
+                        parts.brdfs[name] = make_shared<BRDFs::Lambertian>(diffuse);
+                    }
+                    else {
+                        return "unknown brdf type '" + string(type) + "', expect lambertian";
+                    }
+                    return "";
+                }
+
+                if (keyword == "sphere") {
+                    string const name(words.next());
+                    float64 radius;
+                    Point3D center;
+                    RGBColor emission(0.f);
+                    if (!words.read(radius) || !words.read(center)
+                        || (!words.finished() && (words.next() != "emission" || !words.read(emission))) || !words.finished()) {
+                        return "usage: sphere <brdf name> <radius> <center> [emission <color>]";
+                    }
+                    auto const brdf = parts.brdfs.find(name);
+                    if (brdf == parts.brdfs.end()) {
+                        return "brdf '" + name + "' is not defined";
+                    }
+                    objects::SpherePtr const sphere = make_shared<objects::Sphere>(brdf->second, radius, center);
+                    sphere->set_emission(emission);
+                    parts.objects.push_back(sphere);
+                    return "";
+                }
+
+                if (keyword == "tracer") {
+                    ::std::string_view const type = words.next();
+                    length_t max_steps;
+                    if (type != "hemisphere") {
+                        return "unknown tracer '" + string(type) + "', expect hemisphere";
+                    }
+                    if (!words.read(max_steps) || max_steps <= 0 || !words.finished()) {
+                        return "usage: tracer hemisphere <max steps>";
+                    }
+                    parts.tracer = make_shared<tracers::HemisphereModel>(max_steps);
+                    return "";
+                }
+
+                return "unknown statement '" + string(keyword) + "'";
+            }
+
+        } // namespace _detail
+
+
+        /// build world from scene text, see the top of this file for the format
+        ///
+        /// @param error set to "line <n>: <message>" if text is invalid, may be nullptr
+        /// @return nullptr if text is invalid
+        WorldPtr parse_scene(::std::string_view const& text, string * error = nullptr)
+        {
+            _detail::SceneParts parts;
+            length_t line_number = 0;
+            ::std::string_view rest = text;
+            while (!rest.empty()) {
+                ++line_number;
+                ::std::size_t const line_end = rest.find('\n');
+                ::std::string_view line = rest.substr(0, line_end);
+                rest.remove_prefix((line_end == ::std::string_view::npos) ? rest.size() : line_end + 1);
+                line = line.substr(0, line.find('#'));
+                _detail::Words words(line);
+                string const message = _detail::parse_statement(words, parts);
+                if (!message.empty()) {
+                    if (error != nullptr) {
+                        *error = "line " + ::std::to_string(line_number) + ": " + message;
+                    }
+                    return nullptr;
+                }
+            }
+            string const missing = (parts.camera == nullptr) ? "camera" : (parts.sampler == nullptr) ? "sampler" : (parts.tracer == nullptr) ? "tracer" : "";
+            if (!missing.empty()) {
+                if (error != nullptr) {
+                    *error = "scene has no " + missing;
+                }
+                return nullptr;
+            }
+
+            /* objects and camera are needed before sampler, sampler is given to them */
+            WorldPtr const world = make_shared<World>();
+            world->set_sky((parts.sky != nullptr) ? parts.sky : make_shared<skies::NoSky>());
+            for (Object3DPtr const& obj : parts.objects) {
+                world->add_object(obj);
+            }
+            world->set_camera(parts.camera);
+            world->set_sampler(parts.sampler);
+            world->set_ray_tracer(parts.tracer);
+            return world;
+        }
+
+        /// read scene text file and build world, see `parse_scene`
+        WorldPtr read_scene_text(char const* file_name, string * error = nullptr)
+        {
+            ::std::ifstream infile(file_name, ::std::ios::in | ::std::ios::binary);
+            if (!infile) {
+                if (error != nullptr) {
+                    *error = "cannot open '" + string(file_name) + "'";
+                }
+                return nullptr;
+            }
+            string const text((::std::istreambuf_iterator<char>(infile)), ::std::istreambuf_iterator<char>());
+            return parse_scene(text, error);
+        }
+        WorldPtr inline read_scene_text(string const& str, string * error = nullptr)
+        {
+            return read_scene_text(str.c_str(), error);
+        }
+
+    } // namespace scenes
+
+} // namespace nyas
@@ -6,6 +6,9 @@
 #include "../common/functions.hpp"
 #include "../brdfs/BRDF.hpp"
 #include "../objects/Object3D.hpp"
+#include "../RayBatch.hpp"
+#include <algorithm>
+#include <vector>
 #include "iostream"
 
 
@@ -13,49 +16,241 @@ namespace nyas
 {
     namespace tracers
     {
+        /// Path tracer scattering rays by BRDFs. Light of emissive objects is found both by scattered rays and,
+        /// if light sampling is on, by shadow rays toward a sampled light on each bounce (next event estimation).
+        /// The two estimates are combined by multiple importance sampling with power heuristic, which changes
+        /// noise but not the expected color: scenes converge to the same image with or without light sampling.
+        /// Scenes without emissive objects take no light samples and render the same as before.
         class HemisphereModel final : public RayTracer
         {
         public:
             HemisphereModel()
                 : RayTracer()
+                , _ray_sorting(false)
+                , _light_sampling(true)
             {}
             explicit HemisphereModel(length_t const& max_steps)
                 : RayTracer(max_steps)
+                , _ray_sorting(false)
+                , _light_sampling(true)
             {}
             explicit HemisphereModel(length_t const& max_steps, World const* const& world)
                 : RayTracer(max_steps, world)
+                , _ray_sorting(false)
+                , _light_sampling(true)
             {}
 
+            /// trace batches bounce by bounce in `trace_rays` and reorder bounce rays by `coherent_order` before
+            /// each bounce, off by default. It pays off on scenes whose accelerator does not fit in cache, see
+            /// example `example_ray_sorting`. Off, batches are traced path by path by `trace_ray`.
+            HemisphereModel inline & set_ray_sorting(bool const& sorting)
+            {
+                this->_ray_sorting = sorting;
+                return *this;
+            }
+            bool inline ray_sorting() const
+            {
+                return this->_ray_sorting;
+            }
+            /// sample a light on each bounce, on by default. Each bounce takes one more sample when world has lights.
+            HemisphereModel inline & set_light_sampling(bool const& sampling)
+            {
+                this->_light_sampling = sampling;
+                return *this;
+            }
+            bool inline light_sampling() const
+            {
+                return this->_light_sampling;
+            }
+
             RGBColor virtual trace_ray(Ray const& ray) const override
             {
-                return this->_trace_ray_step(ray, this->_max_steps);
+                return this->_trace_ray_step(ray, this->_max_steps, 0.);
+            }
+
+            /// with ray sorting, trace rays bounce by bounce: all alive paths are sorted and intersected, then their
+            /// bounce rays are collected and traced in the next round. Each path takes the same samples as
+            /// `trace_ray`, so colors only differ by rounding of multiplying weights forward instead of backward.
+            void virtual trace_rays(RayBatch const& rays, uint64 const* cursors, RGBColor * colors) const override
+            {
+                if (!this->_ray_sorting) {
+                    // unsorted bounce rays are no more coherent than whole paths, and paths keep their state in registers
+                    RayTracer::trace_rays(rays, cursors, colors);
+                    return;
+                }
+                length_t const size = rays.size();
+                ::std::fill(colors, colors + size, constants<float32>::axis3D::O);
+                _Paths paths, next;
+                paths.rays = rays;
+                paths.resize(size);
+                for (length_t i = 0; i < size; ++i) {
+                    paths.slots[i] = i;
+                    paths.weights[i] = RGBColor(1.f);
+                    paths.cursors[i] = cursors[i] + 1;
+                    paths.pdfs[i] = 0.;
+                }
+                bool const sample_lights = this->_light_sampling && !this->_world->lights().empty();
+
+                ::std::vector<length_t> order;
+                for (length_t step = this->_max_steps; step > 0 && paths.size() > 0; --step) {
+                    coherent_order(paths.rays, order);
+                    next.gather(paths, order);
+                    ::std::swap(paths, next);
+                    next.resize(paths.size());
+                    length_t num_alive = 0;
+                    for (length_t i = 0; i < paths.size(); ++i) {
+                        Ray const ray = paths.rays.ray(i);
+                        RayHittingRecord rec;
+                        if (this->_world->hit(ray, rec.t, rec)) {
+                            BRDF const& brdf = *rec.object->BRDF();
+                            Vector3D normal = (dot(rec.normal, ray.direction) < 0) ? rec.normal : -rec.normal;
+                            Ray scattered_ray(HemisphereModel::_leave_surface(rec.hitting_point, normal), brdf.scatter(normal, ray.direction, brdf.sampler()->sample_at(paths.cursors[i])));
+                            RGBColor & color = colors[paths.slots[i]];
+                            if (rec.object->emissive()) {
+                                color += paths.weights[i] * this->_emitted(ray, *rec.object, paths.pdfs[i]);
+                            }
+                            next.cursors[num_alive] = paths.cursors[i] + 1;
+                            next.pdfs[num_alive] = 0.;
+                            if (sample_lights && step > 1) {
+                                color += paths.weights[i] * this->_sample_light(rec, normal, ray.direction, brdf, brdf.sampler()->sample_at(paths.cursors[i] + 1));
+                                next.cursors[num_alive] = paths.cursors[i] + 2;
+                                next.pdfs[num_alive] = brdf.pdf(normal, scattered_ray.direction);
+                            }
+                            next.rays.set_ray(num_alive, scattered_ray);
+                            next.slots[num_alive] = paths.slots[i];
+                            next.weights[num_alive] = paths.weights[i] * (
+                                brdf(normal, ray.direction, scattered_ray.direction) *
+                                static_cast<float32>(dot(normal, scattered_ray.direction)));
+                            ++num_alive;
+                        }
+                        else {
+                            colors[paths.slots[i]] += paths.weights[i] * this->_world->sky()->get_color(ray.direction);
+                        }
+                    }
+                    next.resize(num_alive);
+                    ::std::swap(paths, next);
+                }
+                // paths still alive after the last step get black, same as `trace_ray`
             }
 
 
         private:
-            RGBColor _trace_ray_step(Ray const& ray, length_t const& step) const
+            /// state of paths in `trace_rays`
+            struct _Paths final
+            {
+                RayBatch rays;
+                ::std::vector<length_t> slots;      // index of color
+                ::std::vector<RGBColor> weights;    // product of brdf and cosine on all bounces
+                ::std::vector<uint64> cursors;      // sampler cursor of next bounce
+                ::std::vector<float64> pdfs;        // density of BRDF scattering ray, 0 if light was not sampled for it
+
+                length_t inline size() const
+                {
+                    return this->rays.size();
+                }
+                void resize(length_t const& size)
+                {
+                    this->rays.resize(size);
+                    this->slots.resize(size);
+                    this->weights.resize(size);
+                    this->cursors.resize(size);
+                    this->pdfs.resize(size);
+                }
+                void gather(_Paths const& from, ::std::vector<length_t> const& order)
+                {
+                    this->rays.gather(from.rays, order);
+                    this->resize(static_cast<length_t>(order.size()));
+                    for (length_t i = 0; i < this->size(); ++i) {
+                        this->slots[i] = from.slots[order[i]];
+                        this->weights[i] = from.weights[order[i]];
+                        this->cursors[i] = from.cursors[order[i]];
+                        this->pdfs[i] = from.pdfs[order[i]];
+                    }
+                }
+            };
+
+
+            /// @param scatter_pdf density of BRDF scattering ray on the last bounce, 0 if light was not sampled there
+            RGBColor _trace_ray_step(Ray const& ray, length_t const& step, float64 const& scatter_pdf) const
             {
                 if (step <= 0) {
                     return constants<float32>::axis3D::O;
                 }
                 RayHittingRecord rec;
-                bool hit_anything = false;
-                for (Object3DConstptr const& obj : this->_world->objects()) {
-                    hit_anything |= obj->hit(ray, rec.t, rec);
-                }
-                if (hit_anything) {
+                if (this->_world->hit(ray, rec.t, rec)) {
                     BRDF const& brdf = *rec.object->BRDF();
                     Vector3D normal = (dot(rec.normal, ray.direction) < 0) ? rec.normal : -rec.normal;
-                    Ray scattered_ray(rec.hitting_point, brdf.scatter(normal, ray.direction));
-                    return
-                        //TODO: rec.object->light +
+                    Ray scattered_ray(HemisphereModel::_leave_surface(rec.hitting_point, normal), brdf.scatter(normal, ray.direction));
+                    RGBColor color = rec.object->emissive() ? this->_emitted(ray, *rec.object, scatter_pdf) : constants<float32>::axis3D::O;
+                    float64 next_pdf = 0.;
+                    // light reached by a shadow ray here is reached by scattered ray only if it has a step left
+                    if (this->_light_sampling && step > 1 && !this->_world->lights().empty()) {
+                        color += this->_sample_light(rec, normal, ray.direction, brdf, brdf.sampler()->sample_uniform2D());
+                        next_pdf = brdf.pdf(normal, scattered_ray.direction);
+                    }
+                    return color +
                             (//TODO: rec.object->texture *
                             brdf(normal, ray.direction, scattered_ray.direction) *
                             static_cast<float32>(dot(normal, scattered_ray.direction))) *
-                            this->_trace_ray_step(scattered_ray, step - 1);
+                            this->_trace_ray_step(scattered_ray, step - 1, next_pdf);
                 }
                 return this->_world->sky()->get_color(ray.direction);
             }
+
+            /// emission of object hit by ray, weighted against sampling the same light from origin of ray
+            RGBColor _emitted(Ray const& ray, Object3D const& obj, float64 const& scatter_pdf) const
+            {
+                if (scatter_pdf <= 0.) {
+                    return obj.emission();
+                }
+                float64 const light_pdf = obj.direction_pdf(ray.origin, normalize(ray.direction)) / this->_world->lights().size();
+                return obj.emission() * static_cast<float32>(HemisphereModel::_power_heuristic(scatter_pdf, light_pdf));
+            }
+
+            /// light from a light chosen uniformly and a direction sampled toward it, if not shadowed
+            ///
+            /// The estimate matches the one of a scattered ray, `brdf * cos` per unit `BRDF::pdf`, so weight of
+            /// a light direction is `brdf * cos * BRDF::pdf / light pdf`.
+            RGBColor _sample_light(RayHittingRecord const& rec, Vector3D const& normal, Vector3D const& incident, BRDF const& brdf, Point2D const& sample) const
+            {
+                Object3DList const& lights = this->_world->lights();
+                length_t const num_lights = static_cast<length_t>(lights.size());
+                length_t const index = ::std::min(static_cast<length_t>(sample.x * num_lights), num_lights - 1);
+                Object3D const& light = *lights[index];
+                Vector3D direction;
+                if (!light.sample_direction(rec.hitting_point, Point2D(sample.x * num_lights - index, sample.y), direction)) {
+                    return constants<float32>::axis3D::O;
+                }
+                float64 const cos = dot(normal, direction);
+                float64 const light_pdf = light.direction_pdf(rec.hitting_point, direction) / num_lights;
+                if (cos <= 0. || light_pdf <= 0.) {
+                    return constants<float32>::axis3D::O;
+                }
+
+                // light is visible if nothing is hit before it
+                Ray const shadow_ray(HemisphereModel::_leave_surface(rec.hitting_point, normal), direction);
+                float64 t_light;
+                uint32 primitive;
+                if (!light.intersect(shadow_ray, constants<float64>::infinity, t_light, primitive)
+                    || this->_world->occluded(shadow_ray, t_light * (1. - HemisphereModel::SHADOW_MARGIN))) {
+                    return constants<float32>::axis3D::O;
+                }
+                float64 const scatter_pdf = brdf.pdf(normal, direction);
+                float64 const weight = HemisphereModel::_power_heuristic(light_pdf, scatter_pdf) * cos * scatter_pdf / light_pdf;
+                return light.emission() * (brdf(normal, incident, direction) * static_cast<float32>(weight));
+            }
+
+            float64 inline static _power_heuristic(float64 const& pdf, float64 const& other_pdf)
+            {
+                return pdf * pdf / (pdf * pdf + other_pdf * other_pdf);
+            }
+
+
+            float64 constexpr static SHADOW_MARGIN = 1e-9;     // relative to distance of light, so light does not shadow itself
+
+
+            bool _ray_sorting;
+            bool _light_sampling;
         };
 
         typedef shared_ptr<HemisphereModel> HemisphereModelPtr;
@@ -0,0 +1,136 @@
+/// @file tracers/Preview.hpp
+#pragma once
+
+#include "RayTracer.hpp"
+#include "../common/constants.hpp"
+#include "../common/functions.hpp"
+#include "../brdfs/BRDF.hpp"
+#include "../objects/Object3D.hpp"
+#include "../samplers/Sampler.hpp"
+#include <assert.h>
+#include <cmath>
+
+
+namespace nyas
+{
+    namespace tracers
+    {
+        /// what `Preview` shows on first hits of camera rays
+        enum class PreviewMode
+        {
+            AmbientOcclusion,   // fraction of cosine-weighted directions not blocked within occlusion distance
+            Albedo,             // `BRDF::albedo` plus emission of lights, sky color on misses
+            Normal              // normal facing camera, mapped from [-1, 1] to [0, 1]
+        };
+
+
+        /// Fast tracer for checking composition of scenes, it only looks at first hits and never scatters.
+        /// Occlusion rays are any-hit queries (`World::occluded`), so ambient occlusion stops at the first blocker
+        /// and is cheap even for many rays per hit.
+        class Preview final : public RayTracer
+        {
+        public:
+            length_t static constexpr DEFAULT_OCCLUSION_RAYS = 4;
+            float64 static constexpr DEFAULT_OCCLUSION_DISTANCE = 1.;
+
+
+            Preview()
+                : RayTracer(1)
+                , _mode(PreviewMode::AmbientOcclusion)
+                , _num_occlusion_rays(DEFAULT_OCCLUSION_RAYS)
+                , _occlusion_distance(DEFAULT_OCCLUSION_DISTANCE)
+            {}
+            explicit Preview(PreviewMode const& mode)
+                : RayTracer(1)
+                , _mode(mode)
+                , _num_occlusion_rays(DEFAULT_OCCLUSION_RAYS)
+                , _occlusion_distance(DEFAULT_OCCLUSION_DISTANCE)
+            {}
+
+            Preview inline & set_mode(PreviewMode const& mode)
+            {
+                this->_mode = mode;
+                return *this;
+            }
+            /// rays per hit for ambient occlusion, each ray takes one sample after the camera sample
+            Preview inline & set_occlusion_rays(length_t const& num_rays)
+            {
+                assert(num_rays > 0);
+                this->_num_occlusion_rays = num_rays;
+                return *this;
+            }
+            /// objects farther than distance do not occlude
+            Preview inline & set_occlusion_distance(float64 const& distance)
+            {
+                assert(distance > 0.);
+                this->_occlusion_distance = distance;
+                return *this;
+            }
+
+            PreviewMode inline mode() const
+            {
+                return this->_mode;
+            }
+            length_t inline occlusion_rays() const
+            {
+                return this->_num_occlusion_rays;
+            }
+            float64 inline occlusion_distance() const
+            {
+                return this->_occlusion_distance;
+            }
+
+            RGBColor virtual trace_ray(Ray const& ray) const override
+            {
+                RayHittingRecord rec;
+                if (!this->_world->hit(ray, rec.t, rec)) {
+                    switch (this->_mode) {
+                    case PreviewMode::AmbientOcclusion:
+                        return RGBColor(1.f);
+                    case PreviewMode::Albedo:
+                        return this->_world->sky()->get_color(ray.direction);
+                    default:
+                        return constants<float32>::axis3D::O;
+                    }
+                }
+                Vector3D const normal = normalize((dot(rec.normal, ray.direction) < 0) ? rec.normal : -rec.normal);
+                switch (this->_mode) {
+                case PreviewMode::AmbientOcclusion:
+                    return RGBColor(static_cast<float32>(this->_ambient_occlusion(rec.hitting_point, normal)));
+                case PreviewMode::Albedo:
+                    return RGBColor(rec.object->BRDF()->albedo()) + rec.object->emission();
+                default:
+                    return RGBColor(normal * 0.5 + 0.5);
+                }
+            }
+
+
+        private:
+            /// fraction of occlusion rays from point reaching occlusion distance
+            float64 _ambient_occlusion(Point3D const& point, Vector3D const& normal) const
+            {
+                Sampler & sampler = *this->_world->sampler();
+                Point3D const origin = Preview::_leave_surface(point, normal);
+                Vector3D const u = normalize(cross((::std::abs(normal.x) > 0.9) ? constants<float64>::axis3D::Y : constants<float64>::axis3D::X, normal));
+                Vector3D const v = cross(normal, u);
+                length_t num_open = 0;
+                for (length_t n = 0; n < this->_num_occlusion_rays; ++n) {
+                    Point3D const d = Sampler::map_to_hemisphere(sampler.sample_uniform2D(), 1.);
+                    Ray const occlusion_ray(origin, u * d.x + v * d.y + normal * d.z);
+                    num_open += this->_world->occluded(occlusion_ray, this->_occlusion_distance) ? 0 : 1;
+                }
+                return static_cast<float64>(num_open) / this->_num_occlusion_rays;
+            }
+
+
+            PreviewMode _mode;
+            length_t _num_occlusion_rays;
+            float64 _occlusion_distance;
+        };
+
+        typedef shared_ptr<Preview> PreviewPtr;
+        typedef shared_ptr<Preview const> PreviewConstptr;
+
+    } // namespace tracers
+
+} // namespace nyas
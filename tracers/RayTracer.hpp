@@ -2,7 +2,9 @@
 #pragma once
 
 #include "../common/types.hpp"
+#include "../common/functions.hpp"
 #include "../Ray.hpp"
+#include "../RayBatch.hpp"
 
 
 namespace nyas
@@ -47,8 +49,25 @@ namespace nyas
 
         RGBColor virtual trace_ray(Ray const& ray) const = 0;
 
+        /// trace all rays in batch, colors[i] is color of rays.ray(i). cursors[i] is sampler cursor of
+        /// camera sample of ray i, samples of bounces are taken after it, same as `World::render_sample`.
+        ///
+        /// This default traces rays one by one by `trace_ray`.
+        void virtual trace_rays(RayBatch const& rays, uint64 const* cursors, RGBColor * colors) const;
+
 
     protected:
+        /// origin of rays leaving surface at point, moved a little along normal so rays do not hit the
+        /// surface itself again because of rounding
+        Point3D inline static _leave_surface(Point3D const& point, Vector3D const& normal)
+        {
+            return point + normal * (RayTracer::SURFACE_OFFSET * (1. + length(point)) / length(normal));
+        }
+
+
+        float64 constexpr static SURFACE_OFFSET = 1e-9;    // relative to distance of point from origin
+
+
         length_t _max_steps;
         World const* _world;
     };
@@ -5,6 +5,11 @@
 #include "common/types.hpp"
 #include <string>
 #include <functional>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
 #ifdef WIN32    // Windows
     #include <direct.h>
     #include <io.h>
@@ -43,12 +48,69 @@ namespace nyas
     }
 
 
+    /* multithreading */
+
+    /// number of threads can run at the same time on this machine, at least 1
+    length_t inline default_num_threads()
+    {
+        length_t const num = static_cast<length_t>(::std::thread::hardware_concurrency());
+        return (num > 0) ? num : 1;
+    }
+
+    /// call func(i) for i in range [0, count) on num_threads threads (including the calling thread),
+    /// indices are taken one by one, so items with different costs are still balanced between threads.
+    template<typename Func>
+    void parallel_for(length_t const& count, length_t const& num_threads, Func const& func)
+    {
+        length_t const num_workers = ::std::min(num_threads, count) - 1;
+        ::std::atomic<length_t> next(0);
+        auto const work = [&next, &count, &func] () {
+            for (length_t i = next++; i < count; i = next++) {
+                func(i);
+            }
+        };
+        ::std::vector<::std::thread> threads;
+        threads.reserve((num_workers > 0) ? num_workers : 0);
+        for (length_t n = 0; n < num_workers; ++n) {
+            threads.emplace_back(work);
+        }
+        work();
+        for (::std::thread & thread : threads) {
+            thread.join();
+        }
+    }
+
+
+    /* hashing */
+
+    /// 64-bit FNV-1a style hash of bytes, 8 bytes are mixed in each step. Same bytes and seed always give
+    /// the same hash on the same machine, but hashes are not meant to be secure.
+    uint64 hash_bytes(void const* data, uint64 const& size, uint64 const& seed = 0xCBF29CE484222325ull)
+    {
+        uint64 constexpr PRIME = 0x100000001B3ull;
+        uint8 const* bytes = static_cast<uint8 const*>(data);
+        uint64 hash = seed;
+        uint64 i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64 word;
+            ::std::memcpy(&word, bytes + i, 8);
+            hash = (hash ^ word) * PRIME;
+            hash ^= hash >> 29;
+        }
+        for (; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * PRIME;
+        }
+        return hash ^ (hash >> 32);
+    }
+
+
     /* mapping operator */
 
-    template<typename FROM, typename TO>
-    void mapping_data(function<TO(FROM const&)> const& func, FROM const* from_data, TO * to_data, length_t const& total)
+    /// to_data[i] = func(from_data[i]) for i in range [0, total), func can be any callable object
+    template<typename FROM, typename TO, typename Func>
+    void mapping_data(Func const& func, FROM const* from_data, TO * to_data, offset_t const& total)
     {
-        for (length_t i = 0; i < total; ++i) {
+        for (offset_t i = 0; i < total; ++i) {
             *(to_data++) = func(*(from_data++));
         }
     }